@@ -57,9 +57,11 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME, BLE_SERIAL_LOG_LEVEL);
 #endif // !BLE_SERIAL_BUFFER_SIZE
 
 #ifndef BLE_SERIAL_CALLBACK_LIMIT
-#define BLE_SERIAL_CALLBACK_LIMIT 1
+#define BLE_SERIAL_CALLBACK_LIMIT 2
 #endif // !BLE_SERIAL_CALLBACK_LIMIT
 
+#define FLOW_CONTROL_RETRY_DELAY 1
+
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(CONFIG_BT_DEVICE_NAME) - 1)
 
@@ -71,6 +73,8 @@ static const struct bt_data advertising_data[] = {
 static K_SEM_DEFINE(sem_wait_init, 0, 1);
 static K_SEM_DEFINE(sem_data_ready, 0, 1);
 static K_SEM_DEFINE(sem_wait_for_tx, 1, 1);
+static K_SEM_DEFINE(sem_tx_flow, 0, 1);
+static K_MUTEX_DEFINE(tx_lock);
 
 static bool enabled = false;
 static char input_buffer[BLE_SERIAL_INPUT_BUFFER_SIZE + 1];
@@ -81,16 +85,20 @@ static serial_internal_line_t line = {
 	.mutable = { 
 	.len = 0,
 	.p_buffer = line_buffer,
+	.type = SERIAL_TYPE_BLE,
 	},
 };
 
-static int start_index = 0;
-static int bytes_in_buffer = 0;
+static serial_internal_ring_t ring = {
+	.p_buffer = input_buffer,
+	.size = BLE_SERIAL_INPUT_BUFFER_SIZE,
+	.overflow_policy = SERIAL_OVERFLOW_POLICY_DROP_OLDEST,
+	.p_sem_tx_flow = &sem_tx_flow,
+	.p_tx_lock = &tx_lock,
+};
+static struct k_work_delayable flow_control_work;
 static int bt_data_len = 20;
 
-static char const * end_character_list = NULL;
-static int end_character_count = 0;
-
 static serial_event_callback_t callback_list[BLE_SERIAL_CALLBACK_LIMIT] = { NULL };
 static serial_event_t event;
 
@@ -100,6 +108,10 @@ static serial_event_t event;
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // STATIC FUNCTION DECLARATIONS
 static void fire_callbacks(serial_event_t const * p_evt);
+static void resume_rx(void);
+static serial_ret_code_t send_raw(k_timeout_t timeout, char const * p_data, int len);
+static void flow_control_work_handler(struct k_work * p_work);
+static void flow_control_update(void);
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -182,18 +194,20 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t l
 
 static void nus_received(struct bt_conn *conn, const uint8_t *const data, uint16_t len)
 {
-	int bytes_to_copy = len;
-	while (bytes_to_copy > 0)
+	unsigned int key = irq_lock();
+	int const bytes_stored = serial_internal_put(&ring, (char const *)data, len);
+	bool const blocked = (bytes_stored < len) && (ring.overflow_policy == SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER);
+	if (blocked)
 	{
-		int buffer_index = (start_index + bytes_in_buffer) % BLE_SERIAL_INPUT_BUFFER_SIZE;
-		int free_space = (BLE_SERIAL_INPUT_BUFFER_SIZE - buffer_index);
-		int part_to_copy = (len < free_space) ? len : free_space;
-		memcpy(input_buffer + buffer_index, data, part_to_copy);
-		bytes_to_copy -= part_to_copy;
-		bytes_in_buffer += part_to_copy;
+		// waiting here would stall the bt rx thread, the central can only be held back by credit flow control
+		if (!ring.producer_paused) serial_internal_pause_producer(&ring);
+		ring.overflow_stats.block_lost_bytes += len - bytes_stored;
 	}
+	irq_unlock(key);
 	k_sem_give(&sem_data_ready);
-	LOG_DBG("Received %d bytes, %d bytes in buffer", len, bytes_in_buffer);
+	if (blocked) LOG_WRN("input buffer full, %d bytes lost", len - bytes_stored);
+	
+	LOG_DBG("Received %d bytes, %d bytes in buffer", len, ring.bytes_in_buffer);
 	event.type = SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED;
 	event.data.new_data.count = len;
 	event.data.new_data.p_buf = data;
@@ -224,6 +238,73 @@ static void fire_callbacks(serial_event_t const * p_evt)
 		}
 	}
 }
+
+static serial_ret_code_t send_raw(k_timeout_t timeout, char const * p_data, int len)
+{
+	if (len == 0) return SERIAL_RET_CODE_SUCCESS;
+	
+	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
+	{
+		LOG_WRN("uart tx busy");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	int bytes_sent = 0;
+	while (bytes_sent < len)
+	{
+		int bytes_to_send = ((len - bytes_sent) < bt_data_len) ? (len - bytes_sent) : bt_data_len;
+		int err = bt_nus_send(NULL, p_data + bytes_sent, bytes_to_send);
+		if (err != 0)
+		{
+			k_sem_give(&sem_wait_for_tx);
+			if (err != -ENOTCONN)
+			{
+				LOG_ERR("bt_nus_send returned error: %d", err);
+				ret_code = SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+			}
+			break;
+		}
+		bytes_sent += bytes_to_send;
+		LOG_INF("%d bytes sent (of %d)", bytes_sent, len);
+	}
+	
+	return ret_code;
+}
+
+static void flow_control_work_handler(struct k_work * p_work)
+{
+	static char message[2];
+	if (!enabled) return;
+	
+	if (k_mutex_lock(&tx_lock, K_NO_WAIT) != 0)
+	{
+		k_work_reschedule(&flow_control_work, K_MSEC(FLOW_CONTROL_RETRY_DELAY));
+		return;
+	}
+	int len = serial_internal_flow_control_message(&ring, message);
+	serial_ret_code_t ret_code = (len > 0) ? send_raw(K_NO_WAIT, message, len) : SERIAL_RET_CODE_SUCCESS;
+	k_mutex_unlock(&tx_lock);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		k_work_reschedule(&flow_control_work, K_MSEC(FLOW_CONTROL_RETRY_DELAY));
+		return;
+	}
+	if (len > 0) serial_internal_flow_control_sent(&ring, message, len);
+}
+
+static void flow_control_update(void)
+{
+	k_work_reschedule(&flow_control_work, K_NO_WAIT);
+}
+
+static void resume_rx(void)
+{
+	if (ring.producer_paused && (ring.bytes_in_buffer <= (BLE_SERIAL_INPUT_BUFFER_SIZE / 2)))
+	{
+		ring.producer_paused = false;
+	}
+}
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 serial_ret_code_t ble_serial_add_callback(serial_event_callback_t callback)
@@ -306,7 +387,12 @@ serial_ret_code_t ble_serial_enable()
 	}
 	
 	k_sem_give(&sem_wait_for_tx);
+	ring.resume_producer = resume_rx;
+	k_work_init_delayable(&flow_control_work, flow_control_work_handler);
+	ring.flow_control_update = flow_control_update;
 	enabled = true;
+	// sends the initial credits if flow control was configured before
+	flow_control_update();
 	
 	return SERIAL_RET_CODE_SUCCESS;
 }
@@ -335,7 +421,12 @@ serial_ret_code_t ble_serial_attach()
 	}
 	
 	k_sem_give(&sem_wait_for_tx);
+	ring.resume_producer = resume_rx;
+	k_work_init_delayable(&flow_control_work, flow_control_work_handler);
+	ring.flow_control_update = flow_control_update;
 	enabled = true;
+	// sends the initial credits if flow control was configured before
+	flow_control_update();
 	
 	return SERIAL_RET_CODE_SUCCESS;
 }
@@ -355,47 +446,32 @@ serial_ret_code_t ble_serial_detach()
 serial_line_t const * ble_serial_get_line(k_timeout_t timeout)
 {
 	LOG_DBG("getting next line");
-	line.mutable.len = 0;
 	if (!enabled)
 	{
 		LOG_ERR("ble_serial not enabled");
+		line.mutable.len = 0;
 		return &(line.fixed);
 	}
 	
-	return serial_internal_get_line(&sem_data_ready, timeout, &line, input_buffer, BLE_SERIAL_INPUT_BUFFER_SIZE, &start_index, &bytes_in_buffer, end_character_list, end_character_count, fire_callbacks);
+	return serial_internal_get_line(&sem_data_ready, timeout, &line, &ring, false, fire_callbacks);
 }
 
-serial_ret_code_t ble_serial_send(k_timeout_t timeout, char const * p_data, int len)
+serial_line_t const * ble_serial_get_chunk(k_timeout_t timeout)
 {
-	if (len == 0) return SERIAL_RET_CODE_SUCCESS;
-	
-	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
-	{
-		LOG_WRN("uart tx busy");
-		return SERIAL_RET_CODE_ERROR_BUSY;
-	}
-	
-	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
-	int bytes_sent = 0;
-	while (bytes_sent < len)
+	LOG_DBG("getting next chunk");
+	if (!enabled)
 	{
-		int bytes_to_send = ((len - bytes_sent) < bt_data_len) ? (len - bytes_sent) : bt_data_len;
-		int err = bt_nus_send(NULL, p_data + bytes_sent, bytes_to_send);
-		if (err != 0)
-		{
-			k_sem_give(&sem_wait_for_tx);
-			if (err != -ENOTCONN)
-			{
-				LOG_ERR("bt_nus_send returned error: %d", err);
-				ret_code = SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
-			}
-			break;
-		}
-		bytes_sent += bytes_to_send;
-		LOG_INF("%d bytes sent (of %d)", bytes_sent, len);
+		LOG_ERR("ble_serial not enabled");
+		line.mutable.len = 0;
+		return &(line.fixed);
 	}
 	
-	return ret_code;
+	return serial_internal_get_line(&sem_data_ready, timeout, &line, &ring, true, fire_callbacks);
+}
+
+serial_ret_code_t ble_serial_send(k_timeout_t timeout, char const * p_data, int len)
+{
+	return serial_internal_flow_send(&ring, timeout, p_data, len, send_raw);
 }
 
 serial_ret_code_t ble_serial_vsendf(k_timeout_t timeout, const char * format, va_list args)
@@ -423,12 +499,73 @@ serial_ret_code_t ble_serial_sendf(k_timeout_t timeout, char const * format, ...
 
 serial_ret_code_t ble_serial_set_end_character_list(char const * p_list, int len)
 {
-	end_character_count = len;
-	end_character_list = p_list;
+	ring.end_character_count = len;
+	ring.end_character_list = p_list;
 	LOG_INF("end character list updated");
 	return SERIAL_RET_CODE_SUCCESS;
 }
 
+serial_ret_code_t ble_serial_set_delimiter(char const * p_delimiter, int len)
+{
+	LOG_INF("delimiter with length %d set", len);
+	return serial_internal_set_delimiter(&ring, p_delimiter, len);
+}
+
+serial_ret_code_t ble_serial_set_max_line_length(int max_len)
+{
+	LOG_INF("max line length set to %d", max_len);
+	return serial_internal_set_max_line_length(&ring, max_len);
+}
+
+serial_ret_code_t ble_serial_set_overflow_policy(serial_overflow_policy_t policy)
+{
+	ring.overflow_policy = policy;
+	LOG_INF("overflow policy set to %d", policy);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t ble_serial_get_overflow_stats(serial_overflow_stats_t * p_stats)
+{
+	*p_stats = ring.overflow_stats;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t ble_serial_set_flow_control(serial_flow_control_config_t const * p_config)
+{
+	LOG_INF("flow control set to %d", p_config->mode);
+	return serial_internal_set_flow_control(&ring, p_config);
+}
+
+serial_ret_code_t ble_serial_set_framing(serial_framing_t framing)
+{
+	serial_framing_engine_t const * p_engine = serial_framing_get_engine(framing);
+	if ((p_engine == NULL) && (framing != SERIAL_FRAMING_LINE))
+	{
+		LOG_ERR("unknown framing %d", framing);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	ring.p_framing_engine = p_engine;
+	ring.scan = (serial_internal_scan_t) { 0 };
+	LOG_INF("framing set to %d", framing);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t ble_serial_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	if (ring.p_framing_engine == NULL) return ble_serial_send(timeout, p_data, len);
+	
+	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
+	{
+		LOG_WRN("ble tx busy");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	k_sem_give(&sem_wait_for_tx);
+	
+	int const frame_len = ring.p_framing_engine->encode(p_data, len, output_buffer, BLE_SERIAL_OUTPUT_BUFFER_SIZE);
+	if (frame_len < 0) return SERIAL_RET_CODE_ERROR_BUFFER_FULL;
+	return ble_serial_send(timeout, output_buffer, frame_len);
+}
+
 
 #else
 #ifndef BLE_SERIAL_LOG_LEVEL
@@ -484,6 +621,13 @@ serial_line_t const * ble_serial_get_line(k_timeout_t timeout)
 	return &line;
 }
 
+serial_line_t const * ble_serial_get_chunk(k_timeout_t timeout)
+{
+	static serial_line_t const line = { 0 };
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return &line;
+}
+
 serial_ret_code_t ble_serial_send(k_timeout_t timeout, char const * p_data, int len)
 {
 	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
@@ -507,4 +651,46 @@ serial_ret_code_t ble_serial_set_end_character_list(char const * p_list, int len
 	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
 	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
 }
+
+serial_ret_code_t ble_serial_set_delimiter(char const * p_delimiter, int len)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_set_max_line_length(int max_len)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_set_overflow_policy(serial_overflow_policy_t policy)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_get_overflow_stats(serial_overflow_stats_t * p_stats)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_set_flow_control(serial_flow_control_config_t const * p_config)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_set_framing(serial_framing_t framing)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t ble_serial_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	LOG_ERR("this module uses nordic uart service (CONFIG_BT=y,CONFIG_BT_PERIPHERAL=y,CONFIG_BT_NUS=y,CONFIG_BT_DEVICE_NAME=\"[name]\")");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "cmd_executor.h"
+
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#ifndef CMD_EXECUTOR_LOG_LEVEL
+#define CMD_EXECUTOR_LOG_LEVEL LOG_LEVEL_WRN
+#endif // !CMD_EXECUTOR_LOG_LEVEL
+
+#ifndef CMD_EXECUTOR_SEND_TIMEOUT_MS
+#define CMD_EXECUTOR_SEND_TIMEOUT_MS 1000
+#endif // !CMD_EXECUTOR_SEND_TIMEOUT_MS
+
+#define LOG_MODULE_NAME cmd_executor
+LOG_MODULE_REGISTER(LOG_MODULE_NAME, CMD_EXECUTOR_LOG_LEVEL);
+
+typedef enum job_state_e
+{
+	JOB_STATE_FREE,
+	JOB_STATE_QUEUED,
+	JOB_STATE_RUNNING,
+} job_state_t;
+
+typedef struct job_s
+{
+	job_state_t state;
+	int id;
+	bool cancel_requested;
+	k_tid_t thread;
+	serial_type_t origin;
+	cmd_parser_table_t * p_table;
+	cmd_parser_command_t const * p_command;
+	int len;
+	char line[CMD_EXECUTOR_LINE_SIZE];
+} job_t;
+
+static K_MUTEX_DEFINE(jobs_lock);    // protects the job states, the ids and the cancel flags
+static K_MSGQ_DEFINE(job_queue, sizeof(job_t *), CMD_EXECUTOR_MAX_JOBS, 4);
+static K_THREAD_STACK_ARRAY_DEFINE(worker_stacks, CMD_EXECUTOR_THREAD_COUNT, CMD_EXECUTOR_STACK_SIZE);
+static struct k_thread workers[CMD_EXECUTOR_THREAD_COUNT];
+
+static bool enabled = false;
+static int next_id = 1;
+static job_t jobs[CMD_EXECUTOR_MAX_JOBS];
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTION DECLARATIONS
+static void worker_thread(void * p1, void * p2, void * p3);
+static void send_to_origin(void * p_context, char const * p_data, int len);
+static job_t * find_job(int id);
+static int count_jobs(cmd_parser_command_t const * p_command);
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// EVENT HANDLERS
+static void worker_thread(void * p1, void * p2, void * p3)
+{
+	char response_buffer[CMD_EXECUTOR_RESPONSE_SIZE];
+
+	while (true)
+	{
+		job_t * p_job;
+		k_msgq_get(&job_queue, &p_job, K_FOREVER);
+
+		k_mutex_lock(&jobs_lock, K_FOREVER);
+		bool const cancelled = p_job->cancel_requested;
+		p_job->state = JOB_STATE_RUNNING;
+		p_job->thread = k_current_get();
+		k_mutex_unlock(&jobs_lock);
+
+		// cmd_parser keeps the active response per thread, so the replies of every job go to its own transport
+		cmd_parser_response_t response = {
+			.p_buffer = response_buffer,
+			.size = sizeof(response_buffer),
+			.len = 0,
+			.flush_fpt = send_to_origin,
+			.p_context = p_job,
+		};
+		cmd_parser_set_response(&response);
+
+		if (cancelled)
+		{
+			cmd_parser_reply("job %d cancelled\n", p_job->id);
+		}
+		else
+		{
+			LOG_DBG("job %d started: %.*s", p_job->id, p_job->len, p_job->line);
+			int const result = cmd_parser_table_parse(p_job->p_table, p_job->line, p_job->len);
+			if (result < 0) cmd_parser_reply("job %d failed %d\n", p_job->id, result);
+			else if (p_job->cancel_requested) cmd_parser_reply("job %d cancelled\n", p_job->id);
+			else cmd_parser_reply("job %d done\n", p_job->id);
+		}
+		cmd_parser_response_flush();
+		cmd_parser_set_response(NULL);
+
+		k_mutex_lock(&jobs_lock, K_FOREVER);
+		p_job->state = JOB_STATE_FREE;
+		p_job->thread = NULL;
+		k_mutex_unlock(&jobs_lock);
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void send_to_origin(void * p_context, char const * p_data, int len)
+{
+	job_t const * p_job = p_context;
+	serial_ret_code_t const ret_code = serial_send_to(p_job->origin, K_MSEC(CMD_EXECUTOR_SEND_TIMEOUT_MS), p_data, len);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_WRN("unable to send the response of job %d (code: %d)", p_job->id, ret_code);
+	}
+}
+
+// jobs_lock has to be held
+static job_t * find_job(int id)
+{
+	for (int i = 0; i < CMD_EXECUTOR_MAX_JOBS; i++)
+	{
+		if (jobs[i].state != JOB_STATE_FREE && jobs[i].id == id) return &(jobs[i]);
+	}
+	return NULL;
+}
+
+// jobs_lock has to be held
+static int count_jobs(cmd_parser_command_t const * p_command)
+{
+	int count = 0;
+	for (int i = 0; i < CMD_EXECUTOR_MAX_JOBS; i++)
+	{
+		if (jobs[i].state != JOB_STATE_FREE && jobs[i].p_command == p_command) count++;
+	}
+	return count;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+serial_ret_code_t cmd_executor_enable(void)
+{
+	if (enabled) return SERIAL_RET_CODE_SUCCESS;
+
+	for (int i = 0; i < CMD_EXECUTOR_THREAD_COUNT; i++)
+	{
+		k_tid_t const thread = k_thread_create(&(workers[i]), worker_stacks[i], K_THREAD_STACK_SIZEOF(worker_stacks[i]),
+			worker_thread, NULL, NULL, NULL, CMD_EXECUTOR_PRIORITY, 0, K_NO_WAIT);
+		k_thread_name_set(thread, "cmd_executor");
+	}
+	enabled = true;
+	LOG_INF("cmd executor enabled (%d threads)", CMD_EXECUTOR_THREAD_COUNT);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+int cmd_executor_submit(cmd_parser_table_t * p_table, serial_line_t const * p_line)
+{
+	if (!enabled) return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+	if (p_line->len == 0 || p_line->len > CMD_EXECUTOR_LINE_SIZE) return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+
+	// resolved up front, so unknown commands are rejected right away and the limit is known
+	cmd_parser_command_t const * p_command = cmd_parser_table_find(p_table, p_line->p_data, p_line->len);
+	if (p_command == NULL) return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+
+	k_mutex_lock(&jobs_lock, K_FOREVER);
+	if (p_command->max_jobs > 0 && count_jobs(p_command) >= p_command->max_jobs)
+	{
+		k_mutex_unlock(&jobs_lock);
+		LOG_DBG("%s already has %d jobs", p_command->name, p_command->max_jobs);
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	job_t * p_job = NULL;
+	for (int i = 0; i < CMD_EXECUTOR_MAX_JOBS; i++)
+	{
+		if (jobs[i].state == JOB_STATE_FREE)
+		{
+			p_job = &(jobs[i]);
+			break;
+		}
+	}
+	if (p_job == NULL)
+	{
+		k_mutex_unlock(&jobs_lock);
+		return SERIAL_RET_CODE_ERROR_NO_MEMORY;
+	}
+
+	p_job->state = JOB_STATE_QUEUED;
+	p_job->id = next_id;
+	next_id = (next_id == INT32_MAX) ? 1 : (next_id + 1);
+	p_job->cancel_requested = false;
+	p_job->origin = p_line->type;
+	p_job->p_table = p_table;
+	p_job->p_command = p_command;
+	p_job->len = p_line->len;
+	memcpy(p_job->line, p_line->p_data, p_line->len);
+	int const id = p_job->id;
+	k_mutex_unlock(&jobs_lock);
+
+	// the queue has room for every job slot, so this never blocks
+	k_msgq_put(&job_queue, &p_job, K_NO_WAIT);
+	LOG_DBG("job %d queued", id);
+	return id;
+}
+
+serial_ret_code_t cmd_executor_cancel(int job_id)
+{
+	k_mutex_lock(&jobs_lock, K_FOREVER);
+	job_t * p_job = find_job(job_id);
+	if (p_job != NULL) p_job->cancel_requested = true;
+	k_mutex_unlock(&jobs_lock);
+	return (p_job != NULL) ? SERIAL_RET_CODE_SUCCESS : SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+}
+
+bool cmd_executor_cancel_requested(void)
+{
+	k_tid_t const thread = k_current_get();
+	bool cancel_requested = false;
+	k_mutex_lock(&jobs_lock, K_FOREVER);
+	for (int i = 0; i < CMD_EXECUTOR_MAX_JOBS; i++)
+	{
+		if (jobs[i].state == JOB_STATE_RUNNING && jobs[i].thread == thread)
+		{
+			cancel_requested = jobs[i].cancel_requested;
+			break;
+		}
+	}
+	k_mutex_unlock(&jobs_lock);
+	return cancel_requested;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef CMD_EXECUTOR_H_
+#define CMD_EXECUTOR_H_
+
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+
+#include "cmd_parser.h"
+#include "serial.h"
+
+#ifndef CMD_EXECUTOR_THREAD_COUNT
+#define CMD_EXECUTOR_THREAD_COUNT 2      // commands running at the same time
+#endif // !CMD_EXECUTOR_THREAD_COUNT
+
+#ifndef CMD_EXECUTOR_STACK_SIZE
+#define CMD_EXECUTOR_STACK_SIZE 2048
+#endif // !CMD_EXECUTOR_STACK_SIZE
+
+#ifndef CMD_EXECUTOR_PRIORITY
+#define CMD_EXECUTOR_PRIORITY 7
+#endif // !CMD_EXECUTOR_PRIORITY
+
+#ifndef CMD_EXECUTOR_MAX_JOBS
+#define CMD_EXECUTOR_MAX_JOBS 8          // queued and running commands
+#endif // !CMD_EXECUTOR_MAX_JOBS
+
+#ifndef CMD_EXECUTOR_LINE_SIZE
+#define CMD_EXECUTOR_LINE_SIZE 128       // longest command line accepted by cmd_executor_submit()
+#endif // !CMD_EXECUTOR_LINE_SIZE
+
+#ifndef CMD_EXECUTOR_RESPONSE_SIZE
+#define CMD_EXECUTOR_RESPONSE_SIZE 128   // cmd_parser_reply() output is sent in pieces of this size
+#endif // !CMD_EXECUTOR_RESPONSE_SIZE
+
+// Commands are copied and executed on the worker threads, the replies of a command and the final
+// "job <id> done|failed <code>|cancelled" line are sent to the transport the command was received on.
+// cmd_parser has to be built with CMD_PARSER_THREAD_LOCAL=__thread and CONFIG_THREAD_LOCAL_STORAGE.
+serial_ret_code_t cmd_executor_enable(void);
+// returns the job id (> 0) or SERIAL_RET_CODE_ERROR_BUSY if max_jobs of the command is reached
+int cmd_executor_submit(cmd_parser_table_t * p_table, serial_line_t const * p_line);
+// queued jobs are dropped, running jobs are only asked to stop with cmd_executor_cancel_requested()
+serial_ret_code_t cmd_executor_cancel(int job_id);
+// polled by long running commands on the worker threads
+bool cmd_executor_cancel_requested(void);
+
+
+#endif  /* _ CMD_EXECUTOR_H_ */
\ No newline at end of file
@@ -7,7 +7,9 @@
 
 #include "cmd_parser.h"
 
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -20,6 +22,59 @@ typedef struct print_line_values_s
 	int description_len;
 	int complete_len;
 } print_line_values_t;
+
+static CMD_PARSER_THREAD_LOCAL char arg_buffer[CMD_PARSER_ARG_BUFFER_SIZE];
+static CMD_PARSER_THREAD_LOCAL cmd_parser_response_t * p_active_response = NULL;
+static CMD_PARSER_THREAD_LOCAL bool response_flush_blocked = false;  // set while a binary response frame is open
+
+// crc-16/ccitt-false, same as the length-crc framing of the serial module
+static uint16_t const crc16_nibble_table[16] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+// value of a hex digit, 0xFF marks invalid characters
+static uint8_t const hex_table[256] =
+{
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// value of a base64 character, 0xFF marks invalid characters
+static uint8_t const base64_table[256] =
+{
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+	0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -31,6 +86,20 @@ static bool has_suffix(char const * arg, int len, char const * suffix, int suffi
 static bool hex_arg_to_int(char const * arg, int len, int * result);
 static bool binary_arg_to_int(char const * arg, int len, int * result);
 static bool decimal_arg_to_int(char const * arg, int len, int * result);
+static int name_char(cmd_parser_table_t const * p_table, int sorted_index, int pos);
+static int narrow_range(cmd_parser_table_t const * p_table, int lo, int hi, int pos, int c, bool upper);
+static int find_token(cmd_parser_table_t * p_table, char const * input, int input_len, int * p_token_len);
+static cmd_parser_command_t * resolve(cmd_parser_table_t * p_table, char const * input, int input_len, char const ** p_arg, int * p_arg_len, int * p_index);
+static int hex_nibble(char c);
+static bool parse_integer(char const * token, int len, bool * p_negative, uint64_t * p_magnitude);
+static bool next_token(char const * arg, int len, int * p_pos, char const ** p_token, int * p_token_len, bool * p_quoted);
+static bool store_integer(cmd_parser_arg_schema_t const * p_schema, int64_t value, cmd_parser_arg_value_t * p_value);
+static bool convert_arg(cmd_parser_arg_schema_t const * p_schema, char const * token, int len, bool quoted, cmd_parser_arg_value_t * p_value, int * p_buffer_used);
+static int dispatch(cmd_parser_command_t const * p_command, char const * arg, int arg_len);
+static uint16_t crc16(uint16_t crc, uint8_t const * p_data, int len);
+static uint32_t read_le(uint8_t const * p_data, int size);
+static bool decode_binary_args(cmd_parser_arg_schema_t const * p_schema, int count, uint8_t const * p_payload, int len, cmd_parser_arg_value_t * p_values);
+static bool is_word(char const * input, int len, char const * word);
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -47,7 +116,7 @@ static int count_whitespaces(char const * arg, int len)
 
 static bool is_whitespace(char c)
 {
-	char const whitespaces[] = { '\n', '\t', ' ' };
+	char const whitespaces[] = { '\n', '\r', '\t', ' ' };
 	for (int i = 0; i < sizeof(whitespaces); i++)
 	{
 		if (c == whitespaces[i]) return true;
@@ -65,23 +134,14 @@ static bool has_suffix(char const * arg, int len, char const * suffix, int suffi
 static bool hex_arg_to_int(char const * arg, int len, int * result)
 {
 	*result = 0;
-	bool result_generated = false;
-	for (int i = 0; i < len + 1; i += 2)
-	{
-		char const * pos = arg + i;
-		int hex_val = 0;
-		if (pos[0] >= '0' && pos[0] <= '9') hex_val = (pos[0] - '0') << 4;
-		else if (pos[0] >= 'a' && pos[0] <= 'f') hex_val = (pos[0] - 'a' + 10) << 4;
-		else if (pos[0] >= 'A' && pos[0] <= 'F') hex_val = (pos[0] - 'A' + 10) << 4;
-		else if (is_whitespace(pos[0])) return true;
-		if (pos[1] >= '0' && pos[1] <= '9') hex_val += (pos[1] - '0');
-		else if (pos[1] >= 'a' && pos[1] <= 'f') hex_val += (pos[1] - 'a' + 10);
-		else if (pos[1] >= 'A' && pos[1] <= 'F') hex_val += (pos[1] - 'A' + 10);
+	for (int i = 0; i < len; i++)
+	{
+		int const nibble = hex_nibble(arg[i]);
+		if (nibble >= 0) *result = (*result << 4) + nibble;
+		else if (is_whitespace(arg[i])) return i > 0;
 		else return false;
-		*result = (*result << 8) + hex_val;
-		result_generated = true;
 	}
-	return result_generated;
+	return len > 0;
 }
 
 static bool binary_arg_to_int(char const * arg, int len, int * result)
@@ -101,10 +161,11 @@ static bool decimal_arg_to_int(char const * arg, int len, int * result)
 {
 	*result = 0;
 	int sign = 1;
-	if (arg[0] == '-')
+	if (len > 0 && arg[0] == '-')
 	{
 		sign = -1;
 		arg++;
+		len--;
 	}
 	for (int i = 0; i < len; i++)
 	{
@@ -119,13 +180,390 @@ static bool decimal_arg_to_int(char const * arg, int len, int * result)
 	*result *= sign;
 	return len > 0;
 }
+
+// character of a command name in sorted order, the end of a name sorts before every character
+static int name_char(cmd_parser_table_t const * p_table, int sorted_index, int pos)
+{
+	int const command = p_table->sorted[sorted_index];
+	if (pos >= p_table->name_len[command]) return -1;
+	return (unsigned char)p_table->command_list[command].name[pos];
+}
+
+// first entry in [lo, hi) whose character at pos is >= c (or > c if upper is set)
+static int narrow_range(cmd_parser_table_t const * p_table, int lo, int hi, int pos, int c, bool upper)
+{
+	while (lo < hi)
+	{
+		int const mid = lo + (hi - lo) / 2;
+		int const mid_char = name_char(p_table, mid, pos);
+		if (mid_char < c || (upper && mid_char == c)) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+static int find_token(cmd_parser_table_t * p_table, char const * input, int input_len, int * p_token_len)
+{
+	if (!p_table->compiled && cmd_parser_table_compile(p_table) != 0) return CMD_PARSER_COMMAND_INVALID;
+	
+	// the sorted names form an implicit trie: all names in [lo, hi) start with the part of the token read so far,
+	// so every input character is read once
+	int lo = 0;
+	int hi = p_table->command_count;
+	int token_len = 0;
+	while (token_len < input_len && (unsigned char)input[token_len] > ' ')
+	{
+		int const c = (unsigned char)input[token_len];
+		lo = narrow_range(p_table, lo, hi, token_len, c, false);
+		hi = narrow_range(p_table, lo, hi, token_len, c, true);
+		if (lo == hi) return CMD_PARSER_COMMAND_INVALID;
+		token_len++;
+	}
+	if (token_len == 0) return CMD_PARSER_COMMAND_INVALID;
+	*p_token_len = token_len;
+	
+	// an exact match sorts first, otherwise the token has to be the prefix of exactly one name
+	if (p_table->name_len[p_table->sorted[lo]] == token_len) return p_table->sorted[lo];
+	if (hi - lo == 1) return p_table->sorted[lo];
+	return CMD_PARSER_COMMAND_INVALID;
+}
+
+static cmd_parser_command_t * resolve(cmd_parser_table_t * p_table, char const * input, int input_len, char const ** p_arg, int * p_arg_len, int * p_index)
+{
+	cmd_parser_command_t * p_command = NULL;
+	int pos = 0;
+	while (true)
+	{
+		int token_len;
+		int i = find_token(p_table, input + pos, input_len - pos, &token_len);
+		// a token which is no subcommand is passed as argument to the last resolved command
+		if (i == CMD_PARSER_COMMAND_INVALID) break;
+		
+		p_command = &(p_table->command_list[i]);
+		*p_index = i;
+		pos += token_len;
+		*p_arg = NULL;
+		*p_arg_len = 0;
+		if (input_len > (pos + 1) && input[pos] == ' ')
+		{
+			*p_arg = input + pos + 1;
+			*p_arg_len = input_len - pos - 1;
+		}
+		if (p_command->p_subcommands == NULL || *p_arg == NULL) break;
+		p_table = p_command->p_subcommands;
+		pos++;
+	}
+	if (p_command == NULL || (p_command->command_fpt == NULL && p_command->typed_fpt == NULL)) return NULL;
+	return p_command;
+}
+
+static int hex_nibble(char c)
+{
+	uint8_t const value = hex_table[(uint8_t)c];
+	return (value == 0xFF) ? -1 : value;
+}
+
+static bool parse_integer(char const * token, int len, bool * p_negative, uint64_t * p_magnitude)
+{
+	*p_negative = false;
+	if (len > 0 && (token[0] == '-' || token[0] == '+'))
+	{
+		*p_negative = (token[0] == '-');
+		token++;
+		len--;
+	}
+	int base = 10;
+	if (has_suffix(token, len, "0x", 2)) base = 16;
+	else if (has_suffix(token, len, "0b", 2)) base = 2;
+	if (base != 10)
+	{
+		token += 2;
+		len -= 2;
+	}
+	if (len <= 0) return false;
+	
+	uint64_t value = 0;
+	for (int i = 0; i < len; i++)
+	{
+		int const digit = hex_nibble(token[i]);
+		if (digit < 0 || digit >= base) return false;
+		if (value > (UINT64_MAX - digit) / base) return false;
+		value = value * base + digit;
+	}
+	*p_magnitude = value;
+	return true;
+}
+
+// returns the next whitespace separated token, quoted tokens are returned without quotes but still escaped
+static bool next_token(char const * arg, int len, int * p_pos, char const ** p_token, int * p_token_len, bool * p_quoted)
+{
+	int pos = *p_pos;
+	*p_quoted = (arg[pos] == '"');
+	if (*p_quoted)
+	{
+		pos++;
+		*p_token = arg + pos;
+		while (pos < len && arg[pos] != '"')
+		{
+			if (arg[pos] == '\\') pos++;
+			pos++;
+		}
+		if (pos >= len) return false;
+		*p_token_len = (arg + pos) - *p_token;
+		pos++;
+		if (pos < len && !is_whitespace(arg[pos])) return false;
+	}
+	else
+	{
+		*p_token = arg + pos;
+		while (pos < len && !is_whitespace(arg[pos])) pos++;
+		*p_token_len = (arg + pos) - *p_token;
+	}
+	*p_pos = pos;
+	return true;
+}
+
+static bool store_integer(cmd_parser_arg_schema_t const * p_schema, int64_t value, cmd_parser_arg_value_t * p_value)
+{
+	if ((p_schema->min != p_schema->max) && (value < p_schema->min || value > p_schema->max)) return false;
+	if (p_schema->type == CMD_PARSER_ARG_INT32)
+	{
+		if (value < INT32_MIN || value > INT32_MAX) return false;
+		p_value->value.i32 = value;
+	}
+	else if (p_schema->type == CMD_PARSER_ARG_UINT32)
+	{
+		if (value < 0 || value > UINT32_MAX) return false;
+		p_value->value.u32 = value;
+	}
+	else
+	{
+		p_value->value.i64 = value;
+	}
+	return true;
+}
+
+static bool convert_arg(cmd_parser_arg_schema_t const * p_schema, char const * token, int len, bool quoted, cmd_parser_arg_value_t * p_value, int * p_buffer_used)
+{
+	bool const range_checked = (p_schema->min != p_schema->max);
+	int const max_len = (p_schema->max_len > 0) ? p_schema->max_len : CMD_PARSER_ARG_BUFFER_SIZE;
+	char * p_buffer = arg_buffer + *p_buffer_used;
+	int const buffer_left = CMD_PARSER_ARG_BUFFER_SIZE - *p_buffer_used;
+	
+	switch (p_schema->type)
+	{
+	case CMD_PARSER_ARG_INT32:
+	case CMD_PARSER_ARG_INT64:
+	case CMD_PARSER_ARG_UINT32:
+		{
+			bool negative;
+			uint64_t magnitude;
+			if (quoted || !parse_integer(token, len, &negative, &magnitude)) return false;
+			if (magnitude > (uint64_t)INT64_MAX + (negative ? 1 : 0)) return false;
+			return store_integer(p_schema, negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude, p_value);
+		}
+	case CMD_PARSER_ARG_FLOAT:
+		{
+			char number[32];
+			if (quoted || len >= sizeof(number)) return false;
+			memcpy(number, token, len);
+			number[len] = '\0';
+			char * p_end;
+			float const value = strtof(number, &p_end);
+			if (len == 0 || p_end != number + len) return false;
+			if (range_checked && (value < p_schema->min || value > p_schema->max)) return false;
+			p_value->value.f = value;
+			return true;
+		}
+	case CMD_PARSER_ARG_BOOL:
+		{
+			static char const * const true_names[] = { "1", "true", "on", "yes" };
+			static char const * const false_names[] = { "0", "false", "off", "no" };
+			for (int i = 0; i < CMD_PARSER_COUNT(true_names); i++)
+			{
+				if (strlen(true_names[i]) == len && memcmp(token, true_names[i], len) == 0)
+				{
+					p_value->value.b = true;
+					return true;
+				}
+				if (strlen(false_names[i]) == len && memcmp(token, false_names[i], len) == 0)
+				{
+					p_value->value.b = false;
+					return true;
+				}
+			}
+			return false;
+		}
+	case CMD_PARSER_ARG_ENUM:
+		for (int i = 0; i < p_schema->enum_count; i++)
+		{
+			if (strlen(p_schema->enum_names[i]) == len && memcmp(token, p_schema->enum_names[i], len) == 0)
+			{
+				p_value->value.enum_index = i;
+				return true;
+			}
+		}
+		return false;
+	case CMD_PARSER_ARG_STRING:
+		{
+			int out_len = 0;
+			for (int i = 0; i < len; i++)
+			{
+				if (quoted && token[i] == '\\') i++;
+				if (out_len >= max_len || out_len + 1 >= buffer_left) return false;
+				p_buffer[out_len++] = token[i];
+			}
+			p_buffer[out_len] = '\0';
+			p_value->value.string.p_data = p_buffer;
+			p_value->value.string.len = out_len;
+			*p_buffer_used += out_len + 1;
+			return true;
+		}
+	case CMD_PARSER_ARG_HEX_BYTES:
+	case CMD_PARSER_ARG_BASE64_BYTES:
+		{
+			// checked against the upper bound first, the decoders write before validating
+			int const max_out = (p_schema->type == CMD_PARSER_ARG_HEX_BYTES) ? len / 2 : (len / 4) * 3 + 2;
+			if (quoted || max_out > buffer_left) return false;
+			int const out_len = (p_schema->type == CMD_PARSER_ARG_HEX_BYTES) ?
+				cmd_parser_hex_decode(token, len, (uint8_t *)p_buffer) :
+				cmd_parser_base64_decode(token, len, (uint8_t *)p_buffer);
+			if (out_len < 0 || out_len > max_len) return false;
+			p_value->value.bytes.p_data = (uint8_t const *)p_buffer;
+			p_value->value.bytes.len = out_len;
+			*p_buffer_used += out_len;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int dispatch(cmd_parser_command_t const * p_command, char const * arg, int arg_len)
+{
+	// a typed handler without a schema takes no arguments, it is called with an empty argument list
+	if ((p_command->p_arg_schema == NULL) && (p_command->typed_fpt == NULL))
+	{
+		p_command->command_fpt(p_command, arg, arg_len);
+		return 0;
+	}
+	
+	cmd_parser_arg_value_t values[CMD_PARSER_MAX_ARGS];
+	if (!cmd_parser_parse_args(p_command->p_arg_schema, p_command->arg_count, arg, arg_len, values)) return CMD_PARSER_ARGS_INVALID;
+	if (p_command->typed_fpt != NULL) p_command->typed_fpt(p_command, values, p_command->arg_count);
+	else p_command->command_fpt(p_command, arg, arg_len);
+	return 0;
+}
+
+static uint16_t crc16(uint16_t crc, uint8_t const * p_data, int len)
+{
+	for (int i = 0; i < len; i++)
+	{
+		crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (p_data[i] >> 4)];
+		crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (p_data[i] & 0x0F)];
+	}
+	return crc;
+}
+
+static uint32_t read_le(uint8_t const * p_data, int size)
+{
+	uint32_t value = 0;
+	for (int i = size - 1; i >= 0; i--) value = (value << 8) | p_data[i];
+	return value;
+}
+
+// little endian values with fixed sizes, strings and byte arrays are prefixed with one length byte
+static bool decode_binary_args(cmd_parser_arg_schema_t const * p_schema, int count, uint8_t const * p_payload, int len, cmd_parser_arg_value_t * p_values)
+{
+	if (count > CMD_PARSER_MAX_ARGS) return false;
+	int pos = 0;
+	int buffer_used = 0;
+	for (int i = 0; i < count; i++)
+	{
+		cmd_parser_arg_value_t * p_value = &(p_values[i]);
+		p_value->present = false;
+		if (pos >= len)
+		{
+			if (!p_schema[i].optional) return false;
+			continue;
+		}
+		
+		uint8_t const * p_arg = p_payload + pos;
+		int const left = len - pos;
+		int const max_len = (p_schema[i].max_len > 0) ? p_schema[i].max_len : CMD_PARSER_ARG_BUFFER_SIZE;
+		switch (p_schema[i].type)
+		{
+		case CMD_PARSER_ARG_INT32:
+			if (left < 4 || !store_integer(&(p_schema[i]), (int32_t)read_le(p_arg, 4), p_value)) return false;
+			pos += 4;
+			break;
+		case CMD_PARSER_ARG_UINT32:
+			if (left < 4 || !store_integer(&(p_schema[i]), read_le(p_arg, 4), p_value)) return false;
+			pos += 4;
+			break;
+		case CMD_PARSER_ARG_INT64:
+			if (left < 8 || !store_integer(&(p_schema[i]), (int64_t)(((uint64_t)read_le(p_arg + 4, 4) << 32) | read_le(p_arg, 4)), p_value)) return false;
+			pos += 8;
+			break;
+		case CMD_PARSER_ARG_FLOAT:
+			{
+				if (left < 4) return false;
+				uint32_t const bits = read_le(p_arg, 4);
+				memcpy(&(p_value->value.f), &bits, sizeof(float));
+				if ((p_schema[i].min != p_schema[i].max) && (p_value->value.f < p_schema[i].min || p_value->value.f > p_schema[i].max)) return false;
+				pos += 4;
+				break;
+			}
+		case CMD_PARSER_ARG_BOOL:
+			if (p_arg[0] > 1) return false;
+			p_value->value.b = p_arg[0];
+			pos += 1;
+			break;
+		case CMD_PARSER_ARG_ENUM:
+			if (p_arg[0] >= p_schema[i].enum_count) return false;
+			p_value->value.enum_index = p_arg[0];
+			pos += 1;
+			break;
+		case CMD_PARSER_ARG_STRING:
+			{
+				// copied to be null terminated, behind the strings of the previous arguments
+				char * p_buffer = arg_buffer + buffer_used;
+				if (p_arg[0] >= left || p_arg[0] > max_len || p_arg[0] >= (CMD_PARSER_ARG_BUFFER_SIZE - buffer_used)) return false;
+				memcpy(p_buffer, p_arg + 1, p_arg[0]);
+				p_buffer[p_arg[0]] = '\0';
+				p_value->value.string.p_data = p_buffer;
+				p_value->value.string.len = p_arg[0];
+				buffer_used += p_arg[0] + 1;
+				pos += 1 + p_arg[0];
+				break;
+			}
+		case CMD_PARSER_ARG_HEX_BYTES:
+		case CMD_PARSER_ARG_BASE64_BYTES:
+			// already binary, pointing into the request
+			if (p_arg[0] >= left || p_arg[0] > max_len) return false;
+			p_value->value.bytes.p_data = p_arg + 1;
+			p_value->value.bytes.len = p_arg[0];
+			pos += 1 + p_arg[0];
+			break;
+		default:
+			return false;
+		}
+		p_value->present = true;
+	}
+	return pos == len;
+}
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static int get_index(char const * input, int input_len, cmd_parser_command_t const * command_list, int command_count)
+static bool is_word(char const * input, int len, char const * word)
+{
+	return strlen(word) == len && memcmp(input, word, len) == 0;
+}
+
+static int get_index(char const * input, int input_len, cmd_parser_command_t const * command_list, int command_count, int * p_command_len)
 {
 	for (int i = 0; i < command_count; i++)
 	{
 		int command_len = strlen(command_list[i].name);
+		*p_command_len = command_len;
 		if (input_len < command_len) continue;
 		if (memcmp(input, command_list[i].name, command_len) != 0) continue;
 		if (input_len > (command_len + 1) && input[command_len + 1] > ' ')
@@ -153,34 +591,34 @@ static print_line_values_t calculate_print_line_values(cmd_parser_command_t cons
 
 int cmd_parser_parse(char const * input, int input_len, cmd_parser_command_t const * command_list, int command_count)
 {
-	int i = get_index(input, input_len, command_list, command_count);
+	int command_len;
+	int i = get_index(input, input_len, command_list, command_count, &command_len);
 	if (i == CMD_PARSER_COMMAND_INVALID) return CMD_PARSER_COMMAND_INVALID;
 	char const * arg = NULL;
 	int arg_len = 0;
-	int command_len = strlen(command_list[i].name);
 	if(input_len > (command_len + 1) && input[command_len] == ' ')
 	{
 		arg = input + command_len + 1;
 		arg_len = input_len - command_len - 1;
 	}
-	command_list[i].command_fpt(&(command_list[i]), arg, arg_len);
+	if (dispatch(&(command_list[i]), arg, arg_len) != 0) return CMD_PARSER_ARGS_INVALID;
 	return i;
 }
 
 int cmd_parser_parse_and_set_context(char const * input, int input_len, cmd_parser_command_t * command_list, int command_count, void * p_context)
 {
-	int i = get_index(input, input_len, command_list, command_count);
+	int command_len;
+	int i = get_index(input, input_len, command_list, command_count, &command_len);
 	if (i == CMD_PARSER_COMMAND_INVALID) return CMD_PARSER_COMMAND_INVALID;
 	char const * arg = NULL;
 	int arg_len = 0;
-	int command_len = strlen(command_list[i].name);
 	if (input_len > (command_len + 1) && input[command_len] == ' ')
 	{
 		arg = input + command_len + 1;
 		arg_len = input_len - command_len - 1;
 	}
 	command_list[i].p_context = p_context;
-	command_list[i].command_fpt(&(command_list[i]), arg, arg_len);
+	if (dispatch(&(command_list[i]), arg, arg_len) != 0) return CMD_PARSER_ARGS_INVALID;
 	return i;
 }
 
@@ -219,7 +657,413 @@ bool cmd_parser_arg_to_int(char const * arg, int len, int * result)
 	arg += whitespaces;
 	len -= whitespaces;
 	
-	if (has_suffix(arg, len, "0x", 2)) return hex_arg_to_int(arg + 2, len, result);
-	if (has_suffix(arg, len, "0b", 2)) return binary_arg_to_int(arg + 2, len, result);
+	if (has_suffix(arg, len, "0x", 2)) return hex_arg_to_int(arg + 2, len - 2, result);
+	if (has_suffix(arg, len, "0b", 2)) return binary_arg_to_int(arg + 2, len - 2, result);
 	return decimal_arg_to_int(arg, len, result);
+}
+
+int cmd_parser_table_compile(cmd_parser_table_t * p_table)
+{
+	p_table->name_width = 0;
+	p_table->description_width = 0;
+	for (int i = 0; i < p_table->command_count; i++)
+	{
+		size_t const len = strlen(p_table->command_list[i].name);
+		if (len == 0 || len > UINT8_MAX) return CMD_PARSER_COMMAND_INVALID;
+		p_table->name_len[i] = len;
+		if (len > p_table->name_width) p_table->name_width = len;
+		if (p_table->command_list[i].description != NULL)
+		{
+			int const description_len = strlen(p_table->command_list[i].description);
+			if (description_len > p_table->description_width) p_table->description_width = description_len;
+		}
+		
+		// insertion sort, only done once per table
+		int j = i;
+		while (j > 0 && strcmp(p_table->command_list[p_table->sorted[j - 1]].name, p_table->command_list[i].name) > 0)
+		{
+			p_table->sorted[j] = p_table->sorted[j - 1];
+			j--;
+		}
+		if (j > 0 && strcmp(p_table->command_list[p_table->sorted[j - 1]].name, p_table->command_list[i].name) == 0) return CMD_PARSER_COMMAND_INVALID;
+		p_table->sorted[j] = i;
+	}
+	p_table->compiled = true;
+	return 0;
+}
+
+int cmd_parser_table_parse(cmd_parser_table_t * p_table, char const * input, int input_len)
+{
+	char const * arg;
+	int arg_len;
+	int i;
+	cmd_parser_command_t * p_command = resolve(p_table, input, input_len, &arg, &arg_len, &i);
+	if (p_command == NULL) return CMD_PARSER_COMMAND_INVALID;
+	if (dispatch(p_command, arg, arg_len) != 0) return CMD_PARSER_ARGS_INVALID;
+	return i;
+}
+
+int cmd_parser_table_print_help(cmd_parser_table_t * p_table, char const * title, char const * prefix, int prefix_len)
+{
+	if (!p_table->compiled && cmd_parser_table_compile(p_table) != 0) return CMD_PARSER_COMMAND_INVALID;
+	
+	// same layout as cmd_parser_print_title and cmd_parser_print_command
+	if (title != NULL)
+	{
+		static char const dashes[] = "--------------------------------";
+		int const complete_len = p_table->name_width + p_table->description_width + 4;
+		int const title_len = strlen(title);
+		int const left = (complete_len - title_len) / 2;
+		int const right = complete_len - title_len - left;
+		for (int printed = 0; printed < left; printed += sizeof(dashes) - 1) cmd_parser_reply("%.*s", left - printed, dashes);
+		cmd_parser_reply("%s", title);
+		for (int printed = 0; printed < right; printed += sizeof(dashes) - 1) cmd_parser_reply("%.*s", right - printed, dashes);
+		cmd_parser_reply("\n");
+	}
+	
+	// the commands starting with the prefix are one range of the sorted index
+	int lo = 0;
+	int hi = p_table->command_count;
+	for (int pos = 0; pos < prefix_len && lo < hi; pos++)
+	{
+		lo = narrow_range(p_table, lo, hi, pos, (unsigned char)prefix[pos], false);
+		hi = narrow_range(p_table, lo, hi, pos, (unsigned char)prefix[pos], true);
+	}
+	for (int i = lo; i < hi; i++)
+	{
+		cmd_parser_command_t const * p_command = &(p_table->command_list[p_table->sorted[i]]);
+		cmd_parser_reply("%-*s - %s\n", p_table->name_width, p_command->name, (p_command->description != NULL) ? p_command->description : "");
+	}
+	cmd_parser_response_flush();
+	return hi - lo;
+}
+
+cmd_parser_command_t const * cmd_parser_table_find(cmd_parser_table_t * p_table, char const * input, int input_len)
+{
+	char const * arg;
+	int arg_len;
+	int i;
+	return resolve(p_table, input, input_len, &arg, &arg_len, &i);
+}
+
+int cmd_parser_table_parse_and_set_context(cmd_parser_table_t * p_table, char const * input, int input_len, void * p_context)
+{
+	char const * arg;
+	int arg_len;
+	int i;
+	cmd_parser_command_t * p_command = resolve(p_table, input, input_len, &arg, &arg_len, &i);
+	if (p_command == NULL) return CMD_PARSER_COMMAND_INVALID;
+	p_command->p_context = p_context;
+	if (dispatch(p_command, arg, arg_len) != 0) return CMD_PARSER_ARGS_INVALID;
+	return i;
+}
+
+bool cmd_parser_parse_args(cmd_parser_arg_schema_t const * p_schema, int count, char const * arg, int len, cmd_parser_arg_value_t * p_values)
+{
+	if (count > CMD_PARSER_MAX_ARGS) return false;
+	if (arg == NULL) len = 0;
+	
+	// the input is tokenized once, every token is converted right away
+	int pos = 0;
+	int buffer_used = 0;
+	for (int i = 0; i < count; i++)
+	{
+		p_values[i].present = false;
+		pos += count_whitespaces(arg + pos, len - pos);
+		if (pos >= len)
+		{
+			if (!p_schema[i].optional) return false;
+			continue;
+		}
+		
+		char const * token;
+		int token_len;
+		bool quoted;
+		if (!next_token(arg, len, &pos, &token, &token_len, &quoted)) return false;
+		if (!convert_arg(&(p_schema[i]), token, token_len, quoted, &(p_values[i]), &buffer_used)) return false;
+		p_values[i].present = true;
+	}
+	pos += count_whitespaces(arg + pos, len - pos);
+	return pos >= len;
+}
+
+int cmd_parser_hex_decode(char const * p_in, int len, uint8_t * p_out)
+{
+	if (has_suffix(p_in, len, "0x", 2))
+	{
+		p_in += 2;
+		len -= 2;
+	}
+	if (len % 2 != 0) return CMD_PARSER_ARGS_INVALID;
+	
+	uint8_t const * p_src = (uint8_t const *)p_in;
+	int const out_len = len / 2;
+	uint8_t invalid = 0;
+	int i = 0;
+	// four bytes per step, all digits are looked up before the first write so p_out may overlap p_in
+	for (; i + 4 <= out_len; i += 4, p_src += 8)
+	{
+		uint8_t const n0 = hex_table[p_src[0]];
+		uint8_t const n1 = hex_table[p_src[1]];
+		uint8_t const n2 = hex_table[p_src[2]];
+		uint8_t const n3 = hex_table[p_src[3]];
+		uint8_t const n4 = hex_table[p_src[4]];
+		uint8_t const n5 = hex_table[p_src[5]];
+		uint8_t const n6 = hex_table[p_src[6]];
+		uint8_t const n7 = hex_table[p_src[7]];
+		invalid |= n0 | n1 | n2 | n3 | n4 | n5 | n6 | n7;
+		p_out[i] = (n0 << 4) | n1;
+		p_out[i + 1] = (n2 << 4) | n3;
+		p_out[i + 2] = (n4 << 4) | n5;
+		p_out[i + 3] = (n6 << 4) | n7;
+	}
+	for (; i < out_len; i++, p_src += 2)
+	{
+		uint8_t const high = hex_table[p_src[0]];
+		uint8_t const low = hex_table[p_src[1]];
+		invalid |= high | low;
+		p_out[i] = (high << 4) | low;
+	}
+	// invalid digits have the top bit set, checked once at the end
+	if (invalid & 0x80) return CMD_PARSER_ARGS_INVALID;
+	return out_len;
+}
+
+int cmd_parser_base64_decode(char const * p_in, int len, uint8_t * p_out)
+{
+	if (len % 4 == 0 && len > 0 && p_in[len - 1] == '=') len--;
+	if (len % 4 == 3 && p_in[len - 1] == '=') len--;
+	if (len % 4 == 1) return CMD_PARSER_ARGS_INVALID;
+	
+	uint8_t const * p_src = (uint8_t const *)p_in;
+	int const quads = len / 4;
+	uint8_t invalid = 0;
+	int out_len = 0;
+	for (int i = 0; i < quads; i++, p_src += 4)
+	{
+		uint8_t const a = base64_table[p_src[0]];
+		uint8_t const b = base64_table[p_src[1]];
+		uint8_t const c = base64_table[p_src[2]];
+		uint8_t const d = base64_table[p_src[3]];
+		invalid |= a | b | c | d;
+		uint32_t const bits = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+		p_out[out_len++] = bits >> 16;
+		p_out[out_len++] = bits >> 8;
+		p_out[out_len++] = bits;
+	}
+	
+	// unpadded tail of two or three characters
+	int const rest = len % 4;
+	if (rest != 0)
+	{
+		uint8_t const a = base64_table[p_src[0]];
+		uint8_t const b = base64_table[p_src[1]];
+		uint8_t const c = (rest == 3) ? base64_table[p_src[2]] : 0;
+		invalid |= a | b | c;
+		uint32_t const bits = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+		p_out[out_len++] = bits >> 16;
+		if (rest == 3) p_out[out_len++] = bits >> 8;
+	}
+	if (invalid & 0x80) return CMD_PARSER_ARGS_INVALID;
+	return out_len;
+}
+
+void cmd_parser_set_response(cmd_parser_response_t * p_response)
+{
+	p_active_response = p_response;
+}
+
+int cmd_parser_reply(char const * format, ...)
+{
+	if (p_active_response == NULL) return -1;
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		int const space = p_active_response->size - p_active_response->len;
+		va_list args;
+		va_start(args, format);
+		int const printed = vsnprintf(p_active_response->p_buffer + p_active_response->len, space, format, args);
+		va_end(args);
+		if (printed < 0) return printed;
+		if (printed < space)
+		{
+			p_active_response->len += printed;
+			return printed;
+		}
+		// does not fit anymore, send what was collected and retry in the empty buffer
+		if (p_active_response->len == 0 || response_flush_blocked) break;
+		cmd_parser_response_flush();
+	}
+	// longer than the whole buffer, truncated by vsnprintf
+	p_active_response->len = p_active_response->size - 1;
+	return p_active_response->len;
+}
+
+void cmd_parser_response_flush(void)
+{
+	if (p_active_response == NULL || p_active_response->len == 0) return;
+	if (p_active_response->flush_fpt != NULL) p_active_response->flush_fpt(p_active_response->p_context, p_active_response->p_buffer, p_active_response->len);
+	p_active_response->len = 0;
+}
+
+int cmd_parser_reply_bytes(void const * p_data, int len)
+{
+	if (p_active_response == NULL) return -1;
+	if (p_active_response->size - p_active_response->len < len && !response_flush_blocked) cmd_parser_response_flush();
+	if (p_active_response->size - p_active_response->len < len) len = p_active_response->size - p_active_response->len;
+	memcpy(p_active_response->p_buffer + p_active_response->len, p_data, len);
+	p_active_response->len += len;
+	return len;
+}
+
+int cmd_parser_batch_parse(cmd_parser_table_t * p_table, char const * input, int input_len)
+{
+	int executed = 0;
+	int start = 0;
+	bool quoted = false;
+	for (int i = 0; i <= input_len; i++)
+	{
+		// separators inside quoted arguments do not split
+		if (i < input_len)
+		{
+			if (quoted && input[i] == '\\' && i + 1 < input_len)
+			{
+				i++;
+				continue;
+			}
+			if (input[i] == '"') quoted = !quoted;
+			if (quoted || (input[i] != ';' && input[i] != '\n')) continue;
+		}
+		
+		int const begin = start + count_whitespaces(input + start, i - start);
+		int end = i;
+		while (end > begin && is_whitespace(input[end - 1])) end--;
+		start = i + 1;
+		if (end == begin) continue;
+		
+		int const result = cmd_parser_table_parse(p_table, input + begin, end - begin);
+		if (result < 0)
+		{
+			cmd_parser_reply("error %d: %.*s\n", result, end - begin, input + begin);
+			cmd_parser_response_flush();
+			return result;
+		}
+		executed++;
+	}
+	cmd_parser_response_flush();
+	return executed;
+}
+
+int cmd_parser_block_feed(cmd_parser_block_t * p_block, cmd_parser_table_t * p_table, char const * line, int len)
+{
+	int const whitespaces = count_whitespaces(line, len);
+	line += whitespaces;
+	len -= whitespaces;
+	while (len > 0 && is_whitespace(line[len - 1])) len--;
+	
+	if (!p_block->open)
+	{
+		if (!is_word(line, len, CMD_PARSER_BLOCK_BEGIN)) return cmd_parser_batch_parse(p_table, line, len);
+		p_block->open = true;
+		p_block->overflow = false;
+		p_block->len = 0;
+		return CMD_PARSER_BLOCK_PENDING;
+	}
+	
+	if (!is_word(line, len, CMD_PARSER_BLOCK_END))
+	{
+		if (p_block->len + len + 1 > p_block->size)
+		{
+			p_block->overflow = true;
+			return CMD_PARSER_BLOCK_PENDING;
+		}
+		memcpy(p_block->p_buffer + p_block->len, line, len);
+		p_block->len += len;
+		p_block->p_buffer[p_block->len++] = '\n';
+		return CMD_PARSER_BLOCK_PENDING;
+	}
+	
+	// a partially stored block is not executed at all
+	p_block->open = false;
+	if (p_block->overflow)
+	{
+		cmd_parser_reply("error %d: block too long\n", CMD_PARSER_BLOCK_OVERFLOW);
+		cmd_parser_response_flush();
+		return CMD_PARSER_BLOCK_OVERFLOW;
+	}
+	return cmd_parser_batch_parse(p_table, p_block->p_buffer, p_block->len);
+}
+
+int cmd_parser_binary_parse(cmd_parser_table_t * p_table, char const * input, int input_len)
+{
+	uint8_t const * p_frame = (uint8_t const *)input;
+	if (input_len < 1 || p_frame[0] != CMD_PARSER_BINARY_MAGIC) return CMD_PARSER_BINARY_INVALID;
+	if (input_len < CMD_PARSER_BINARY_HEADER_SIZE) return CMD_PARSER_BINARY_INCOMPLETE;
+	int const payload_len = p_frame[2];
+	if (input_len < CMD_PARSER_BINARY_HEADER_SIZE + payload_len + 2) return CMD_PARSER_BINARY_INCOMPLETE;
+	
+	// bytes behind the crc are ignored, e.g. the line delimiter terminating the frame
+	uint8_t const * p_payload = p_frame + CMD_PARSER_BINARY_HEADER_SIZE;
+	uint16_t const crc = read_le(p_payload + payload_len, 2);
+	if (crc16(0xFFFF, p_frame, CMD_PARSER_BINARY_HEADER_SIZE + payload_len) != crc) return CMD_PARSER_BINARY_INVALID;
+	
+	int const index = p_frame[1];
+	int result = CMD_PARSER_COMMAND_INVALID;
+	if (p_active_response != NULL)
+	{
+		// the response frame starts in an empty buffer, handler output is truncated instead of flushed until it is closed
+		cmd_parser_response_flush();
+		p_active_response->len = CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE;
+		response_flush_blocked = true;
+	}
+	
+	if (index < p_table->command_count)
+	{
+		cmd_parser_command_t const * p_command = &(p_table->command_list[index]);
+		cmd_parser_arg_value_t values[CMD_PARSER_MAX_ARGS];
+		if ((p_command->p_arg_schema == NULL) && (p_command->typed_fpt == NULL))
+		{
+			if (p_command->command_fpt != NULL)
+			{
+				p_command->command_fpt(p_command, (char const *)p_payload, payload_len);
+				result = index;
+			}
+		}
+		else if (!decode_binary_args(p_command->p_arg_schema, p_command->arg_count, p_payload, payload_len, values))
+		{
+			result = CMD_PARSER_ARGS_INVALID;
+		}
+		else
+		{
+			if (p_command->typed_fpt != NULL) p_command->typed_fpt(p_command, values, p_command->arg_count);
+			else p_command->command_fpt(p_command, (char const *)p_payload, payload_len);
+			result = index;
+		}
+	}
+	
+	if (p_active_response != NULL)
+	{
+		response_flush_blocked = false;
+		int data_len = p_active_response->len - CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE;
+		int const data_max = p_active_response->size - CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE - 2;
+		if (data_len > data_max) data_len = data_max;
+		if (data_len > UINT8_MAX) data_len = UINT8_MAX;
+		
+		uint8_t * p_reply = (uint8_t *)p_active_response->p_buffer;
+		p_reply[0] = CMD_PARSER_BINARY_MAGIC;
+		p_reply[1] = index;
+		p_reply[2] = (result < 0) ? (uint8_t)result : 0;
+		p_reply[3] = data_len;
+		uint16_t const reply_crc = crc16(0xFFFF, p_reply, CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE + data_len);
+		p_reply[CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE + data_len] = reply_crc & 0xFF;
+		p_reply[CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE + data_len + 1] = reply_crc >> 8;
+		p_active_response->len = CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE + data_len + 2;
+		cmd_parser_response_flush();
+	}
+	return result;
+}
+
+int cmd_parser_auto_parse(cmd_parser_table_t * p_table, char const * input, int input_len)
+{
+	if (input_len > 0 && (uint8_t)input[0] == CMD_PARSER_BINARY_MAGIC) return cmd_parser_binary_parse(p_table, input, input_len);
+	return cmd_parser_batch_parse(p_table, input, input_len);
 }
\ No newline at end of file
@@ -12,9 +12,95 @@
 #define CMD_PARSER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define CMD_PARSER_COMMAND_INVALID -1
+#define CMD_PARSER_ARGS_INVALID -2     // the command was found but its arguments do not match the schema
+#define CMD_PARSER_BLOCK_PENDING -3    // the line was stored in an open begin/end block
+#define CMD_PARSER_BLOCK_OVERFLOW -4   // the block did not fit into its buffer, nothing was executed
+#define CMD_PARSER_BINARY_INCOMPLETE -5 // append the next line (including its delimiter) and parse again
+#define CMD_PARSER_BINARY_INVALID -6   // wrong magic or crc
 #define CMD_PARSER_COUNT(COMMANDS) (sizeof(COMMANDS) / sizeof(COMMANDS[0]))
+#define CMD_PARSER_ARGS(SCHEMA) .p_arg_schema = SCHEMA, .arg_count = CMD_PARSER_COUNT(SCHEMA)
+
+#ifndef CMD_PARSER_THREAD_LOCAL
+#define CMD_PARSER_THREAD_LOCAL        // set to __thread if commands are parsed on several threads (see cmd_executor)
+#endif // !CMD_PARSER_THREAD_LOCAL
+
+#ifndef CMD_PARSER_MAX_ARGS
+#define CMD_PARSER_MAX_ARGS 8
+#endif // !CMD_PARSER_MAX_ARGS
+
+#ifndef CMD_PARSER_ARG_BUFFER_SIZE
+#define CMD_PARSER_ARG_BUFFER_SIZE 128 // shared by the string and byte arguments of one command
+#endif // !CMD_PARSER_ARG_BUFFER_SIZE
+
+// binary requests:  [magic][opcode][payload length][payload][crc16 le]
+// binary responses: [magic][opcode][status][data length][data][crc16 le]
+// The opcode is the index into the command list, so new commands have to be appended to keep opcodes stable.
+// The payload holds the schema arguments little endian, strings and byte arrays with a length byte in front.
+// Commands without schema get the raw payload. The crc is crc-16/ccitt-false over everything in front of it.
+#ifndef CMD_PARSER_BINARY_MAGIC
+#define CMD_PARSER_BINARY_MAGIC 0xB5   // not printable, so text commands never start with it
+#endif // !CMD_PARSER_BINARY_MAGIC
+
+#define CMD_PARSER_BINARY_HEADER_SIZE 3
+#define CMD_PARSER_BINARY_RESPONSE_HEADER_SIZE 4
+
+#ifndef CMD_PARSER_BLOCK_BEGIN
+#define CMD_PARSER_BLOCK_BEGIN "begin"
+#endif // !CMD_PARSER_BLOCK_BEGIN
+
+#ifndef CMD_PARSER_BLOCK_END
+#define CMD_PARSER_BLOCK_END "end"
+#endif // !CMD_PARSER_BLOCK_END
+
+typedef enum cmd_parser_arg_type_e
+{
+	CMD_PARSER_ARG_INT32,
+	CMD_PARSER_ARG_INT64,
+	CMD_PARSER_ARG_UINT32,
+	CMD_PARSER_ARG_FLOAT,
+	CMD_PARSER_ARG_BOOL,       // 1/0, true/false, on/off, yes/no
+	CMD_PARSER_ARG_ENUM,       // index into enum_names
+	CMD_PARSER_ARG_STRING,     // single word or "quoted string" with \" and \\ escapes, null terminated
+	CMD_PARSER_ARG_HEX_BYTES,  // even number of hex digits with optional 0x prefix
+	CMD_PARSER_ARG_BASE64_BYTES, // standard alphabet, padding is optional
+} cmd_parser_arg_type_t;
+
+// integers are accepted as decimal, 0x hex or 0b binary
+typedef struct cmd_parser_arg_schema_s
+{
+	char const * name;
+	cmd_parser_arg_type_t type;
+	bool optional;             // only allowed for the last arguments
+	int64_t min;               // range of numbers, not checked if min == max
+	int64_t max;
+	char const * const * enum_names;
+	int enum_count;
+	int max_len;               // bytes of strings and byte arrays, 0 is only limited by CMD_PARSER_ARG_BUFFER_SIZE
+} cmd_parser_arg_schema_t;
+
+typedef struct cmd_parser_arg_value_s
+{
+	bool present;              // false for omitted optional arguments
+	union {
+		int32_t i32;
+		int64_t i64;
+		uint32_t u32;
+		float f;
+		bool b;
+		int enum_index;
+		struct {
+			char const * p_data;
+			int len;
+		} string;
+		struct {
+			uint8_t const * p_data;
+			int len;
+		} bytes;
+	} value;
+} cmd_parser_arg_value_t;
 
 typedef struct cmd_parser_command_t
 {
@@ -22,12 +108,101 @@ typedef struct cmd_parser_command_t
 	char const * description;
 	void(*command_fpt)(struct cmd_parser_command_t const * self, char const * arg, int len);
 	void * p_context;
+	struct cmd_parser_table_s * p_subcommands;  // tried on the rest of the input first, command_fpt may be NULL for pure groups
+	cmd_parser_arg_schema_t const * p_arg_schema; // arguments are converted and checked before dispatch if set
+	int arg_count;
+	void(*typed_fpt)(struct cmd_parser_command_t const * self, cmd_parser_arg_value_t const * args, int count); // called instead of command_fpt, without a schema it takes no arguments
+	uint8_t max_jobs;          // jobs of this command cmd_executor accepts at once, 0 is unlimited
 } cmd_parser_command_t;
 
+// command list with cached name lengths and a sorted index, created with CMD_PARSER_TABLE_DEFINE.
+// Names may be abbreviated to any unique prefix, an exact match always wins.
+typedef struct cmd_parser_table_s
+{
+	cmd_parser_command_t * command_list;
+	int command_count;
+	uint8_t * name_len;
+	uint16_t * sorted;
+	bool compiled;
+	int name_width;            // help column widths, calculated by cmd_parser_table_compile
+	int description_width;
+} cmd_parser_table_t;
+
+#define CMD_PARSER_TABLE_DEFINE(NAME, COMMANDS) \
+	static uint8_t NAME##_name_len[CMD_PARSER_COUNT(COMMANDS)]; \
+	static uint16_t NAME##_sorted[CMD_PARSER_COUNT(COMMANDS)]; \
+	static cmd_parser_table_t NAME = { \
+		.command_list = COMMANDS, \
+		.command_count = CMD_PARSER_COUNT(COMMANDS), \
+		.name_len = NAME##_name_len, \
+		.sorted = NAME##_sorted, \
+		.compiled = false, \
+	}
+
+// collects the output of cmd_parser_reply() so a batch is answered with one transmission
+typedef struct cmd_parser_response_s
+{
+	char * p_buffer;
+	int size;
+	int len;
+	void(*flush_fpt)(void * p_context, char const * p_data, int len); // e.g. one serial_send() on the transport the batch came from
+	void * p_context;
+} cmd_parser_response_t;
+
+#define CMD_PARSER_RESPONSE_DEFINE(NAME, SIZE, FLUSH, CONTEXT) \
+	static char NAME##_buffer[SIZE]; \
+	static cmd_parser_response_t NAME = { \
+		.p_buffer = NAME##_buffer, \
+		.size = SIZE, \
+		.len = 0, \
+		.flush_fpt = FLUSH, \
+		.p_context = CONTEXT, \
+	}
+
+// lines between CMD_PARSER_BLOCK_BEGIN and CMD_PARSER_BLOCK_END are stored and executed as one batch
+typedef struct cmd_parser_block_s
+{
+	char * p_buffer;
+	int size;
+	int len;
+	bool open;
+	bool overflow;
+} cmd_parser_block_t;
+
+#define CMD_PARSER_BLOCK_DEFINE(NAME, SIZE) \
+	static char NAME##_buffer[SIZE]; \
+	static cmd_parser_block_t NAME = { \
+		.p_buffer = NAME##_buffer, \
+		.size = SIZE, \
+	}
+
 int cmd_parser_parse(char const * input, int input_len, cmd_parser_command_t const * command_list, int command_count);
 int cmd_parser_parse_and_set_context(char const * input, int input_len, cmd_parser_command_t * command_list, int command_count, void * p_context);
 int cmd_parser_print_title(char * buffer, int buffer_size, cmd_parser_command_t const * command_list, int command_count, char const * title);
 int cmd_parser_print_command(char * buffer, int buffer_size, cmd_parser_command_t const * command_list, int command_count, int index);
 bool cmd_parser_arg_to_int(char const * arg, int len, int * result);
 
+int cmd_parser_table_compile(cmd_parser_table_t * p_table);
+int cmd_parser_table_parse(cmd_parser_table_t * p_table, char const * input, int input_len);
+// streams "name - description" lines in sorted order into the active response, returns the number of commands printed
+int cmd_parser_table_print_help(cmd_parser_table_t * p_table, char const * title, char const * prefix, int prefix_len);
+cmd_parser_command_t const * cmd_parser_table_find(cmd_parser_table_t * p_table, char const * input, int input_len);
+int cmd_parser_table_parse_and_set_context(cmd_parser_table_t * p_table, char const * input, int input_len, void * p_context);
+// bulk decoders for large payloads, p_out may be p_in to decode in place.
+// return the number of bytes written or CMD_PARSER_ARGS_INVALID, p_out is garbage on error
+int cmd_parser_hex_decode(char const * p_in, int len, uint8_t * p_out);
+int cmd_parser_base64_decode(char const * p_in, int len, uint8_t * p_out);
+bool cmd_parser_parse_args(cmd_parser_arg_schema_t const * p_schema, int count, char const * arg, int len, cmd_parser_arg_value_t * p_values);
+
+void cmd_parser_set_response(cmd_parser_response_t * p_response);
+int cmd_parser_reply(char const * format, ...);
+void cmd_parser_response_flush(void);
+// executes commands separated by ';' or newlines, stops at the first failing command and flushes the response once
+int cmd_parser_batch_parse(cmd_parser_table_t * p_table, char const * input, int input_len);
+int cmd_parser_block_feed(cmd_parser_block_t * p_block, cmd_parser_table_t * p_table, char const * line, int len);
+int cmd_parser_reply_bytes(void const * p_data, int len);
+int cmd_parser_binary_parse(cmd_parser_table_t * p_table, char const * input, int input_len);
+// binary requests are recognized by their first byte, everything else goes to cmd_parser_batch_parse()
+int cmd_parser_auto_parse(cmd_parser_table_t * p_table, char const * input, int input_len);
+
 #endif /* CMD_PARSER_H_ */
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/random/rand32.h>
 #include <bluetooth/scan.h>
 
 
@@ -11,57 +12,770 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 
 #define BT_LE_OPEN_NETWORK_UUID { 0x2c, 0x4c, 0xc0, 0xf0, 0x37, 0x83, 0x84, 0xec, 0x97, 0xac, 0xfb, 0x32 }
 
-typedef struct service_data_s
+#define NETWORK_ID 0x12345678
+
+// Wire format, all integers little endian, the same in tools/helios_ble_codec.py:
+//   manufacturer data: company id (2), version (1), network hash (2), records until the end of the AD structure
+//   record: node id (1), seq (2), ttl (1), pattern (1), node count (1), network time (varint)
+// The network time is a zigzag LEB128 varint in us since the network epoch for the first record and relative to
+// the first record for the others.
+#define WIRE_VERSION 1
+#define WIRE_HEADER_LEN 5
+#define WIRE_RECORD_FIXED_LEN 6
+#define WIRE_VARINT_MAX_LEN 10
+
+// legacy adverts hold 31 bytes, the AD headers and on the main set the device name are taken from that
+#if HELIOS_BLE_LEGACY_ADV
+#define ADV_PAYLOAD_MAX (31 - 2 - (2 + sizeof(CONFIG_BT_DEVICE_NAME) - 1))
+#define RELAY_PAYLOAD_MAX (31 - 2)
+#define ADV_OPTIONS 0
+#else
+#define ADV_PAYLOAD_MAX 240
+#define RELAY_PAYLOAD_MAX 240
+#define ADV_OPTIONS BT_LE_ADV_OPT_EXT_ADV
+#endif // HELIOS_BLE_LEGACY_ADV
+
+#if HELIOS_BLE_LEGACY_ADV && defined(CONFIG_BT_PER_ADV)
+#error "periodic advertising needs extended advertising, HELIOS_BLE_LEGACY_ADV has to be 0"
+#endif
+
+// a message as it is kept in memory
+typedef struct message_s
 {
-    uint8_t uuid[12];
-    uint32_t network_id;
-    helios_ble_data_t helios_data;
-} service_data_t;
-static service_data_t service_data = {
-    .uuid = BT_LE_OPEN_NETWORK_UUID,
-    .network_id = 0x12345678,
-    .helios_data = { 0 },
-};
-static service_data_t received_service_data;
+    uint16_t seq;                     // per origin node, counted up by helios_ble_send_batch()
+    uint8_t ttl;                      // relays left, HELIOS_BLE_RELAY_TTL at the origin
+    helios_ble_data_t data;
+} message_t;
+
+static uint8_t const network_uuid[] = BT_LE_OPEN_NETWORK_UUID;
+static uint16_t network_hash;         // of network_uuid and NETWORK_ID, set by helios_ble_enable()
+static uint8_t adv_payload[ADV_PAYLOAD_MAX];
+static uint16_t own_seq = 0;
+static uint16_t forward_seq[HELIOS_BLE_MAX_NODES];    // of the records helios_ble_send_batch() sends for other nodes
+
+#if (HELIOS_BLE_RX_QUEUE_SIZE & (HELIOS_BLE_RX_QUEUE_SIZE - 1)) != 0
+#error "HELIOS_BLE_RX_QUEUE_SIZE has to be a power of 2"
+#endif
+
+// single producer (scan_cb) single consumer queue, the free running indexes are only written by one side each
+static helios_ble_record_t rx_queue[HELIOS_BLE_RX_QUEUE_SIZE];
+static atomic_t rx_head;
+static atomic_t rx_tail;
+static atomic_t rx_dropped;
+static helios_ble_record_t received_record;
+
+static helios_ble_scan_stats_t scan_stats;   // only written by the bluetooth receive callbacks
+
+#define NODE_AVERAGE_SHIFT 3          // moving averages keep 1/8 of every new sample
+#define NODE_LOSS_ONE 1024            // fixed point 1.0 of the loss estimate
+#define SEQ_DUPLICATE_WINDOW 64       // relayed messages behind the last one of a node that are taken as duplicates
+
+typedef struct node_entry_s
+{
+    bool active;
+    bool heard_direct;
+    int16_t rssi_q4;                  // rssi * 16
+    uint16_t loss_q10;
+    uint16_t seq;                     // of the last message, older ones are duplicates
+    int64_t last_direct;              // k_uptime_ticks() of the last advert of the node itself
+    uint8_t scan_level;               // scan duty level last_direct was received with
+    helios_ble_node_t node;
+} node_entry_t;
+
+// indexed by node id, written by scan_cb and aged out by the readers, protected by irq_lock
+static node_entry_t node_table[HELIOS_BLE_MAX_NODES];
+static int active_node_count;
+
+#define SYNC_KP_DIV 4                 // share of the phase error corrected per window
+#define SYNC_KI_DIV 128               // share of the measured frequency error added to the drift per window
+#define SYNC_HOLDOVER_PPM 20          // residual drift assumed for the error estimate between corrections
+
+// network time = base_network_us + elapsed local time corrected by drift_ppb, protected by irq_lock
+typedef struct sync_state_s
+{
+    int64_t base_local_us;
+    int64_t base_network_us;
+    int32_t drift_ppb;
+    int64_t last_sample_us;           // last advert of the reference
+    int64_t last_servo_us;            // last correction of the local clock
+    int window_count;
+    int64_t window_error_us;
+    int64_t window_local_us;
+    uint32_t jitter_us;               // moving average of the absolute error at the corrections
+    int reference_id;                 // -1 while no lower node was heard
+    bool synchronized;
+} sync_state_t;
+static sync_state_t sync_state = { .reference_id = -1 };
+static int own_id = -1;               // taken from the first helios_ble_send()
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(CONFIG_BT_DEVICE_NAME) - 1)
-static const struct bt_data advertising_data[] = {
-	BT_DATA(BT_DATA_SVC_DATA128, &service_data, sizeof(service_data)),
+// the length is set for the number of records sent
+static struct bt_data advertising_data[] = {
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, adv_payload, 0),
 };
 static struct bt_le_ext_adv *adv;
-K_SEM_DEFINE(sem_data_received, 0, 1);
+static bool adv_running = false;      // started by the first helios_ble_send_batch(), repeats its data on its own
+// the encoded batch of the last helios_ble_send_batch(), protected by adv_lock. Only the first record carries an
+// absolute network time, the others are relative to it.
+static int adv_len;
+static int adv_stamp_len;             // of the first record
+static message_t adv_stamp_message;   // the first record, encoded again with a new network time by adv_stamp_work
+static K_MUTEX_DEFINE(adv_lock);
+static struct k_work_delayable adv_stamp_work;
+
+#define ADV_INTERVAL (HELIOS_BLE_ADV_INTERVAL_MS * 8 / 5)            // 0.625 ms units
+#define PER_ADV_INTERVAL (HELIOS_BLE_PER_ADV_INTERVAL_MS * 4 / 5)    // 1.25 ms units
+#define RELAY_ADV_INTERVAL 0x20                                      // 20 ms, relayed messages go out right away
+
+#if defined(CONFIG_BT_PER_ADV_SYNC)
+typedef struct per_sync_s
+{
+    struct bt_le_per_adv_sync * p_sync;   // NULL while the slot is free
+    bt_addr_le_t addr;
+    bool established;
+} per_sync_t;
+// only used by the bluetooth callbacks
+static per_sync_t per_syncs[CONFIG_BT_PER_ADV_SYNC_MAX];
+static bool per_sync_pending = false;     // the controller establishes one sync at a time
+#endif // CONFIG_BT_PER_ADV_SYNC
+
+// a window of one advertising interval plus the maximum advertising delay catches every neighbor once
+#define SCAN_WINDOW ((HELIOS_BLE_ADV_INTERVAL_MS + 10) * 8 / 5)         // 0.625 ms units
+#define SCAN_INTERVAL_MS(level) ((SCAN_WINDOW << (level)) * 5 / 8)
+#define SCAN_BURST_MARGIN 4           // messages per period above twice the average that count as a burst
+
+#if (SCAN_WINDOW << HELIOS_BLE_SCAN_MAX_LEVEL) > 0x4000
+#error "HELIOS_BLE_SCAN_MAX_LEVEL exceeds the longest scan interval"
+#endif
+
+static struct bt_le_scan_param ble_scan_params = { 
+	.interval = SCAN_WINDOW,
+	.window = SCAN_WINDOW,
+	.timeout = 0,
+	.type = BT_LE_SCAN_TYPE_PASSIVE,
+	.options = BT_LE_SCAN_OPT_NONE,
+};
+static K_MUTEX_DEFINE(scan_lock);    // the scanner is restarted by the duty adaption and the accept list
+
+// only written by scan_adapt_work_handler
+typedef struct scan_adapt_s
+{
+    int level;                        // scan interval = window * 2^level
+    uint32_t last_messages;
+    uint32_t last_missed;
+    int32_t message_average;          // messages per period
+    uint8_t missed_percent;
+} scan_adapt_t;
+static scan_adapt_t scan_adapt;
+static struct k_work_delayable scan_adapt_work;
+
+K_SEM_DEFINE(sem_data_received, 0, 1);    // wakes up the consumer, the number of records is taken from the queue
+
+// relayed messages wait a random backoff on their own advertising set, all messages due are sent in one advert
+typedef struct relay_entry_s
+{
+    bool used;
+    uint8_t heard;                    // copies of the message received from other relays while waiting
+    int64_t due;                      // k_uptime_get()
+    message_t message;
+} relay_entry_t;
+static relay_entry_t relay_queue[HELIOS_BLE_RELAY_QUEUE_SIZE];   // protected by irq_lock
+static bool relay_busy = false;
+static uint8_t relay_payload[RELAY_PAYLOAD_MAX];
+static struct bt_data relay_advertising_data[] = {
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, relay_payload, 0),
+};
+static struct bt_le_ext_adv *relay_adv;
+static struct k_work_delayable relay_work;
+static helios_ble_relay_stats_t relay_stats;
+
+static int64_t local_now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+// irq_lock has to be held
+static int64_t network_time_at(int64_t local_us)
+{
+	int64_t const elapsed = local_us - sync_state.base_local_us;
+	return sync_state.base_network_us + elapsed + elapsed * sync_state.drift_ppb / 1000000000;
+}
+
+// irq_lock has to be held
+static bool is_reference(int64_t local_us)
+{
+	if (own_id < 0) return false;
+	return sync_state.reference_id < 0 || (local_us - sync_state.last_sample_us) > HELIOS_BLE_SYNC_TIMEOUT_MS * 1000LL;
+}
+
+static void sync_sample(uint8_t node_id, int64_t remote_time_us, int64_t rx_local_us)
+{
+	unsigned int key = irq_lock();
+	bool const reference_lost = (sync_state.reference_id < 0) || (rx_local_us - sync_state.last_sample_us) > HELIOS_BLE_SYNC_TIMEOUT_MS * 1000LL;
+	if ((own_id >= 0 && node_id >= own_id) || (!reference_lost && node_id > sync_state.reference_id))
+	{
+		irq_unlock(key);
+		return;
+	}
+	if (node_id != sync_state.reference_id)
+	{
+		// a new reference has its own clock, the drift learned so far does not apply
+		sync_state.reference_id = node_id;
+		sync_state.synchronized = false;
+		sync_state.drift_ppb = 0;
+	}
+	sync_state.last_sample_us = rx_local_us;
+
+	int64_t const error = remote_time_us + HELIOS_BLE_SYNC_PATH_DELAY_US - network_time_at(rx_local_us);
+	if (!sync_state.synchronized)
+	{
+		sync_state.base_network_us = remote_time_us + HELIOS_BLE_SYNC_PATH_DELAY_US;
+		sync_state.base_local_us = rx_local_us;
+		sync_state.last_servo_us = rx_local_us;
+		sync_state.jitter_us = 0;
+		sync_state.window_count = 0;
+		sync_state.synchronized = true;
+		irq_unlock(key);
+		return;
+	}
+
+	// the advertising delay only ever adds latency, so the sample with the largest error of a window arrived fastest
+	if (sync_state.window_count == 0 || error > sync_state.window_error_us)
+	{
+		sync_state.window_error_us = error;
+		sync_state.window_local_us = rx_local_us;
+	}
+	if (++sync_state.window_count < HELIOS_BLE_SYNC_WINDOW)
+	{
+		irq_unlock(key);
+		return;
+	}
+	sync_state.window_count = 0;
+
+	int64_t const window_error = sync_state.window_error_us;
+	int64_t const estimated = network_time_at(sync_state.window_local_us);
+	if (window_error > HELIOS_BLE_SYNC_STEP_US || window_error < -HELIOS_BLE_SYNC_STEP_US)
+	{
+		sync_state.base_network_us = estimated + window_error;
+	}
+	else
+	{
+		// proportional phase correction plus an integrated frequency correction
+		int64_t const elapsed = sync_state.window_local_us - sync_state.last_servo_us;
+		if (elapsed > 0)
+		{
+			int64_t drift = sync_state.drift_ppb + (window_error * 1000000000 / elapsed) / SYNC_KI_DIV;
+			if (drift > HELIOS_BLE_SYNC_MAX_DRIFT_PPB) drift = HELIOS_BLE_SYNC_MAX_DRIFT_PPB;
+			if (drift < -HELIOS_BLE_SYNC_MAX_DRIFT_PPB) drift = -HELIOS_BLE_SYNC_MAX_DRIFT_PPB;
+			sync_state.drift_ppb = drift;
+		}
+		sync_state.base_network_us = estimated + window_error / SYNC_KP_DIV;
+	}
+	uint32_t const abs_error = (window_error < 0) ? -window_error : window_error;
+	sync_state.jitter_us += ((int32_t)abs_error - (int32_t)sync_state.jitter_us) / 8;
+	sync_state.base_local_us = sync_state.window_local_us;
+	sync_state.last_servo_us = sync_state.window_local_us;
+	irq_unlock(key);
+}
+
+// returns false if the message was already received, directly or through a relay. scan_level is the scan duty level
+// the advert was received with, 0 for periodic adverts.
+static bool node_update(helios_ble_data_t const * p_data, uint16_t seq, uint8_t hops, bt_addr_le_t const * addr, int8_t rssi, int64_t timestamp, int scan_level)
+{
+	if (p_data->node_id >= HELIOS_BLE_MAX_NODES) return true;
+
+	unsigned int key = irq_lock();
+	node_entry_t * p_entry = &node_table[p_data->node_id];
+	if (!p_entry->active)
+	{
+		memset(p_entry, 0, sizeof(node_entry_t));
+		p_entry->active = true;
+		p_entry->seq = seq - 1;
+		p_entry->node.node_id = p_data->node_id;
+		active_node_count++;
+	}
+	// sequence numbers wrap around, a message is new if it is ahead of the last one. Relayed copies are only a
+	// few messages behind, anything further back comes from a node that restarted its sequence. A node sends its
+	// own messages in order, so one heard directly that goes back at all restarted as well.
+	uint16_t const behind = p_entry->seq - seq;
+	bool const fresh = (seq != p_entry->seq) && ((hops == 0) || (behind > SEQ_DUPLICATE_WINDOW));
+	if (fresh)
+	{
+		// gaps up to half the sequence range are messages that were never received, larger ones are restarts
+		uint16_t const ahead = seq - p_entry->seq;
+		if (ahead < 0x8000) scan_stats.missed += ahead - 1;
+		p_entry->seq = seq;
+		p_entry->node.pattern = p_data->pattern;
+		p_entry->node.hops = hops;
+	}
+	if (hops == 0)
+	{
+		// the link quality is only taken from adverts of the node itself
+		if (p_entry->heard_direct)
+		{
+			// every missed interval counts as one lost advert. A reduced scan duty hears at most one advert per scan
+			// interval, gaps during which the duty changed are left out.
+			if (p_entry->scan_level == scan_level)
+			{
+				int32_t interval_ms = HELIOS_BLE_NODE_TX_INTERVAL_MS;
+				if (scan_level > 0 && SCAN_INTERVAL_MS(scan_level) > interval_ms) interval_ms = SCAN_INTERVAL_MS(scan_level);
+				int64_t const gap_ms = k_ticks_to_ms_floor64(timestamp - p_entry->last_direct);
+				int32_t const missed = (gap_ms + interval_ms / 2) / interval_ms - 1;
+				int32_t const loss = (missed > 0) ? (missed * NODE_LOSS_ONE / (missed + 1)) : 0;
+				p_entry->loss_q10 += (loss - p_entry->loss_q10) >> NODE_AVERAGE_SHIFT;
+			}
+			p_entry->rssi_q4 += (rssi * 16 - p_entry->rssi_q4) >> NODE_AVERAGE_SHIFT;
+		}
+		else
+		{
+			p_entry->heard_direct = true;
+			p_entry->rssi_q4 = rssi * 16;
+		}
+		p_entry->last_direct = timestamp;
+		p_entry->scan_level = scan_level;
+		bt_addr_le_copy(&p_entry->node.addr, addr);
+		p_entry->node.packets++;
+		p_entry->node.hops = 0;
+	}
+	p_entry->node.last_seen = timestamp;
+	irq_unlock(key);
+	return fresh;
+}
 
-static bool bt_data_parser(struct bt_data * data, void * user_data)
+static uint16_t wire_network_hash(void)
 {
-	switch (data->type)
+	// FNV-1a folded to 16 bit, only meant to tell networks apart
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < sizeof(network_uuid); i++) hash = (hash ^ network_uuid[i]) * 16777619u;
+	for (int i = 0; i < 4; i++) hash = (hash ^ ((NETWORK_ID >> (8 * i)) & 0xFF)) * 16777619u;
+	return (hash >> 16) ^ (hash & 0xFFFF);
+}
+
+static int wire_encode_header(uint8_t * p_buffer)
+{
+	p_buffer[0] = HELIOS_BLE_COMPANY_ID & 0xFF;
+	p_buffer[1] = HELIOS_BLE_COMPANY_ID >> 8;
+	p_buffer[2] = WIRE_VERSION;
+	p_buffer[3] = network_hash & 0xFF;
+	p_buffer[4] = network_hash >> 8;
+	return WIRE_HEADER_LEN;
+}
+
+// appends the message at len, returns the new length or -1 if it does not fit into size
+static int wire_encode_message(uint8_t * p_buffer, int len, int size, message_t const * p_message, int64_t base_time)
+{
+	uint8_t record[WIRE_RECORD_FIXED_LEN + WIRE_VARINT_MAX_LEN];
+	record[0] = p_message->data.node_id;
+	record[1] = p_message->seq & 0xFF;
+	record[2] = p_message->seq >> 8;
+	record[3] = p_message->ttl;
+	record[4] = p_message->data.pattern;
+	record[5] = p_message->data.node_count;
+
+	int64_t const delta = p_message->data.network_time - base_time;
+	uint64_t value = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+	int record_len = WIRE_RECORD_FIXED_LEN;
+	do
 	{
-//	case BT_DATA_NAME_COMPLETE:
-//		if (data->data_len != DEVICE_NAME_LEN) return false;
-//		if (memcmp(data->data, DEVICE_NAME, DEVICE_NAME_LEN) != 0) return false;
-//		return true;
-	case BT_DATA_SVC_DATA128:
+		record[record_len++] = (value & 0x7F) | ((value > 0x7F) << 7);
+		value >>= 7;
+	} while (value != 0);
+
+	if (len + record_len > size) return -1;
+	memcpy(p_buffer + len, record, record_len);
+	return len + record_len;
+}
+
+// reads the message at *p_offset, returns false at the end of the payload or for a truncated record.
+// *p_base_time has to be 0 for the first record and is set to its network time.
+static bool wire_decode_message(uint8_t const * p_payload, int len, int * p_offset, message_t * p_message, int64_t * p_base_time)
+{
+	int offset = *p_offset;
+	if (len - offset <= WIRE_RECORD_FIXED_LEN) return false;
+	uint8_t const * p_record = p_payload + offset;
+	p_message->data.node_id = p_record[0];
+	p_message->seq = p_record[1] | (p_record[2] << 8);
+	p_message->ttl = p_record[3];
+	p_message->data.pattern = p_record[4];
+	p_message->data.node_count = p_record[5];
+	offset += WIRE_RECORD_FIXED_LEN;
+
+	uint64_t value = 0;
+	uint8_t byte;
+	int shift = 0;
+	do
+	{
+		if (offset == len || shift >= 7 * WIRE_VARINT_MAX_LEN) return false;
+		byte = p_payload[offset++];
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	p_message->data.network_time = *p_base_time + (int64_t)((value >> 1) ^ -(value & 1));
+	if (*p_offset == WIRE_HEADER_LEN) *p_base_time = p_message->data.network_time;
+	*p_offset = offset;
+	return true;
+}
+
+// returns the payload of this network or NULL, checked in place so foreign adverts are never copied
+static uint8_t const * find_payload(struct net_buf_simple const * buf, int * p_len)
+{
+	uint8_t const * p_data = buf->data;
+	int left = buf->len;
+	while (left >= 2)
+	{
+		int const field_len = p_data[0];
+		if (field_len == 0 || field_len >= left) return NULL;
+		uint8_t const * p_payload = p_data + 2;
+		if (p_data[1] == BT_DATA_MANUFACTURER_DATA && field_len - 1 >= WIRE_HEADER_LEN &&
+			(p_payload[0] | (p_payload[1] << 8)) == HELIOS_BLE_COMPANY_ID)
 		{
-            //if (data->data_len != sizeof(service_data_t)) return false;
-			//received data might be unaligned therefore we neeed to copy it in an aligned structure
-			
-			memcpy(&received_service_data, data->data, sizeof(service_data_t));
-			if (memcmp(received_service_data.uuid, service_data.uuid, sizeof(service_data.uuid)) != 0) return false;
-            if (received_service_data.network_id != service_data.network_id) return false;
-
-            //LOG_INF("Service data received from %d", received_service_data.helios_data.node_id);
-            k_sem_give(&sem_data_received);
+			// other versions are unknown, other networks are not ours
+			if (p_payload[2] != WIRE_VERSION || (p_payload[3] | (p_payload[4] << 8)) != network_hash) return NULL;
+			*p_len = field_len - 1;
+			return p_payload;
 		}
-		return true;
-	default:
-		return true;
+		p_data += field_len + 1;
+		left -= field_len + 1;
+	}
+	return NULL;
+}
+
+static void relay_enqueue(message_t const * p_message)
+{
+	int64_t const now = k_uptime_get();
+	int64_t next_due = now + HELIOS_BLE_RELAY_BACKOFF_MIN_MS +
+		sys_rand32_get() % (HELIOS_BLE_RELAY_BACKOFF_MAX_MS - HELIOS_BLE_RELAY_BACKOFF_MIN_MS + 1);
+	unsigned int key = irq_lock();
+	relay_entry_t * p_entry = NULL;
+	for (int i = 0; i < HELIOS_BLE_RELAY_QUEUE_SIZE; i++)
+	{
+		if (!relay_queue[i].used)
+		{
+			p_entry = &relay_queue[i];
+			break;
+		}
+	}
+	if (p_entry == NULL)
+	{
+		irq_unlock(key);
+		relay_stats.dropped++;
+		return;
+	}
+	p_entry->used = true;
+	p_entry->heard = 0;
+	p_entry->due = next_due;
+	p_entry->message = *p_message;
+	p_entry->message.ttl--;
+	for (int i = 0; i < HELIOS_BLE_RELAY_QUEUE_SIZE; i++)
+	{
+		if (relay_queue[i].used && relay_queue[i].due < next_due) next_due = relay_queue[i].due;
+	}
+	irq_unlock(key);
+	relay_stats.queued++;
+	k_work_reschedule(&relay_work, K_MSEC((next_due > now) ? (next_due - now) : 0));
+}
+
+// enough neighbors already relayed the message while it was waiting, one more copy would only collide. Only copies
+// that went through a relay count, repeats of the copy that was queued (its ttl before the decrement) do not.
+static void relay_heard(uint8_t node_id, uint16_t seq, uint8_t ttl)
+{
+	unsigned int key = irq_lock();
+	for (int i = 0; i < HELIOS_BLE_RELAY_QUEUE_SIZE; i++)
+	{
+		relay_entry_t * p_entry = &relay_queue[i];
+		if (!p_entry->used || p_entry->message.data.node_id != node_id || p_entry->message.seq != seq) continue;
+		if (ttl > p_entry->message.ttl) continue;
+		if (++p_entry->heard >= HELIOS_BLE_RELAY_SUPPRESS_COUNT)
+		{
+			p_entry->used = false;
+			relay_stats.suppressed++;
+		}
+	}
+	irq_unlock(key);
+}
+
+static void relay_work_handler(struct k_work * p_work)
+{
+	unsigned int key = irq_lock();
+	if (relay_busy)
+	{
+		// relay_sent_cb schedules the next one
+		irq_unlock(key);
+		return;
+	}
+	int64_t const now = k_uptime_get();
+	int64_t next_due = INT64_MAX;
+	int64_t base_time = 0;
+	int count = 0;
+	int len = wire_encode_header(relay_payload);
+	for (int i = 0; i < HELIOS_BLE_RELAY_QUEUE_SIZE; i++)
+	{
+		relay_entry_t * p_entry = &relay_queue[i];
+		if (!p_entry->used) continue;
+		// messages that do not fit any more go with the next advert
+		int const next_len = (p_entry->due > now) ? -1 : wire_encode_message(relay_payload, len, sizeof(relay_payload), &p_entry->message, base_time);
+		if (next_len < 0)
+		{
+			if (p_entry->due < next_due) next_due = p_entry->due;
+			continue;
+		}
+		if (count++ == 0) base_time = p_entry->message.data.network_time;
+		len = next_len;
+		p_entry->used = false;
+	}
+	if (count == 0)
+	{
+		irq_unlock(key);
+		if (next_due != INT64_MAX) k_work_reschedule(&relay_work, K_MSEC(next_due - now));
+		return;
+	}
+	relay_busy = true;
+	irq_unlock(key);
+	relay_advertising_data[0].data_len = len;
+
+	int err = bt_le_ext_adv_set_data(relay_adv, relay_advertising_data, ARRAY_SIZE(relay_advertising_data), NULL, 0);
+	if (!err) {
+		struct bt_le_ext_adv_start_param relay_start_param = {
+			.num_events = HELIOS_BLE_RELAY_EVENTS,
+			.timeout = 0,
+		};
+		err = bt_le_ext_adv_start(relay_adv, &relay_start_param);
+	}
+	if (err) {
+		LOG_WRN("failed to relay %d messages (err %d)", count, err);
+		relay_stats.dropped += count;
+		relay_busy = false;
+		k_work_schedule(&relay_work, K_NO_WAIT);
+		return;
+	}
+	relay_stats.sent += count;
+	relay_stats.adverts++;
+}
+
+static void relay_sent_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_sent_info *info)
+{
+	relay_busy = false;
+	k_work_schedule(&relay_work, K_NO_WAIT);
+}
+
+// timed is false for periodic adverts, their payload keeps the network time of the last helios_ble_send()
+static void receive_message(bt_addr_le_t const * addr, int8_t rssi, message_t const * p_message, int64_t timestamp, bool timed)
+{
+	helios_ble_data_t const data = p_message->data;
+	uint16_t const seq = p_message->seq;
+	uint8_t const ttl = p_message->ttl;
+	uint8_t const hops = (ttl < HELIOS_BLE_RELAY_TTL) ? (HELIOS_BLE_RELAY_TTL - ttl) : 0;
+	// own messages coming back from relays
+	if (own_id >= 0 && data.node_id == own_id)
+	{
+		scan_stats.repeated++;
+		return;
+	}
+
+	// the stamp of the main set is refreshed while it runs, so repeats are as good for the time as new messages.
+	// Relayed messages spent an unknown time in the relay queues.
+	if (hops == 0 && timed) sync_sample(data.node_id, data.network_time, k_ticks_to_us_floor64(timestamp));
+	// repeats still count for the link quality
+	// periodic adverts are received independent of the scan duty
+	if (!node_update(&data, seq, hops, addr, rssi, timestamp, timed ? scan_adapt.level : 0))
+	{
+		scan_stats.repeated++;
+		relay_heard(data.node_id, seq, ttl);
+		return;
+	}
+	if (HELIOS_BLE_RELAY_TTL > 0 && ttl > 0 && data.node_id < HELIOS_BLE_MAX_NODES) relay_enqueue(p_message);
+
+	atomic_val_t const head = atomic_get(&rx_head);
+	if (head - atomic_get(&rx_tail) >= HELIOS_BLE_RX_QUEUE_SIZE)
+	{
+		atomic_inc(&rx_dropped);
+		return;
 	}
+	helios_ble_record_t * p_record = &rx_queue[head & (HELIOS_BLE_RX_QUEUE_SIZE - 1)];
+	bt_addr_le_copy(&p_record->addr, addr);
+	p_record->rssi = rssi;
+	p_record->timestamp = timestamp;
+	p_record->hops = hops;
+	p_record->data = data;
+	// the record is complete before it is published
+	atomic_set(&rx_head, head + 1);
+	scan_stats.accepted++;
+	k_sem_give(&sem_data_received);
 }
 
+static void receive_payload(bt_addr_le_t const * addr, int8_t rssi, uint8_t const * p_payload, int len, int64_t timestamp, bool timed)
+{
+	message_t message;
+	int64_t base_time = 0;
+	int offset = WIRE_HEADER_LEN;
+	while (wire_decode_message(p_payload, len, &offset, &message, &base_time))
+	{
+		receive_message(addr, rssi, &message, timestamp, timed);
+	}
+}
+
+#if defined(CONFIG_BT_PER_ADV_SYNC)
+static per_sync_t * find_per_sync(bt_addr_le_t const * addr)
+{
+	for (int i = 0; i < CONFIG_BT_PER_ADV_SYNC_MAX; i++)
+	{
+		if (per_syncs[i].p_sync != NULL && bt_addr_le_cmp(&per_syncs[i].addr, addr) == 0) return &per_syncs[i];
+	}
+	return NULL;
+}
+#endif // CONFIG_BT_PER_ADV_SYNC
+
 static void scan_cb(const bt_addr_le_t *addr, int8_t rssi, uint8_t adv_type, struct net_buf_simple *buf)
 {
-	bt_data_parse(buf, bt_data_parser, NULL);
-    //LOG_INF("advertising received: %d dB, %d bytes", rssi, buf->len);
+	int64_t const timestamp = k_uptime_ticks();
+	scan_stats.seen++;
+	int len;
+	uint8_t const * p_payload = find_payload(buf, &len);
+	if (p_payload == NULL)
+	{
+		scan_stats.filtered++;
+		return;
+	}
+#if defined(CONFIG_BT_PER_ADV_SYNC)
+	// synchronized nodes are received through their periodic adverts, only the time is taken from here
+	per_sync_t const * p_per_sync = find_per_sync(addr);
+	if (p_per_sync != NULL && p_per_sync->established)
+	{
+		message_t message;
+		int64_t base_time = 0;
+		int offset = WIRE_HEADER_LEN;
+		if (wire_decode_message(p_payload, len, &offset, &message, &base_time) && message.ttl == HELIOS_BLE_RELAY_TTL)
+		{
+			sync_sample(message.data.node_id, message.data.network_time, k_ticks_to_us_floor64(timestamp));
+		}
+		return;
+	}
+#endif // CONFIG_BT_PER_ADV_SYNC
+	receive_payload(addr, rssi, p_payload, len, timestamp, true);
+}
+
+#if defined(CONFIG_BT_PER_ADV_SYNC)
+// sees the same adverts as scan_cb, but with the periodic advertising info of the sender
+static void scan_recv_cb(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	if (info->interval == 0 || per_sync_pending || find_per_sync(info->addr) != NULL) return;
+	int len;
+	if (find_payload(buf, &len) == NULL) return;
+
+	per_sync_t * p_per_sync = NULL;
+	for (int i = 0; i < CONFIG_BT_PER_ADV_SYNC_MAX; i++)
+	{
+		if (per_syncs[i].p_sync == NULL)
+		{
+			p_per_sync = &per_syncs[i];
+			break;
+		}
+	}
+	if (p_per_sync == NULL) return;
+
+	struct bt_le_per_adv_sync_param sync_param = {
+		.sid = info->sid,
+		.options = 0,
+		.skip = 0,
+		.timeout = HELIOS_BLE_PER_ADV_SYNC_TIMEOUT_MS / 10,
+	};
+	bt_addr_le_copy(&sync_param.addr, info->addr);
+	int err = bt_le_per_adv_sync_create(&sync_param, &p_per_sync->p_sync);
+	if (err) {
+		LOG_WRN("failed to create periodic sync (err %d)", err);
+		p_per_sync->p_sync = NULL;
+		return;
+	}
+	bt_addr_le_copy(&p_per_sync->addr, info->addr);
+	p_per_sync->established = false;
+	per_sync_pending = true;
+}
+
+static void per_synced_cb(struct bt_le_per_adv_sync *sync, struct bt_le_per_adv_sync_synced_info *info)
+{
+	for (int i = 0; i < CONFIG_BT_PER_ADV_SYNC_MAX; i++)
+	{
+		if (per_syncs[i].p_sync == sync) per_syncs[i].established = true;
+	}
+	per_sync_pending = false;
+	LOG_INF("periodic sync established (interval %d)", info->interval);
+}
+
+// also called if the sync could not be established
+static void per_term_cb(struct bt_le_per_adv_sync *sync, const struct bt_le_per_adv_sync_term_info *info)
+{
+	for (int i = 0; i < CONFIG_BT_PER_ADV_SYNC_MAX; i++)
+	{
+		if (per_syncs[i].p_sync != sync) continue;
+		if (!per_syncs[i].established) per_sync_pending = false;
+		per_syncs[i].p_sync = NULL;
+	}
+	LOG_INF("periodic sync terminated (reason %d)", info->reason);
+}
+
+static void per_recv_cb(struct bt_le_per_adv_sync *sync, const struct bt_le_per_adv_sync_recv_info *info, struct net_buf_simple *buf)
+{
+	int64_t const timestamp = k_uptime_ticks();
+	scan_stats.seen++;
+	int len;
+	uint8_t const * p_payload = find_payload(buf, &len);
+	if (p_payload == NULL)
+	{
+		scan_stats.filtered++;
+		return;
+	}
+	receive_payload(info->addr, info->rssi, p_payload, len, timestamp, false);
+}
+#endif // CONFIG_BT_PER_ADV_SYNC
+
+static helios_ble_return_code_t scan_apply_level(int level)
+{
+    k_mutex_lock(&scan_lock, K_FOREVER);
+    ble_scan_params.interval = SCAN_WINDOW << level;
+    int err = bt_le_scan_stop();
+    if (!err) err = bt_le_scan_start(&ble_scan_params, scan_cb);
+    k_mutex_unlock(&scan_lock);
+    if (err) {
+        LOG_ERR("changing the scan interval failed (err %d)", err);
+        return HELIOS_BLE_RETURN_CODE_ERROR;
+    }
+    LOG_DBG("scan duty 1/%d", 1 << level);
+    return HELIOS_BLE_RETURN_CODE_SUCCESS;
+}
+
+// full duty while the clock is resynchronized and during bursts, otherwise one level per period as long as
+// the missed messages stay below HELIOS_BLE_SCAN_MISSED_PERCENT
+static void scan_adapt_work_handler(struct k_work * p_work)
+{
+	uint32_t const messages_total = scan_stats.accepted + atomic_get(&rx_dropped);
+	uint32_t const missed_total = scan_stats.missed;
+	int32_t const messages = messages_total - scan_adapt.last_messages;
+	int32_t const missed = missed_total - scan_adapt.last_missed;
+	scan_adapt.last_messages = messages_total;
+	scan_adapt.last_missed = missed_total;
+	// at 1 / 2^level duty only every 2^level-th message can be heard, only the ones missed beyond that count
+	int32_t const total = messages + missed;
+	int32_t const excess = total - (messages << scan_adapt.level);
+	scan_adapt.missed_percent = (total > 0 && excess > 0) ? (excess * 100 / total) : 0;
+
+	unsigned int key = irq_lock();
+	int64_t const silent_us = local_now_us() - sync_state.last_sample_us;
+	bool const resync = (sync_state.reference_id >= 0) && (!sync_state.synchronized ||
+		(silent_us > HELIOS_BLE_SYNC_TIMEOUT_MS * 500LL && silent_us < HELIOS_BLE_SYNC_TIMEOUT_MS * 3000LL));
+	irq_unlock(key);
+	bool const burst = messages > 2 * scan_adapt.message_average + SCAN_BURST_MARGIN;
+	scan_adapt.message_average += (messages - scan_adapt.message_average) / 4;
+
+	int level = scan_adapt.level;
+	if (resync || burst) level = 0;
+	else if (scan_adapt.missed_percent > HELIOS_BLE_SCAN_MISSED_PERCENT) level = (level > 0) ? (level - 1) : 0;
+	// half the limit, so the duty does not toggle between two levels
+	else if (scan_adapt.missed_percent <= HELIOS_BLE_SCAN_MISSED_PERCENT / 2 && level < HELIOS_BLE_SCAN_MAX_LEVEL) level++;
+	if (level != scan_adapt.level && scan_apply_level(level) == HELIOS_BLE_RETURN_CODE_SUCCESS) scan_adapt.level = level;
+
+	k_work_reschedule(&scan_adapt_work, K_MSEC(HELIOS_BLE_SCAN_ADAPT_PERIOD_MS));
 }
 
 static void connected_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connected_info *info)
@@ -74,9 +788,35 @@ static void scanned_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_scanned_i
 	LOG_INF("Scanned");
 }
 
-static void sent_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_sent_info *info)
+// The set runs freely and repeats the data of the last helios_ble_send_batch(), so its network time ages by one
+// advertising interval per event. Every HELIOS_BLE_ADV_STAMP_INTERVAL_MS the first record is encoded again with the
+// current network time and only the data of the running set is replaced. The periodic train is not used for the
+// time and keeps the data of the send.
+static void adv_stamp_work_handler(struct k_work * p_work)
 {
-	LOG_INF("Data sent");
+	uint8_t record[WIRE_RECORD_FIXED_LEN + WIRE_VARINT_MAX_LEN];
+	int err = 0;
+
+	k_mutex_lock(&adv_lock, K_FOREVER);
+	// taken as late as possible, the rest of the way to the receiver is HELIOS_BLE_SYNC_PATH_DELAY_US
+	adv_stamp_message.data.network_time = helios_ble_network_time_now(NULL);
+	int const stamp_len = wire_encode_message(record, 0, sizeof(record), &adv_stamp_message, 0);
+	// the varint grows with the network time, a batch that fills the advert keeps its last stamp
+	int const len = adv_len - adv_stamp_len + stamp_len;
+	if (len <= sizeof(adv_payload))
+	{
+		uint8_t * const p_stamp = adv_payload + WIRE_HEADER_LEN;
+		memmove(p_stamp + stamp_len, p_stamp + adv_stamp_len, adv_len - WIRE_HEADER_LEN - adv_stamp_len);
+		memcpy(p_stamp, record, stamp_len);
+		adv_len = len;
+		adv_stamp_len = stamp_len;
+		advertising_data[0].data_len = len;
+		err = bt_le_ext_adv_set_data(adv, advertising_data, ARRAY_SIZE(advertising_data), NULL, 0);
+	}
+	k_mutex_unlock(&adv_lock);
+	if (err) LOG_WRN("failed to refresh the advertising data (err %d)", err);
+
+	k_work_schedule(&adv_stamp_work, K_MSEC(HELIOS_BLE_ADV_STAMP_INTERVAL_MS));
 }
 
 
@@ -91,30 +831,37 @@ helios_ble_return_code_t helios_ble_enable()
 		return HELIOS_BLE_RETURN_CODE_ERROR;
 	}
 	LOG_INF("bluetooth initialized\n");
+	network_hash = wire_network_hash();
 
-    //Scanner einschalten
-    const struct bt_le_scan_param ble_scan_params = { 
-		.interval = 0x0100,
-		.window = 0x0100,
-		.timeout = 0,
-		.type = BT_LE_SCAN_TYPE_PASSIVE,
-		.options = BT_LE_SCAN_OPT_NONE,
+#if defined(CONFIG_BT_PER_ADV_SYNC)
+	static struct bt_le_scan_cb scan_callbacks = {
+		.recv = scan_recv_cb,
 	};
-	
+	bt_le_scan_cb_register(&scan_callbacks);
+	static struct bt_le_per_adv_sync_cb per_sync_callbacks = {
+		.synced = per_synced_cb,
+		.term = per_term_cb,
+		.recv = per_recv_cb,
+	};
+	bt_le_per_adv_sync_cb_register(&per_sync_callbacks);
+#endif // CONFIG_BT_PER_ADV_SYNC
+
+    //Scanner einschalten
 	err = bt_le_scan_start(&ble_scan_params, scan_cb);
 	if (err) {
 		LOG_ERR("starting scanning failed (err %d)", err);
 		return HELIOS_BLE_RETURN_CODE_ERROR;
 	}
+	k_work_init_delayable(&scan_adapt_work, scan_adapt_work_handler);
+	if (HELIOS_BLE_SCAN_MAX_LEVEL > 0) k_work_schedule(&scan_adapt_work, K_MSEC(HELIOS_BLE_SCAN_ADAPT_PERIOD_MS));
 
     //Advertising vorbereiten
     static struct bt_le_adv_param * adv_params;
-	adv_params = BT_LE_EXT_ADV_NCONN_NAME;
+	adv_params = BT_LE_ADV_PARAM(ADV_OPTIONS | BT_LE_ADV_OPT_USE_NAME, ADV_INTERVAL, ADV_INTERVAL, NULL);
 	
 	static struct bt_le_ext_adv_cb ext_adv_cb = {
 		.connected = connected_cb,
 		.scanned = scanned_cb,
-		.sent = sent_cb,
 	};
 	
 	err = bt_le_ext_adv_create(adv_params, &ext_adv_cb, &adv);
@@ -122,6 +869,33 @@ helios_ble_return_code_t helios_ble_enable()
 		LOG_ERR("failed to create bt_le_ext_adv struct (err %d)", err);
 		return HELIOS_BLE_RETURN_CODE_ERROR;
 	}
+	k_work_init_delayable(&adv_stamp_work, adv_stamp_work_handler);
+
+	// own set, so relaying never interrupts the advertising of this node
+	if (HELIOS_BLE_RELAY_TTL > 0) {
+		static struct bt_le_ext_adv_cb relay_adv_cb = {
+			.sent = relay_sent_cb,
+		};
+		err = bt_le_ext_adv_create(BT_LE_ADV_PARAM(ADV_OPTIONS, RELAY_ADV_INTERVAL, RELAY_ADV_INTERVAL, NULL), &relay_adv_cb, &relay_adv);
+		if (err) {
+			LOG_ERR("failed to create relay advertising set (err %d)", err);
+			return HELIOS_BLE_RETURN_CODE_ERROR;
+		}
+		k_work_init_delayable(&relay_work, relay_work_handler);
+	}
+
+#if defined(CONFIG_BT_PER_ADV)
+	struct bt_le_per_adv_param per_adv_params = {
+		.interval_min = PER_ADV_INTERVAL,
+		.interval_max = PER_ADV_INTERVAL,
+		.options = BT_LE_PER_ADV_OPT_NONE,
+	};
+	err = bt_le_per_adv_set_param(adv, &per_adv_params);
+	if (err) {
+		LOG_ERR("failed to set periodic advertising parameters (err %d)", err);
+		return HELIOS_BLE_RETURN_CODE_ERROR;
+	}
+#endif // CONFIG_BT_PER_ADV
 
     return HELIOS_BLE_RETURN_CODE_SUCCESS;
 }
@@ -129,21 +903,84 @@ helios_ble_return_code_t helios_ble_enable()
 
 helios_ble_return_code_t helios_ble_send(helios_ble_data_t const * p_data)
 {
-    memcpy(&(service_data.helios_data), p_data, sizeof(helios_ble_data_t));
+    return helios_ble_send_batch(p_data, 1);
+}
+
+
+helios_ble_return_code_t helios_ble_send_batch(helios_ble_data_t const * p_data, int count)
+{
+    if (count < 1 || count > HELIOS_BLE_BATCH_MAX_RECORDS) return HELIOS_BLE_RETURN_CODE_ERROR;
+    for (int i = 1; i < count; i++)
+    {
+        if (p_data[i].node_id >= HELIOS_BLE_MAX_NODES) return HELIOS_BLE_RETURN_CODE_ERROR;
+    }
+
+    own_id = p_data[0].node_id;
+    uint8_t const node_count = (p_data[0].node_count == 0) ? helios_ble_node_count() : p_data[0].node_count;
+    // refreshed by adv_stamp_work, the size is checked with the current one
+    int64_t const network_time = helios_ble_network_time_now(NULL);
+    message_t messages[HELIOS_BLE_BATCH_MAX_RECORDS];
+    uint8_t payload[ADV_PAYLOAD_MAX];
+    int stamp_len = 0;
+    int len = wire_encode_header(payload);
+    for (int i = 0; i < count; i++)
+    {
+        messages[i] = (message_t) {
+            .seq = (i == 0) ? (own_seq + 1) : (forward_seq[p_data[i].node_id] + 1),
+            // the other messages look relayed once, so receivers neither take their link quality nor sync to them
+            .ttl = (i == 0 || HELIOS_BLE_RELAY_TTL == 0) ? HELIOS_BLE_RELAY_TTL : (HELIOS_BLE_RELAY_TTL - 1),
+            .data = p_data[i],
+        };
+        messages[i].data.network_time = network_time;
+        if (i == 0) messages[i].data.node_count = node_count;
+        len = wire_encode_message(payload, len, sizeof(payload), &messages[i], (i == 0) ? 0 : network_time);
+        if (len < 0)
+        {
+            LOG_WRN("%d messages do not fit into one advert", count);
+            return HELIOS_BLE_RETURN_CODE_ERROR;
+        }
+        if (i == 0) stamp_len = len - WIRE_HEADER_LEN;
+    }
+    // counted only once the batch fits, so receivers do not see gaps
+    own_seq++;
+    for (int i = 1; i < count; i++) forward_seq[p_data[i].node_id]++;
+
+    k_mutex_lock(&adv_lock, K_FOREVER);
+    memcpy(adv_payload, payload, len);
+    adv_len = len;
+    adv_stamp_len = stamp_len;
+    adv_stamp_message = messages[0];
+    advertising_data[0].data_len = len;
     int err = bt_le_ext_adv_set_data(adv, advertising_data, ARRAY_SIZE(advertising_data), NULL, 0);
+#if defined(CONFIG_BT_PER_ADV)
+    if (!err) err = bt_le_per_adv_set_data(adv, advertising_data, ARRAY_SIZE(advertising_data));
+#endif // CONFIG_BT_PER_ADV
+    k_mutex_unlock(&adv_lock);
+    if (err) {
+        LOG_WRN("failed to set advertising data (err %d)", err);
+        return HELIOS_BLE_RETURN_CODE_ERROR;
+    }
+	if (adv_running) return HELIOS_BLE_RETURN_CODE_SUCCESS;
+
+	// started once and never restarted, later calls only replace the data
+	struct bt_le_ext_adv_start_param start_param = {
+		.num_events = 0,
+		.timeout = 0,
+	};
+	err = bt_le_ext_adv_start(adv, &start_param);
 	if (err) {
-		LOG_INF("failed to set adv data (err %d)", err);
+		LOG_INF("failed to start advertising (err %d)", err);
 		return HELIOS_BLE_RETURN_CODE_ERROR;
 	}
-	struct bt_le_ext_adv_start_param ext_start_param = {
-		.num_events = 1,
-		.timeout = 10,
-	};
-	err = bt_le_ext_adv_start(adv, &ext_start_param);
+#if defined(CONFIG_BT_PER_ADV)
+	err = bt_le_per_adv_start(adv);
 	if (err) {
-		LOG_INF("failed to start advertising (err %d)", err);
+		LOG_INF("failed to start periodic advertising (err %d)", err);
 		return HELIOS_BLE_RETURN_CODE_ERROR;
 	}
+#endif // CONFIG_BT_PER_ADV
+	adv_running = true;
+	k_work_schedule(&adv_stamp_work, K_MSEC(HELIOS_BLE_ADV_STAMP_INTERVAL_MS));
 
     return HELIOS_BLE_RETURN_CODE_SUCCESS;
 }
@@ -151,7 +988,164 @@ helios_ble_return_code_t helios_ble_send(helios_ble_data_t const * p_data)
 
 helios_ble_data_t const * helios_ble_receive(k_timeout_t timeout)
 {
-    if(k_sem_take(&sem_data_received, timeout)) return NULL;
+    if (helios_ble_receive_batch(&received_record, 1, timeout) == 0) return NULL;
+
+    return &received_record.data;
+}
+
+
+int helios_ble_receive_batch(helios_ble_record_t * p_records, int max_count, k_timeout_t timeout)
+{
+    atomic_val_t const tail = atomic_get(&rx_tail);
+    atomic_val_t head = atomic_get(&rx_head);
+    // the semaphore may still be given for records taken by an earlier batch, so the queue is checked again
+    while (head == tail)
+    {
+        if (k_sem_take(&sem_data_received, timeout)) return 0;
+        head = atomic_get(&rx_head);
+    }
 
-    return &received_service_data.helios_data;
+    int count = head - tail;
+    if (count > max_count) count = max_count;
+    for (int i = 0; i < count; i++)
+    {
+        p_records[i] = rx_queue[(tail + i) & (HELIOS_BLE_RX_QUEUE_SIZE - 1)];
+    }
+    atomic_set(&rx_tail, tail + count);
+    return count;
+}
+
+
+uint32_t helios_ble_get_rx_dropped(void)
+{
+    return atomic_get(&rx_dropped);
+}
+
+
+void helios_ble_get_scan_stats(helios_ble_scan_stats_t * p_stats)
+{
+    *p_stats = scan_stats;
+}
+
+
+helios_ble_return_code_t helios_ble_set_accept_list(bt_addr_le_t const * p_addrs, int count)
+{
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+    // the accept list can only be changed while the scanner is stopped
+    k_mutex_lock(&scan_lock, K_FOREVER);
+    int err = bt_le_scan_stop();
+    if (err) {
+        k_mutex_unlock(&scan_lock);
+        LOG_ERR("stopping scanning failed (err %d)", err);
+        return HELIOS_BLE_RETURN_CODE_ERROR;
+    }
+    bt_le_filter_accept_list_clear();
+    helios_ble_return_code_t return_code = HELIOS_BLE_RETURN_CODE_SUCCESS;
+    for (int i = 0; i < count; i++)
+    {
+        err = bt_le_filter_accept_list_add(&p_addrs[i]);
+        if (err) {
+            // scanning continues unfiltered rather than with an incomplete list
+            LOG_ERR("adding node %d to the accept list failed (err %d)", i, err);
+            bt_le_filter_accept_list_clear();
+            return_code = HELIOS_BLE_RETURN_CODE_ERROR;
+            count = 0;
+            break;
+        }
+    }
+    ble_scan_params.options = (count > 0) ? BT_LE_SCAN_OPT_FILTER_ACCEPT_LIST : BT_LE_SCAN_OPT_NONE;
+    err = bt_le_scan_start(&ble_scan_params, scan_cb);
+    k_mutex_unlock(&scan_lock);
+    if (err) {
+        LOG_ERR("starting scanning failed (err %d)", err);
+        return HELIOS_BLE_RETURN_CODE_ERROR;
+    }
+    return return_code;
+#else
+    LOG_ERR("accept list needs CONFIG_BT_FILTER_ACCEPT_LIST");
+    return HELIOS_BLE_RETURN_CODE_ERROR;
+#endif // CONFIG_BT_FILTER_ACCEPT_LIST
+}
+
+
+int64_t helios_ble_network_time_now(uint32_t * p_error_us)
+{
+    unsigned int key = irq_lock();
+    int64_t const local_us = local_now_us();
+    int64_t const network_time = network_time_at(local_us);
+    uint32_t error_us = UINT32_MAX;
+    if (is_reference(local_us))
+    {
+        error_us = 0;
+    }
+    else if (sync_state.synchronized)
+    {
+        error_us = sync_state.jitter_us + (local_us - sync_state.last_servo_us) * SYNC_HOLDOVER_PPM / 1000000;
+    }
+    irq_unlock(key);
+
+    if (p_error_us != NULL) *p_error_us = error_us;
+    return network_time;
+}
+
+
+int helios_ble_node_count(void)
+{
+    // aging is done here instead of in scan_cb, so scan_cb only ever touches one entry
+    int64_t const timeout = k_ms_to_ticks_ceil64(HELIOS_BLE_NODE_TIMEOUT_MS);
+    int64_t const now = k_uptime_ticks();
+    for (int i = 0; i < HELIOS_BLE_MAX_NODES; i++)
+    {
+        unsigned int key = irq_lock();
+        if (node_table[i].active && (now - node_table[i].node.last_seen) > timeout)
+        {
+            node_table[i].active = false;
+            active_node_count--;
+        }
+        irq_unlock(key);
+    }
+    return active_node_count + ((own_id >= 0) ? 1 : 0);
+}
+
+
+int helios_ble_node_next(int node_id, helios_ble_node_t * p_node)
+{
+    int64_t const timeout = k_ms_to_ticks_ceil64(HELIOS_BLE_NODE_TIMEOUT_MS);
+    int64_t const now = k_uptime_ticks();
+    for (int i = (node_id < 0) ? 0 : node_id; i < HELIOS_BLE_MAX_NODES; i++)
+    {
+        unsigned int key = irq_lock();
+        node_entry_t * p_entry = &node_table[i];
+        if (p_entry->active && (now - p_entry->node.last_seen) > timeout)
+        {
+            p_entry->active = false;
+            active_node_count--;
+        }
+        if (p_entry->active)
+        {
+            *p_node = p_entry->node;
+            p_node->rssi = p_entry->rssi_q4 / 16;
+            p_node->loss_percent = (p_entry->loss_q10 * 100 + NODE_LOSS_ONE / 2) / NODE_LOSS_ONE;
+            irq_unlock(key);
+            return i;
+        }
+        irq_unlock(key);
+    }
+    return -1;
+}
+
+
+void helios_ble_get_relay_stats(helios_ble_relay_stats_t * p_stats)
+{
+    *p_stats = relay_stats;
+}
+
+
+void helios_ble_get_scan_status(helios_ble_scan_status_t * p_status)
+{
+    int const level = scan_adapt.level;
+    p_status->duty_percent = 100 >> level;
+    p_status->window_ms = SCAN_WINDOW * 5 / 8;
+    p_status->interval_ms = SCAN_INTERVAL_MS(level);
+    p_status->missed_percent = scan_adapt.missed_percent;
 }
\ No newline at end of file
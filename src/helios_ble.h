@@ -3,6 +3,115 @@
 
 #include "stdint.h"
 #include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#ifndef HELIOS_BLE_RX_QUEUE_SIZE
+#define HELIOS_BLE_RX_QUEUE_SIZE 32    // received adverts buffered until helios_ble_receive_batch(), has to be a power of 2
+#endif // !HELIOS_BLE_RX_QUEUE_SIZE
+
+#ifndef HELIOS_BLE_COMPANY_ID
+#define HELIOS_BLE_COMPANY_ID 0xFFFF          // manufacturer data company id, 0xFFFF is reserved for tests
+#endif // !HELIOS_BLE_COMPANY_ID
+
+#ifndef HELIOS_BLE_LEGACY_ADV
+#define HELIOS_BLE_LEGACY_ADV 0               // 1 sends legacy 31 byte adverts, one message on the main set, no periodic advertising
+#endif // !HELIOS_BLE_LEGACY_ADV
+
+// the first helios_ble_send() starts the main set, it repeats the payload of the last call once per interval. Only the
+// network time in it is refreshed in between.
+#ifndef HELIOS_BLE_ADV_INTERVAL_MS
+#define HELIOS_BLE_ADV_INTERVAL_MS 100        // extended advertising interval
+#endif // !HELIOS_BLE_ADV_INTERVAL_MS
+
+#ifndef HELIOS_BLE_ADV_STAMP_INTERVAL_MS
+#define HELIOS_BLE_ADV_STAMP_INTERVAL_MS HELIOS_BLE_ADV_INTERVAL_MS  // shorter ones keep the stamp fresher, most of them never go on air
+#endif // !HELIOS_BLE_ADV_STAMP_INTERVAL_MS
+
+// with CONFIG_BT_PER_ADV the payload is also sent as periodic advertising, receivers with CONFIG_BT_PER_ADV_SYNC
+// synchronize to up to CONFIG_BT_PER_ADV_SYNC_MAX nodes and take their payload from the periodic train
+#ifndef HELIOS_BLE_PER_ADV_INTERVAL_MS
+#define HELIOS_BLE_PER_ADV_INTERVAL_MS HELIOS_BLE_ADV_INTERVAL_MS
+#endif // !HELIOS_BLE_PER_ADV_INTERVAL_MS
+
+#ifndef HELIOS_BLE_PER_ADV_SYNC_TIMEOUT_MS
+#define HELIOS_BLE_PER_ADV_SYNC_TIMEOUT_MS 2000  // a periodic sync is dropped after this time without packets
+#endif // !HELIOS_BLE_PER_ADV_SYNC_TIMEOUT_MS
+
+// relay: nodes rebroadcast messages of other nodes they hear for the first time, each hop decrements the ttl
+#ifndef HELIOS_BLE_RELAY_TTL
+#define HELIOS_BLE_RELAY_TTL 3                // hops a message travels beyond its origin, 0 disables relaying, same on every node
+#endif // !HELIOS_BLE_RELAY_TTL
+
+#ifndef HELIOS_BLE_RELAY_BACKOFF_MIN_MS
+#define HELIOS_BLE_RELAY_BACKOFF_MIN_MS 10    // relays wait a random time in this range so neighbors do not collide
+#endif // !HELIOS_BLE_RELAY_BACKOFF_MIN_MS
+
+#ifndef HELIOS_BLE_RELAY_BACKOFF_MAX_MS
+#define HELIOS_BLE_RELAY_BACKOFF_MAX_MS 60
+#endif // !HELIOS_BLE_RELAY_BACKOFF_MAX_MS
+
+#ifndef HELIOS_BLE_RELAY_SUPPRESS_COUNT
+#define HELIOS_BLE_RELAY_SUPPRESS_COUNT 2     // a waiting relay is dropped after hearing this many copies from other relays
+#endif // !HELIOS_BLE_RELAY_SUPPRESS_COUNT
+
+#ifndef HELIOS_BLE_RELAY_EVENTS
+#define HELIOS_BLE_RELAY_EVENTS 2             // advertising events per relayed message
+#endif // !HELIOS_BLE_RELAY_EVENTS
+
+#ifndef HELIOS_BLE_BATCH_MAX_RECORDS
+#define HELIOS_BLE_BATCH_MAX_RECORDS 16       // messages per helios_ble_send_batch(), 240 bytes per advert (needs CONFIG_BT_CTLR_ADV_DATA_LEN_MAX >= 251)
+#endif // !HELIOS_BLE_BATCH_MAX_RECORDS
+
+#ifndef HELIOS_BLE_RELAY_QUEUE_SIZE
+#define HELIOS_BLE_RELAY_QUEUE_SIZE 16        // messages waiting for their backoff, the ones due together share one advert
+#endif // !HELIOS_BLE_RELAY_QUEUE_SIZE
+
+// scan duty: the scan window covers one advertising interval, so every neighbor is heard once per scan interval.
+// The interval doubles per adaption period while the node is synchronized and few messages are missed.
+#ifndef HELIOS_BLE_SCAN_ADAPT_PERIOD_MS
+#define HELIOS_BLE_SCAN_ADAPT_PERIOD_MS 2000  // the scan duty is reconsidered after this time
+#endif // !HELIOS_BLE_SCAN_ADAPT_PERIOD_MS
+
+#ifndef HELIOS_BLE_SCAN_MAX_LEVEL
+#define HELIOS_BLE_SCAN_MAX_LEVEL 3           // lowest scan duty is 1 / 2^level, 0 scans continuously
+#endif // !HELIOS_BLE_SCAN_MAX_LEVEL
+
+#ifndef HELIOS_BLE_SCAN_MISSED_PERCENT
+#define HELIOS_BLE_SCAN_MISSED_PERCENT 5      // more missed messages raise the scan duty again
+#endif // !HELIOS_BLE_SCAN_MISSED_PERCENT
+
+// time sync: every node follows the lowest node id it hears, the lowest node of the mesh is the reference
+#ifndef HELIOS_BLE_SYNC_PATH_DELAY_US
+#define HELIOS_BLE_SYNC_PATH_DELAY_US 0       // helios_ble_send() to scan_cb of the receiver, has to be measured per board
+#endif // !HELIOS_BLE_SYNC_PATH_DELAY_US
+
+#ifndef HELIOS_BLE_SYNC_TIMEOUT_MS
+#define HELIOS_BLE_SYNC_TIMEOUT_MS 5000       // reference considered gone after this time without adverts
+#endif // !HELIOS_BLE_SYNC_TIMEOUT_MS
+
+#ifndef HELIOS_BLE_SYNC_STEP_US
+#define HELIOS_BLE_SYNC_STEP_US 2000          // larger errors are corrected by a step instead of the servo
+#endif // !HELIOS_BLE_SYNC_STEP_US
+
+#ifndef HELIOS_BLE_MAX_NODES
+#define HELIOS_BLE_MAX_NODES 32               // node ids from 0 to HELIOS_BLE_MAX_NODES - 1 are tracked and relayed
+#endif // !HELIOS_BLE_MAX_NODES
+
+#ifndef HELIOS_BLE_NODE_TIMEOUT_MS
+#define HELIOS_BLE_NODE_TIMEOUT_MS 10000      // nodes not heard for this time are removed from the node table
+#endif // !HELIOS_BLE_NODE_TIMEOUT_MS
+
+#ifndef HELIOS_BLE_NODE_TX_INTERVAL_MS
+#define HELIOS_BLE_NODE_TX_INTERVAL_MS HELIOS_BLE_ADV_INTERVAL_MS  // nominal time between two adverts of a node, base of the loss estimate
+#endif // !HELIOS_BLE_NODE_TX_INTERVAL_MS
+
+#ifndef HELIOS_BLE_SYNC_WINDOW
+#define HELIOS_BLE_SYNC_WINDOW 32             // adverts of the reference per clock correction, only the fastest one is used
+#endif // !HELIOS_BLE_SYNC_WINDOW
+
+#ifndef HELIOS_BLE_SYNC_MAX_DRIFT_PPB
+#define HELIOS_BLE_SYNC_MAX_DRIFT_PPB 200000  // two crystals with +-100 ppm
+#endif // !HELIOS_BLE_SYNC_MAX_DRIFT_PPB
 
 typedef enum helios_ble_return_code_e
 {
@@ -21,14 +130,77 @@ typedef enum helios_ble_pattern_e
 } helios_ble_pattern_t;
 
 typedef struct helios_ble_data_s {
-    int64_t network_time;
+    int64_t network_time;          // us, refreshed every HELIOS_BLE_ADV_STAMP_INTERVAL_MS from helios_ble_network_time_now()
     helios_ble_pattern_t pattern;
-    uint8_t node_count;
+    uint8_t node_count;            // 0 is replaced by helios_ble_node_count() in helios_ble_send()
     uint8_t node_id;
 } helios_ble_data_t;
 
+typedef struct helios_ble_record_s {
+    bt_addr_le_t addr;
+    int8_t rssi;
+    int64_t timestamp;             // k_uptime_ticks() when the advert reached scan_cb
+    uint8_t hops;                  // relays between the origin and this node, the latency is now minus data.network_time
+    helios_ble_data_t data;
+} helios_ble_record_t;
+
+typedef struct helios_ble_node_s {
+    bt_addr_le_t addr;
+    int64_t last_seen;             // k_uptime_ticks() of the last advert
+    uint32_t packets;              // adverts of the node itself
+    int8_t rssi;                   // moving average
+    uint8_t loss_percent;          // moving average of missed adverts, based on HELIOS_BLE_NODE_TX_INTERVAL_MS
+    uint8_t node_id;
+    uint8_t hops;                  // of the last message, addr, rssi and loss_percent are 0 for nodes only heard through relays
+    helios_ble_pattern_t pattern;  // last pattern announced by the node
+} helios_ble_node_t;
+
+typedef struct helios_ble_scan_stats_s {
+    uint32_t seen;                 // adverts delivered to scan_cb
+    uint32_t filtered;             // adverts without a helios payload of this network
+    uint32_t repeated;             // adverts repeating a payload that was already received
+    uint32_t accepted;             // adverts put into the receive queue
+    uint32_t missed;               // messages of tracked nodes never received, from the gaps in their sequence numbers
+} helios_ble_scan_stats_t;
+
+typedef struct helios_ble_relay_stats_s {
+    uint32_t queued;               // messages waiting to be relayed
+    uint32_t suppressed;           // dropped because enough neighbors relayed them first
+    uint32_t sent;
+    uint32_t adverts;              // relay adverts, each one carries every message that was due
+    uint32_t dropped;              // relay queue full or advertising failed
+} helios_ble_relay_stats_t;
+
+// relaying needs CONFIG_BT_EXT_ADV_MAX_ADV_SET=2, the relayed messages have their own advertising set
+typedef struct helios_ble_scan_status_s {
+    uint8_t duty_percent;
+    uint8_t missed_percent;        // of the messages during the last HELIOS_BLE_SCAN_ADAPT_PERIOD_MS, beyond the ones the scan duty skips
+    uint16_t window_ms;
+    uint16_t interval_ms;
+} helios_ble_scan_status_t;
+
 helios_ble_return_code_t helios_ble_enable();
+// the payload goes out with the next advertising event and is repeated until it is replaced, a payload replaced
+// before that is never sent
 helios_ble_return_code_t helios_ble_send(helios_ble_data_t const * p_data);
+// p_data[0] is the message of this node, the others are sent for nodes that cannot advertise themselves
+// (e.g. behind a gateway) and have to be tracked ids, up to HELIOS_BLE_BATCH_MAX_RECORDS messages in one advert
+helios_ble_return_code_t helios_ble_send_batch(helios_ble_data_t const * p_data, int count);
 helios_ble_data_t const * helios_ble_receive(k_timeout_t timeout);
+// waits up to timeout for the first record, then returns everything queued up to max_count
+int helios_ble_receive_batch(helios_ble_record_t * p_records, int max_count, k_timeout_t timeout);
+uint32_t helios_ble_get_rx_dropped(void);  // adverts lost because the queue was full
+void helios_ble_get_scan_stats(helios_ble_scan_stats_t * p_stats);
+void helios_ble_get_relay_stats(helios_ble_relay_stats_t * p_stats);
+void helios_ble_get_scan_status(helios_ble_scan_status_t * p_status);
+// active nodes including this one
+int helios_ble_node_count(void);
+// copies the first active node with an id >= node_id and returns its id, -1 if there is none:
+// for (int id = helios_ble_node_next(0, &node); id >= 0; id = helios_ble_node_next(id + 1, &node))
+int helios_ble_node_next(int node_id, helios_ble_node_t * p_node);
+// network time in us, p_error_us (may be NULL) gets the estimated error, UINT32_MAX before the first sync
+int64_t helios_ble_network_time_now(uint32_t * p_error_us);
+// only adverts of these nodes reach scan_cb (needs CONFIG_BT_FILTER_ACCEPT_LIST), count 0 accepts every node again
+helios_ble_return_code_t helios_ble_set_accept_list(bt_addr_le_t const * p_addrs, int count);
 
 #endif /* HELIOS_BLE_H_ */
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "helios_pattern.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <nrfx_pwm.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#ifndef HELIOS_PATTERN_LOG_LEVEL
+#define HELIOS_PATTERN_LOG_LEVEL LOG_LEVEL_INF
+#endif // !HELIOS_PATTERN_LOG_LEVEL
+
+#define LOG_MODULE_NAME helios_pattern
+LOG_MODULE_REGISTER(LOG_MODULE_NAME, HELIOS_PATTERN_LOG_LEVEL);
+
+#if HELIOS_PATTERN_CHANNELS < 1 || HELIOS_PATTERN_CHANNELS > NRF_PWM_CHANNEL_COUNT
+#error "HELIOS_PATTERN_CHANNELS has to be between 1 and 4"
+#endif
+
+#define POSITION_ONE 256        // LED positions are in 1/256 LED, the index range of the lookup tables
+#define PWM_TOP 1000            // 1 MHz PWM clock, 1 ms PWM period
+#define PWM_POLARITY ((HELIOS_PATTERN_ACTIVE_LOW) ? 0 : 0x8000)   // bit 15 set: the pin is high for the compare value
+#define FRAME_US (HELIOS_PATTERN_FRAME_MS * 1000)
+
+// The tables are computed offline, every pattern is a lookup per LED:
+//   wave_lut[i] = 255 * (1 - cos(2 * pi * i / 256)) / 2
+//   decay_lut[i] = 255 * (exp(-4 * i / 256) - exp(-4)) / (1 - exp(-4))
+//   gamma_lut[i] = 65535 * (i / 255) ^ 2.2
+static uint8_t const wave_lut[256] = {
+	  0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+	 10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+	 37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+	 79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+	127, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+	176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+	218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+	245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+	255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+	245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+	218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+	176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+	128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+	 79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+	 37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+	 10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+};
+
+static uint8_t const decay_lut[256] = {
+	255, 251, 247, 243, 239, 235, 232, 228, 224, 221, 217, 214, 211, 207, 204, 201,
+	198, 194, 191, 188, 185, 182, 179, 177, 174, 171, 168, 166, 163, 160, 158, 155,
+	153, 150, 148, 146, 143, 141, 139, 136, 134, 132, 130, 128, 126, 124, 122, 120,
+	118, 116, 114, 112, 111, 109, 107, 105, 104, 102, 100,  99,  97,  95,  94,  92,
+	 91,  89,  88,  86,  85,  84,  82,  81,  80,  78,  77,  76,  74,  73,  72,  71,
+	 70,  69,  67,  66,  65,  64,  63,  62,  61,  60,  59,  58,  57,  56,  55,  54,
+	 53,  52,  51,  51,  50,  49,  48,  47,  46,  46,  45,  44,  43,  43,  42,  41,
+	 40,  40,  39,  38,  38,  37,  36,  36,  35,  34,  34,  33,  33,  32,  32,  31,
+	 30,  30,  29,  29,  28,  28,  27,  27,  26,  26,  25,  25,  24,  24,  23,  23,
+	 23,  22,  22,  21,  21,  21,  20,  20,  19,  19,  19,  18,  18,  18,  17,  17,
+	 17,  16,  16,  16,  15,  15,  15,  14,  14,  14,  13,  13,  13,  13,  12,  12,
+	 12,  12,  11,  11,  11,  11,  10,  10,  10,  10,   9,   9,   9,   9,   9,   8,
+	  8,   8,   8,   8,   7,   7,   7,   7,   7,   6,   6,   6,   6,   6,   6,   5,
+	  5,   5,   5,   5,   5,   5,   4,   4,   4,   4,   4,   4,   4,   3,   3,   3,
+	  3,   3,   3,   3,   3,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   1,
+	  1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,   0,   0,   0,   0,   0,
+};
+
+static uint16_t const gamma_lut[256] = {
+	    0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,    79,    94,   111,   129,
+	  148,   169,   192,   216,   242,   270,   299,   330,   362,   396,   432,   469,   508,   549,   591,   635,
+	  681,   729,   779,   830,   883,   938,   995,  1053,  1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+	 1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,  2334,  2427,  2521,  2618,  2717,  2817,  2920,  3024,
+	 3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,  4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,
+	 5115,  5257,  5401,  5547,  5695,  5845,  5998,  6152,  6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+	 7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,  9111,  9305,  9501,  9699,  9900, 10102, 10307, 10515,
+	10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254, 12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140,
+	14386, 14635, 14885, 15138, 15394, 15652, 15912, 16174, 16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+	18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694, 20996, 21301, 21609, 21919, 22231, 22546, 22863, 23182,
+	23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826, 26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627,
+	28988, 29351, 29717, 30086, 30457, 30830, 31206, 31585, 31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+	35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981, 38402, 38825, 39252, 39680, 40112, 40546, 40982, 41421,
+	41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025, 45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793,
+	49275, 49761, 50249, 50739, 51232, 51728, 52226, 52727, 53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+	57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097, 61642, 62190, 62741, 63295, 63851, 64410, 64971, 65535,
+};
+
+typedef struct pattern_state_s
+{
+	helios_ble_pattern_t pattern;
+	uint8_t node_id;
+	uint8_t node_count;
+} pattern_state_t;
+
+static nrfx_pwm_t const pwm = NRFX_PWM_INSTANCE(0);
+
+// played alternately by EasyDMA, each value is repeated for HELIOS_PATTERN_FRAME_MS PWM periods
+static nrf_pwm_values_individual_t frame_buffers[2];
+static nrf_pwm_sequence_t const sequences[2] = {
+	{
+		.values.p_individual = &(frame_buffers[0]),
+		.length = NRF_PWM_VALUES_LENGTH(frame_buffers[0]),
+		.repeats = HELIOS_PATTERN_FRAME_MS - 1,
+		.end_delay = 0,
+	},
+	{
+		.values.p_individual = &(frame_buffers[1]),
+		.length = NRF_PWM_VALUES_LENGTH(frame_buffers[1]),
+		.repeats = HELIOS_PATTERN_FRAME_MS - 1,
+		.end_delay = 0,
+	},
+};
+
+static bool enabled = false;
+static pattern_state_t state = { .pattern = PATTERN_OFF };   // protected by irq_lock
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTION DECLARATIONS
+static void pwm_handler(nrfx_pwm_evt_type_t event_type, void * p_context);
+static uint32_t chain_length(uint8_t node_id, uint8_t node_count);
+static uint32_t head_position(int64_t network_time_us, int64_t step_us, uint32_t period);
+static uint8_t decay(uint32_t distance, uint32_t length);
+static void render_buffer(nrf_pwm_values_individual_t * p_buffer, int64_t network_time_us);
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// EVENT HANDLERS
+// the sequence that just ended is played again after the other one, so it is rendered one frame ahead
+static void pwm_handler(nrfx_pwm_evt_type_t event_type, void * p_context)
+{
+	if (event_type == NRFX_PWM_EVT_END_SEQ0)
+	{
+		render_buffer(&(frame_buffers[0]), helios_ble_network_time_now(NULL) + FRAME_US);
+	}
+	else if (event_type == NRFX_PWM_EVT_END_SEQ1)
+	{
+		render_buffer(&(frame_buffers[1]), helios_ble_network_time_now(NULL) + FRAME_US);
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+// LEDs of the whole chain, a node that does not know the node count assumes it is the last one
+static uint32_t chain_length(uint8_t node_id, uint8_t node_count)
+{
+	uint32_t const nodes = (node_count > node_id) ? node_count : ((uint32_t)node_id + 1);
+	return nodes * HELIOS_PATTERN_CHANNELS;
+}
+
+// position in 1/256 LED of a head moving one LED per step_us, wrapped to [0, period)
+static uint32_t head_position(int64_t network_time_us, int64_t step_us, uint32_t period)
+{
+	int64_t position = ((network_time_us * POSITION_ONE) / step_us) % period;
+	if (position < 0) position += period;
+	return (uint32_t)position;
+}
+
+// brightness at distance (1/256 LED) from the head of a tail that is length LEDs long
+static uint8_t decay(uint32_t distance, uint32_t length)
+{
+	uint32_t const index = distance / length;
+	return (index < POSITION_ONE) ? decay_lut[index] : 0;
+}
+
+static void render_buffer(nrf_pwm_values_individual_t * p_buffer, int64_t network_time_us)
+{
+	unsigned int key = irq_lock();
+	pattern_state_t const current = state;
+	irq_unlock(key);
+
+	uint8_t frame[HELIOS_PATTERN_CHANNELS];
+	helios_pattern_render(current.pattern, network_time_us, current.node_id, current.node_count, frame);
+
+	uint16_t values[NRF_PWM_CHANNEL_COUNT] = { PWM_POLARITY, PWM_POLARITY, PWM_POLARITY, PWM_POLARITY };
+	for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++)
+	{
+		values[i] = (uint16_t)((((uint32_t)gamma_lut[frame[i]] * PWM_TOP + 0x8000) >> 16) | PWM_POLARITY);
+	}
+	p_buffer->channel_0 = values[0];
+	p_buffer->channel_1 = values[1];
+	p_buffer->channel_2 = values[2];
+	p_buffer->channel_3 = values[3];
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void helios_pattern_render(helios_ble_pattern_t pattern, int64_t network_time_us, uint8_t node_id, uint8_t node_count,
+	uint8_t * p_frame)
+{
+	uint32_t const length = chain_length(node_id, node_count) * POSITION_ONE;
+	uint32_t const first = (uint32_t)node_id * HELIOS_PATTERN_CHANNELS * POSITION_ONE;
+
+	switch (pattern)
+	{
+	case PATTERN_TRAIL:
+	case PATTERN_PRECEDE:
+		{
+			// trail lights the LEDs the head has passed, precede the ones it is about to reach
+			uint32_t const head = head_position(network_time_us, HELIOS_PATTERN_STEP_US, length);
+			for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++)
+			{
+				uint32_t const led = first + i * POSITION_ONE;
+				uint32_t const distance = (pattern == PATTERN_TRAIL) ? ((head + length - led) % length) : ((led + length - head) % length);
+				p_frame[i] = decay(distance, HELIOS_PATTERN_TRAIL_LENGTH);
+			}
+			break;
+		}
+	case PATTERN_KNIGHT_RIDER:
+		{
+			// the head bounces between the first and the last LED of the chain
+			uint32_t const span = length - POSITION_ONE;
+			uint32_t head = 0;
+			if (span > 0)
+			{
+				head = head_position(network_time_us, HELIOS_PATTERN_STEP_US, 2 * span);
+				if (head > span) head = 2 * span - head;
+			}
+			for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++)
+			{
+				uint32_t const led = first + i * POSITION_ONE;
+				uint32_t const distance = (led > head) ? (led - head) : (head - led);
+				p_frame[i] = decay(distance, HELIOS_PATTERN_KNIGHT_RIDER_WIDTH);
+			}
+			break;
+		}
+	case PATTERN_SYNC:
+		{
+			uint8_t const brightness = wave_lut[head_position(network_time_us, HELIOS_PATTERN_SYNC_PERIOD_US, POSITION_ONE)];
+			for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++) p_frame[i] = brightness;
+			break;
+		}
+	case PATTERN_ON:
+		for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++) p_frame[i] = UINT8_MAX;
+		break;
+	case PATTERN_OFF:
+	default:
+		for (int i = 0; i < HELIOS_PATTERN_CHANNELS; i++) p_frame[i] = 0;
+		break;
+	}
+}
+
+helios_ble_return_code_t helios_pattern_enable(void)
+{
+	if (enabled) return HELIOS_BLE_RETURN_CODE_SUCCESS;
+
+	nrfx_pwm_config_t const config = {
+		.output_pins = HELIOS_PATTERN_PINS,
+		.irq_priority = HELIOS_PATTERN_IRQ_PRIORITY,
+		.base_clock = NRF_PWM_CLK_1MHz,
+		.count_mode = NRF_PWM_MODE_UP,
+		.top_value = PWM_TOP,
+		.load_mode = NRF_PWM_LOAD_INDIVIDUAL,
+		.step_mode = NRF_PWM_STEP_AUTO,
+	};
+	IRQ_CONNECT(NRFX_IRQ_NUMBER_GET(NRF_PWM0), HELIOS_PATTERN_IRQ_PRIORITY, nrfx_isr, nrfx_pwm_0_irq_handler, 0);
+	nrfx_err_t const err = nrfx_pwm_init(&pwm, &config, pwm_handler, NULL);
+	if (err != NRFX_SUCCESS)
+	{
+		LOG_ERR("PWM init failed (err %d)", err);
+		return HELIOS_BLE_RETURN_CODE_ERROR;
+	}
+
+	int64_t const now = helios_ble_network_time_now(NULL);
+	render_buffer(&(frame_buffers[0]), now);
+	render_buffer(&(frame_buffers[1]), now + FRAME_US);
+	// from here on the PWM plays the frames without the CPU, the interrupt only has to refill a buffer within a frame
+	nrfx_pwm_complex_playback(&pwm, &(sequences[0]), &(sequences[1]), 1,
+		NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_SIGNAL_END_SEQ0 | NRFX_PWM_FLAG_SIGNAL_END_SEQ1);
+	enabled = true;
+	LOG_INF("pattern output enabled (%d channels, %d ms frames)", HELIOS_PATTERN_CHANNELS, HELIOS_PATTERN_FRAME_MS);
+	return HELIOS_BLE_RETURN_CODE_SUCCESS;
+}
+
+void helios_pattern_set(helios_ble_pattern_t pattern, uint8_t node_id, uint8_t node_count)
+{
+	unsigned int key = irq_lock();
+	state.pattern = pattern;
+	state.node_id = node_id;
+	state.node_count = node_count;
+	irq_unlock(key);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef HELIOS_PATTERN_H_
+#define HELIOS_PATTERN_H_
+
+#include <stdint.h>
+
+#include "helios_ble.h"
+
+// The LEDs of all nodes form one chain, node_id * HELIOS_PATTERN_CHANNELS + channel is the position of a LED in it.
+// Every frame is computed from the network time, so nodes with the same pattern show the same frame at the same time.
+#ifndef HELIOS_PATTERN_CHANNELS
+#define HELIOS_PATTERN_CHANNELS 4             // LEDs per node, one PWM channel each, at most 4 (one PWM instance)
+#endif // !HELIOS_PATTERN_CHANNELS
+
+#ifndef HELIOS_PATTERN_FRAME_MS
+#define HELIOS_PATTERN_FRAME_MS 10            // frame period, multiple of the 1 ms PWM period
+#endif // !HELIOS_PATTERN_FRAME_MS
+
+#ifndef HELIOS_PATTERN_STEP_US
+#define HELIOS_PATTERN_STEP_US 50000          // trail, precede and knight rider move by one LED in this time
+#endif // !HELIOS_PATTERN_STEP_US
+
+#ifndef HELIOS_PATTERN_TRAIL_LENGTH
+#define HELIOS_PATTERN_TRAIL_LENGTH 6         // LEDs lit behind the head of trail and ahead of the head of precede
+#endif // !HELIOS_PATTERN_TRAIL_LENGTH
+
+#ifndef HELIOS_PATTERN_KNIGHT_RIDER_WIDTH
+#define HELIOS_PATTERN_KNIGHT_RIDER_WIDTH 2   // LEDs lit on each side of the knight rider head
+#endif // !HELIOS_PATTERN_KNIGHT_RIDER_WIDTH
+
+#ifndef HELIOS_PATTERN_SYNC_PERIOD_US
+#define HELIOS_PATTERN_SYNC_PERIOD_US 2000000 // all LEDs of the network pulse once in this time
+#endif // !HELIOS_PATTERN_SYNC_PERIOD_US
+
+// output: PWM0 plays two frame buffers in a loop by EasyDMA, the PWM interrupt renders the buffer that just ended
+// while the other one is played, needs CONFIG_NRFX_PWM0 and the pwm0 node disabled in the devicetree
+#ifndef HELIOS_PATTERN_PINS
+#define HELIOS_PATTERN_PINS { NRF_PWM_PIN_NOT_CONNECTED, NRF_PWM_PIN_NOT_CONNECTED, NRF_PWM_PIN_NOT_CONNECTED, NRF_PWM_PIN_NOT_CONNECTED }
+#endif // !HELIOS_PATTERN_PINS
+
+#ifndef HELIOS_PATTERN_ACTIVE_LOW
+#define HELIOS_PATTERN_ACTIVE_LOW 0           // 1 for LEDs switched on by a low pin
+#endif // !HELIOS_PATTERN_ACTIVE_LOW
+
+#ifndef HELIOS_PATTERN_IRQ_PRIORITY
+#define HELIOS_PATTERN_IRQ_PRIORITY 2         // a frame is rendered within one frame period, far longer than the BLE interrupts
+#endif // !HELIOS_PATTERN_IRQ_PRIORITY
+
+// Renders the brightness (0 to 255, before gamma correction) of the HELIOS_PATTERN_CHANNELS LEDs of a node.
+// Only depends on its arguments, node_count 0 is treated as a chain ending with this node.
+void helios_pattern_render(helios_ble_pattern_t pattern, int64_t network_time_us, uint8_t node_id, uint8_t node_count,
+	uint8_t * p_frame);
+// starts the PWM output with PATTERN_OFF, frames follow helios_ble_network_time_now()
+helios_ble_return_code_t helios_pattern_enable(void);
+// takes effect with the next frame that is rendered, usually from a helios_ble_receive() of the reference node
+void helios_pattern_set(helios_ble_pattern_t pattern, uint8_t node_id, uint8_t node_count);
+
+#endif /* HELIOS_PATTERN_H_ */
\ No newline at end of file
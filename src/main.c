@@ -5,19 +5,26 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include "serial.h"
 
 void main(void)
 {
+	// only the cdc-acm uart can hold back the sender, the async uart and ble would drop the newest bytes instead
+#if DT_NODE_HAS_COMPAT(DT_CHOSEN(zephyr_console), zephyr_cdc_acm_uart)
+	serial_set_overflow_policy(SERIAL_TYPE_UART, SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER);
+#endif
 	serial_enable(SERIAL_TYPE_UART|SERIAL_TYPE_BLE);
 	serial_set_end_character_list("\n", 1);
 	serial_sendf(K_FOREVER, "Hello World!\n");
 	
 	while (true)
 	{
-		serial_line_t const * p_line = serial_get_line(K_FOREVER);
+		// long lines and a paused producer hand out partial segments, the line is complete once more_follows is cleared
+		serial_line_t const * p_line = serial_get_chunk(K_FOREVER);
 		serial_send(K_FOREVER, p_line->p_data, p_line->len);
+		if (p_line->more_follows) continue;
 	   	serial_sendf(K_FOREVER, "Hello World\n");
 	}
 }
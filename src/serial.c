@@ -21,9 +21,13 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME, SERIAL_LOG_LEVEL);
 static K_SEM_DEFINE(sem_wait_for_data, 0, 1);
 
 static serial_type_t enabled_serial_types = SERIAL_TYPE_NONE;
+static serial_type_t volatile claimed_serial_types = SERIAL_TYPE_NONE;  // owned by a protocol layer, see serial_claim
 
 static char const * end_character_list = NULL;
 static int end_character_count = 0;
+
+// transport which handed out the last partial segment, the rest of that line has to be read from the same transport
+static serial_type_t chunk_owner = SERIAL_TYPE_NONE;
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -59,7 +63,50 @@ void ble_serial_callback(serial_event_t const * p_evt)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // STATIC FUNCTIONS
-
+// both getters can hand out partial segments (max line length, paused producer), so both keep reading from the
+// transport of the last partial segment until its line is complete
+static serial_line_t const * get_next(k_timeout_t timeout, bool chunked)
+{
+	static serial_line_t empty_line = { 
+		.len = 0,
+		.p_data = NULL,
+		.more_follows = false,
+	};
+	while (true)
+	{
+		serial_line_t const * p_line = &empty_line;
+		serial_type_t const available_types = enabled_serial_types & ~claimed_serial_types;
+		
+		if ((available_types & SERIAL_TYPE_UART) && (chunk_owner != SERIAL_TYPE_BLE))
+		{
+			p_line = chunked ? uart_serial_get_chunk(K_NO_WAIT) : uart_serial_get_line(K_NO_WAIT);
+			if (p_line->len > 0)
+			{
+				chunk_owner = p_line->more_follows ? SERIAL_TYPE_UART : SERIAL_TYPE_NONE;
+				return p_line;
+			}
+		}
+		
+		if ((available_types & SERIAL_TYPE_BLE) && (chunk_owner != SERIAL_TYPE_UART))
+		{
+			p_line = chunked ? ble_serial_get_chunk(K_NO_WAIT) : ble_serial_get_line(K_NO_WAIT);
+			if (p_line->len > 0)
+			{
+				chunk_owner = p_line->more_follows ? SERIAL_TYPE_BLE : SERIAL_TYPE_NONE;
+				return p_line;
+			}
+		}
+		
+		if (k_sem_take(&sem_wait_for_data, timeout) != 0)
+		{
+			LOG_DBG("timeout reached");
+			k_sleep(K_MSEC(10));
+			return &empty_line;
+		}
+		
+	}
+	
+}
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 serial_ret_code_t serial_enable(serial_type_t type)
@@ -136,6 +183,8 @@ serial_ret_code_t serial_disable(serial_type_t type)
 			return ret_code;
 		}
 		enabled_serial_types &= ~SERIAL_TYPE_UART;
+		// an unfinished chunked line can not be completed any more
+		if (chunk_owner == SERIAL_TYPE_UART) chunk_owner = SERIAL_TYPE_NONE;
 	}
 	
 	if (type & enabled_serial_types & SERIAL_TYPE_BLE)
@@ -153,49 +202,30 @@ serial_ret_code_t serial_disable(serial_type_t type)
 			return ret_code;
 		}
 		enabled_serial_types &= ~SERIAL_TYPE_BLE;
+		// an unfinished chunked line can not be completed any more
+		if (chunk_owner == SERIAL_TYPE_BLE) chunk_owner = SERIAL_TYPE_NONE;
 	}
 	
+	// a reader waiting for the rest of a chunked line goes back to the remaining transport
+	k_sem_give(&sem_wait_for_data);
 	return ret_code;
 }
 
 serial_line_t const * serial_get_line(k_timeout_t timeout)
 {
-	static serial_line_t empty_line = { 
-		.len = 0,
-		.p_data = NULL,
-	};
-	while (true)
-	{
-		serial_line_t const * p_line = &empty_line;
-		
-		if (enabled_serial_types & SERIAL_TYPE_UART)
-		{
-			p_line = uart_serial_get_line(K_NO_WAIT);
-			if (p_line->len > 0) return p_line;
-		}
-		
-		if (enabled_serial_types & SERIAL_TYPE_BLE)
-		{
-			p_line = ble_serial_get_line(K_NO_WAIT);
-			if (p_line->len > 0) return p_line;
-		}
-		
-		if (k_sem_take(&sem_wait_for_data, timeout) != 0)
-		{
-			LOG_DBG("timeout reached");
-			k_sleep(K_MSEC(10));
-			return &empty_line;
-		}
-		
-	}
-	
+	return get_next(timeout, false);
+}
+
+serial_line_t const * serial_get_chunk(k_timeout_t timeout)
+{
+	return get_next(timeout, true);
 }
 
 serial_ret_code_t serial_send(k_timeout_t timeout, char const * p_data, int len)
 {
 	serial_ret_code_t ret_code = SERIAL_RET_CODE_ERROR_UNKNOWN;
 	
-	if (enabled_serial_types & SERIAL_TYPE_UART)
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_UART)
 	{
 		ret_code = uart_serial_send(timeout, p_data, len);
 		if (ret_code != SERIAL_RET_CODE_SUCCESS)
@@ -204,7 +234,7 @@ serial_ret_code_t serial_send(k_timeout_t timeout, char const * p_data, int len)
 		}
 	}
 	
-	if (enabled_serial_types & SERIAL_TYPE_BLE)
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_BLE)
 	{
 		ret_code = ble_serial_send(timeout, p_data, len);
 		if (ret_code != SERIAL_RET_CODE_SUCCESS)
@@ -216,13 +246,33 @@ serial_ret_code_t serial_send(k_timeout_t timeout, char const * p_data, int len)
 	return ret_code;
 }
 
+serial_ret_code_t serial_send_to(serial_type_t type, k_timeout_t timeout, char const * p_data, int len)
+{
+	if (type & claimed_serial_types)
+	{
+		LOG_ERR("transport %d is claimed by a protocol layer", type);
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	
+	switch (type & enabled_serial_types)
+	{
+	case SERIAL_TYPE_UART:
+		return uart_serial_send(timeout, p_data, len);
+	case SERIAL_TYPE_BLE:
+		return ble_serial_send(timeout, p_data, len);
+	default:
+		LOG_ERR("transport %d is not a single enabled transport", type);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+}
+
 serial_ret_code_t serial_sendf(k_timeout_t timeout, char const * format, ...)
 {
 	va_list args;
 	va_start(args, format);
 	serial_ret_code_t ret_code = SERIAL_RET_CODE_ERROR_UNKNOWN;
 	
-	if (enabled_serial_types & SERIAL_TYPE_UART)
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_UART)
 	{
 		ret_code = uart_serial_vsendf(timeout, format, args);
 		if (ret_code != SERIAL_RET_CODE_SUCCESS)
@@ -231,7 +281,7 @@ serial_ret_code_t serial_sendf(k_timeout_t timeout, char const * format, ...)
 		}
 	}
 	
-	if (enabled_serial_types & SERIAL_TYPE_BLE)
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_BLE)
 	{
 		ret_code = ble_serial_vsendf(timeout, format, args);
 		if (ret_code != SERIAL_RET_CODE_SUCCESS)
@@ -272,4 +322,216 @@ serial_ret_code_t serial_set_end_character_list(char const * p_list, int len)
 	}
 	
 	return ret_code;
+}
+
+serial_ret_code_t serial_set_delimiter(serial_type_t type, char const * p_delimiter, int len)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	
+	if (type & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_set_delimiter(p_delimiter, len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set uart_serial delimiter!");
+			return ret_code;
+		}
+	}
+	
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_set_delimiter(p_delimiter, len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set ble_serial delimiter!");
+			return ret_code;
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_set_max_line_length(serial_type_t type, int max_len)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	
+	if (type & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_set_max_line_length(max_len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set uart_serial max line length!");
+			return ret_code;
+		}
+	}
+	
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_set_max_line_length(max_len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set ble_serial max line length!");
+			return ret_code;
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_set_overflow_policy(serial_type_t type, serial_overflow_policy_t policy)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	
+	if (type & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_set_overflow_policy(policy);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set uart_serial overflow policy!");
+			return ret_code;
+		}
+	}
+	
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_set_overflow_policy(policy);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set ble_serial overflow policy!");
+			return ret_code;
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_get_overflow_stats(serial_type_t type, serial_overflow_stats_t * p_stats)
+{
+	switch (type)
+	{
+	case SERIAL_TYPE_UART:
+		return uart_serial_get_overflow_stats(p_stats);
+	case SERIAL_TYPE_BLE:
+		return ble_serial_get_overflow_stats(p_stats);
+	default:
+		LOG_ERR("overflow stats are only available for a single serial type");
+		return SERIAL_RET_CODE_ERROR_NOT_SUPPORTED;
+	}
+}
+
+serial_ret_code_t serial_set_flow_control(serial_type_t type, serial_flow_control_config_t const * p_config)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	
+	if (type & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_set_flow_control(p_config);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set uart_serial flow control!");
+			return ret_code;
+		}
+	}
+	
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_set_flow_control(p_config);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set ble_serial flow control!");
+			return ret_code;
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_set_framing(serial_type_t type, serial_framing_t framing)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	
+	if (type & claimed_serial_types)
+	{
+		LOG_ERR("transport %d is claimed by a protocol layer", type);
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	
+	if (type & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_set_framing(framing);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set uart_serial framing!");
+			return ret_code;
+		}
+	}
+	
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_set_framing(framing);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set ble_serial framing!");
+			return ret_code;
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_ERROR_UNKNOWN;
+	
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_UART)
+	{
+		ret_code = uart_serial_send_frame(timeout, p_data, len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to send frame over uart_serial (code: %d)", ret_code);
+		}
+	}
+	
+	if (enabled_serial_types & ~claimed_serial_types & SERIAL_TYPE_BLE)
+	{
+		ret_code = ble_serial_send_frame(timeout, p_data, len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to send frame over ble_serial (code: %d)", ret_code);
+		}
+	}
+	
+	return ret_code;
+}
+
+serial_ret_code_t serial_claim(serial_type_t type)
+{
+	if ((type == SERIAL_TYPE_NONE) || (type & ~(SERIAL_TYPE_UART | SERIAL_TYPE_BLE)))
+	{
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	
+	unsigned int key = irq_lock();
+	if (type & claimed_serial_types)
+	{
+		irq_unlock(key);
+		LOG_ERR("transport %d is already claimed", type);
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	claimed_serial_types |= type;
+	irq_unlock(key);
+	
+	// an unfinished chunked line can not be completed any more
+	if (chunk_owner & type) chunk_owner = SERIAL_TYPE_NONE;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_release(serial_type_t type)
+{
+	unsigned int key = irq_lock();
+	claimed_serial_types &= ~type;
+	irq_unlock(key);
+	// lines received while the transport was claimed are picked up by the next reader
+	k_sem_give(&sem_wait_for_data);
+	return SERIAL_RET_CODE_SUCCESS;
 }
\ No newline at end of file
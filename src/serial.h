@@ -2,6 +2,7 @@
 #define SERIAL_H_
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #include <zephyr/kernel.h>
 
@@ -14,6 +15,8 @@ typedef enum serial_ret_code_e
 	SERIAL_RET_CODE_ERROR_BUFFER_FULL = -4,
 	SERIAL_RET_CODE_ERROR_BUSY = -5,
 	SERIAL_RET_CODE_ERROR_NO_MEMORY = -6,
+	SERIAL_RET_CODE_ERROR_NOT_SUPPORTED = -7,
+	SERIAL_RET_CODE_ERROR_INVALID_PARAMETER = -8,
 } serial_ret_code_t;
 
 typedef enum serial_type_e
@@ -24,6 +27,58 @@ typedef enum serial_type_e
 	SERIAL_TYPE_ALL = 0xFFFFFFFF,
 } serial_type_t;
 
+typedef enum serial_overflow_policy_e
+{
+	SERIAL_OVERFLOW_POLICY_DROP_OLDEST,     // overwrite the oldest bytes in the input buffer (default)
+	SERIAL_OVERFLOW_POLICY_DROP_NEWEST,     // discard incoming bytes while the input buffer is full
+	SERIAL_OVERFLOW_POLICY_DROP_LINE,       // discard the complete line which does not fit into the input buffer
+	SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER,  // pause the sender until the input buffer is drained to half its size. Only
+	                                        // lossless on the cdc-acm uart, the async uart and ble keep receiving and
+	                                        // drop the newest bytes into block_lost_bytes unless credit flow control
+	                                        // holds back the peer
+} serial_overflow_policy_t;
+
+typedef struct serial_overflow_stats_s
+{
+	uint32_t drop_oldest_bytes;
+	uint32_t drop_newest_bytes;
+	uint32_t drop_line_bytes;
+	uint32_t drop_line_count;
+	uint32_t block_count;       // number of times the sender was paused
+	uint32_t block_lost_bytes;  // bytes lost although the sender was paused (async uart and ble can only be held back by credit flow control)
+} serial_overflow_stats_t;
+
+#define SERIAL_FLOW_CONTROL_XON 0x11
+#define SERIAL_FLOW_CONTROL_XOFF 0x13
+#define SERIAL_FLOW_CONTROL_ESCAPE 0x10     // credit mode: escape followed by the number of granted units, data escapes are doubled
+#define SERIAL_FLOW_CONTROL_CREDIT_UNIT 16  // bytes per granted credit
+
+typedef enum serial_flow_control_e
+{
+	SERIAL_FLOW_CONTROL_NONE,
+	SERIAL_FLOW_CONTROL_XON_XOFF,  // text mode, the data must not contain XON/XOFF
+	SERIAL_FLOW_CONTROL_CREDIT,    // binary mode, the peer may only send as many bytes as it was granted
+} serial_flow_control_t;
+
+typedef struct serial_flow_control_config_s
+{
+	serial_flow_control_t mode;
+	int high_watermark;  // bytes in the input buffer at which the peer has to stop sending
+	int low_watermark;   // bytes in the input buffer at which the peer may continue
+} serial_flow_control_config_t;
+
+#ifndef SERIAL_DELIMITER_MAX_LEN
+#define SERIAL_DELIMITER_MAX_LEN 8  // longest delimiter sequence accepted by serial_set_delimiter()
+#endif // !SERIAL_DELIMITER_MAX_LEN
+
+typedef enum serial_framing_e
+{
+	SERIAL_FRAMING_LINE,        // split at the bytes of the end character list (default)
+	SERIAL_FRAMING_COBS,        // consistent overhead byte stuffing, frames are terminated by 0x00
+	SERIAL_FRAMING_SLIP,        // RFC 1055, frames are enclosed in 0xC0
+	SERIAL_FRAMING_LENGTH_CRC,  // 16 bit little endian length, payload, crc16-ccitt over length and payload
+} serial_framing_t;
+
 typedef struct serial_event_new_data_s
 {
 	size_t count;
@@ -35,16 +90,23 @@ typedef struct serial_event_buff_ovf_s
 	size_t count;
 } serial_event_buff_ovf_t;
 
+typedef struct serial_event_framing_error_s
+{
+	size_t count;  // bytes of the dropped frame
+} serial_event_framing_error_t;
+
 
 typedef struct serial_event_s
 {
 	enum {
 		SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED,
 		SERIAL_EVENT_TYPE_BUFFER_OVERFLOW,
+		SERIAL_EVENT_TYPE_FRAMING_ERROR,
 	} type;
 	union {
 		serial_event_new_data_t new_data;
 		serial_event_buff_ovf_t buf_ovf;
+		serial_event_framing_error_t framing_error;
 	} data;
 } serial_event_t;
 
@@ -54,14 +116,30 @@ typedef struct serial_line_s
 {
 	size_t const len;
 	char const * const p_data;
+	bool const more_follows;  // set for partial segments of a line that did not fit the input buffer (see serial_get_chunk)
+	serial_type_t const type; // transport the line was received on, answers can be sent there with serial_send_to
 } serial_line_t;
 
 serial_ret_code_t serial_enable(serial_type_t type);
 serial_ret_code_t serial_disable(serial_type_t type);
 serial_line_t const * serial_get_line(k_timeout_t timeout);
+serial_line_t const * serial_get_chunk(k_timeout_t timeout);
 serial_ret_code_t serial_send(k_timeout_t timeout, char const * p_data, int len);
+serial_ret_code_t serial_send_to(serial_type_t type, k_timeout_t timeout, char const * p_data, int len);
 serial_ret_code_t serial_sendf(k_timeout_t timeout, char const * format, ...);
 serial_ret_code_t serial_set_end_character_list(char const * p_list, int len);
+serial_ret_code_t serial_set_overflow_policy(serial_type_t type, serial_overflow_policy_t policy);
+serial_ret_code_t serial_get_overflow_stats(serial_type_t type, serial_overflow_stats_t * p_stats);
+serial_ret_code_t serial_set_flow_control(serial_type_t type, serial_flow_control_config_t const * p_config);
+serial_ret_code_t serial_set_framing(serial_type_t type, serial_framing_t framing);
+serial_ret_code_t serial_set_delimiter(serial_type_t type, char const * p_delimiter, int len);
+serial_ret_code_t serial_set_max_line_length(serial_type_t type, int max_len);
+serial_ret_code_t serial_send_frame(k_timeout_t timeout, char const * p_data, int len);
+// hands an enabled transport exclusively to a protocol layer (arq, mux) which reads and frames it on its own.
+// Until it is released, serial_get_line/serial_get_chunk and the broadcast senders skip it, while serial_send_to and
+// serial_set_framing return SERIAL_RET_CODE_ERROR_BUSY for it. Claiming a transport twice fails with the same code.
+serial_ret_code_t serial_claim(serial_type_t type);
+serial_ret_code_t serial_release(serial_type_t type);
 
 
 #endif  /* _ SERIAL_H_ */
\ No newline at end of file
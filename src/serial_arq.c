@@ -0,0 +1,552 @@
+#include "serial_arq.h"
+
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+#include <zephyr/random/rand32.h>
+
+#include "serial_internal.h"
+#include "uart_serial.h"
+#include "ble_serial.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#ifndef SERIAL_ARQ_LOG_LEVEL
+#ifdef SERIAL_LOG_LEVEL
+#define SERIAL_ARQ_LOG_LEVEL SERIAL_LOG_LEVEL
+#else
+#define SERIAL_ARQ_LOG_LEVEL LOG_LEVEL_WRN
+#endif // SERIAL_LOG_LEVEL
+#endif // !SERIAL_ARQ_LOG_LEVEL
+
+#ifndef SERIAL_ARQ_RX_QUEUE_LENGTH
+#define SERIAL_ARQ_RX_QUEUE_LENGTH 4
+#endif // !SERIAL_ARQ_RX_QUEUE_LENGTH
+
+#if (SERIAL_ARQ_MAX_WINDOW & (SERIAL_ARQ_MAX_WINDOW - 1)) != 0 || SERIAL_ARQ_MAX_WINDOW > 128
+#error "SERIAL_ARQ_MAX_WINDOW has to be a power of 2 not larger than 128, so the 8 bit sequence numbers map onto the window"
+#endif
+
+#define LOG_MODULE_NAME serial_arq
+LOG_MODULE_REGISTER(LOG_MODULE_NAME, SERIAL_ARQ_LOG_LEVEL);
+
+// every frame starts with the packet type and a sequence number, the crc is added by the length+crc framing
+#define PACKET_HEADER_SIZE 2
+#define PACKET_TYPE_DATA 0x01
+#define PACKET_TYPE_ACK 0x02
+#define PACKET_TYPE_SYNC 0x03        // the receiver always continues with this sequence number, followed by the sync nonce
+#define PACKET_TYPE_SYNC_ACK 0x04    // echoes sequence number and nonce of the sync, the sender starts sending data
+#define PACKET_FLAG_SYNC 0x80        // ack of a receiver which does not know the sequence numbers of the sender (restarted)
+#define SYNC_PACKET_SIZE (PACKET_HEADER_SIZE + 1)
+
+typedef struct tx_slot_s
+{
+	int len;
+	char data[PACKET_HEADER_SIZE + SERIAL_ARQ_MAX_PAYLOAD];
+} tx_slot_t;
+
+typedef struct rx_message_s
+{
+	int len;
+	char data[SERIAL_ARQ_MAX_PAYLOAD + 1];
+} rx_message_t;
+
+static K_MUTEX_DEFINE(tx_lock);
+static struct k_sem sem_window;
+static K_MSGQ_DEFINE(rx_queue, sizeof(rx_message_t), SERIAL_ARQ_RX_QUEUE_LENGTH, 4);
+static struct k_work rx_work;
+static struct k_work_delayable retransmit_work;
+
+static bool enabled = false;
+static serial_arq_config_t config;
+static serial_arq_stats_t stats;
+static serial_line_t const * (*p_get_line)(k_timeout_t timeout);
+static serial_internal_send_t p_send_frame;
+
+static tx_slot_t tx_window[SERIAL_ARQ_MAX_WINDOW];
+static uint8_t base_seq;             // oldest unacknowledged frame
+static uint8_t next_seq;
+static uint8_t unsent_seq;           // frames before this one were sent at least once
+static bool tx_synced;               // the peer acknowledged the sync, data frames are sent
+static uint8_t sync_nonce;           // tells the acknowledgement of the current sync apart from older ones
+static int retries;
+
+static uint8_t expected_seq;
+static bool rx_synced;               // the peer told us its sequence number, data frames are accepted
+static rx_message_t rx_message;      // only used by the work queue
+static rx_message_t app_message;     // handed out by serial_arq_receive()
+static serial_internal_line_t line = {
+	.mutable = {
+		.p_buffer = app_message.data,
+	},
+};
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTION DECLARATIONS
+static void rx_work_handler(struct k_work * p_work);
+static void retransmit_work_handler(struct k_work * p_work);
+static void handle_ack(uint8_t flags, uint8_t ack_seq);
+static bool handle_data(uint8_t seq, char const * p_payload, int len);
+static void handle_sync(uint8_t seq, uint8_t nonce);
+static void handle_sync_ack(uint8_t seq, uint8_t nonce);
+static void send_ack(uint8_t flags);
+static void send_sync(void);
+static void send_window(void);
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// EVENT HANDLERS
+static void arq_callback(serial_event_t const * p_evt)
+{
+	switch (p_evt->type)
+	{
+	case SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED:
+		k_work_submit(&rx_work);
+		break;
+	case SERIAL_EVENT_TYPE_FRAMING_ERROR:
+		stats.framing_errors++;
+		break;
+	default:
+		break;
+	}
+}
+
+static void rx_work_handler(struct k_work * p_work)
+{
+	bool ack_needed = false;
+	bool sync_needed = false;
+	while (enabled)
+	{
+		serial_line_t const * p_frame = p_get_line(K_NO_WAIT);
+		if (p_frame->len == 0) break;
+		if (p_frame->len < PACKET_HEADER_SIZE)
+		{
+			LOG_WRN("frame too short (%zu bytes)", p_frame->len);
+			continue;
+		}
+
+		uint8_t const type = p_frame->p_data[0];
+		uint8_t const seq = p_frame->p_data[1];
+		switch (type & ~PACKET_FLAG_SYNC)
+		{
+		case PACKET_TYPE_ACK:
+			handle_ack(type & PACKET_FLAG_SYNC, seq);
+			break;
+		case PACKET_TYPE_DATA:
+			if (!rx_synced)
+			{
+				// the sender continues a session we do not know (we restarted), it has to sync again
+				sync_needed = true;
+				break;
+			}
+			// acknowledgements are collected, one cumulative ack is sent once all received frames were handled
+			ack_needed |= handle_data(seq, p_frame->p_data + PACKET_HEADER_SIZE, p_frame->len - PACKET_HEADER_SIZE);
+			break;
+		case PACKET_TYPE_SYNC:
+		case PACKET_TYPE_SYNC_ACK:
+			if (p_frame->len < SYNC_PACKET_SIZE)
+			{
+				LOG_WRN("sync frame too short (%zu bytes)", p_frame->len);
+				break;
+			}
+			if (type == PACKET_TYPE_SYNC) handle_sync(seq, p_frame->p_data[PACKET_HEADER_SIZE]);
+			else handle_sync_ack(seq, p_frame->p_data[PACKET_HEADER_SIZE]);
+			break;
+		default:
+			LOG_WRN("unknown packet type 0x%02x", type);
+			break;
+		}
+	}
+
+	// a sync received after the data frames already answered the request
+	if (sync_needed && !rx_synced)
+	{
+		send_ack(PACKET_FLAG_SYNC);
+	}
+	else if (ack_needed)
+	{
+		send_ack(0);
+	}
+}
+
+static void retransmit_work_handler(struct k_work * p_work)
+{
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	uint8_t const in_flight = next_seq - base_seq;
+	if (!enabled || (in_flight == 0))
+	{
+		k_mutex_unlock(&tx_lock);
+		return;
+	}
+
+	retries++;
+	if ((config.max_retries > 0) && (retries > config.max_retries))
+	{
+		LOG_ERR("no acknowledgement from peer, %d frames dropped", in_flight);
+		stats.frames_dropped += in_flight;
+		// the peer may have missed any of the dropped frames, so it is told to continue with the next one
+		base_seq = next_seq;
+		unsent_seq = next_seq;
+		tx_synced = false;
+		sync_nonce++;
+		retries = 0;
+		for (int i = 0; i < in_flight; i++)
+		{
+			k_sem_give(&sem_window);
+		}
+		k_mutex_unlock(&tx_lock);
+		return;
+	}
+
+	if (!tx_synced)
+	{
+		LOG_DBG("repeating sync to %d", base_seq);
+		send_sync();
+	}
+	else
+	{
+		LOG_DBG("retransmitting %d frames starting at %d", in_flight, base_seq);
+		send_window();
+	}
+	k_work_reschedule(&retransmit_work, K_MSEC(config.retransmit_timeout_ms));
+	k_mutex_unlock(&tx_lock);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void handle_ack(uint8_t flags, uint8_t ack_seq)
+{
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	uint8_t const acked = ack_seq - base_seq;
+	uint8_t const in_flight = next_seq - base_seq;
+	if ((flags & PACKET_FLAG_SYNC) && tx_synced)
+	{
+		// the unacknowledged frames are sent again once the peer accepted the sync
+		LOG_INF("peer lost its state, synchronizing to %d", base_seq);
+		tx_synced = false;
+		sync_nonce++;
+		retries = 0;
+		if (in_flight > 0)
+		{
+			send_sync();
+			k_work_reschedule(&retransmit_work, K_MSEC(config.retransmit_timeout_ms));
+		}
+		k_mutex_unlock(&tx_lock);
+		return;
+	}
+	// acknowledgements of an older session do not tell anything about the frames in the window
+	if (!tx_synced || (acked == 0) || (acked > in_flight))
+	{
+		// duplicate or stale acknowledgement
+		k_mutex_unlock(&tx_lock);
+		return;
+	}
+
+	base_seq = ack_seq;
+	retries = 0;
+	stats.frames_acked += acked;
+	for (int i = 0; i < acked; i++)
+	{
+		k_sem_give(&sem_window);
+	}
+
+	if (base_seq == next_seq)
+	{
+		k_work_cancel_delayable(&retransmit_work);
+	}
+	else
+	{
+		k_work_reschedule(&retransmit_work, K_MSEC(config.retransmit_timeout_ms));
+	}
+	k_mutex_unlock(&tx_lock);
+}
+
+static bool handle_data(uint8_t seq, char const * p_payload, int len)
+{
+	if (seq != expected_seq)
+	{
+		// go-back-n: out of order frames are dropped, the ack tells the peer where to continue
+		stats.duplicates_received++;
+		return true;
+	}
+
+	if (len > SERIAL_ARQ_MAX_PAYLOAD)
+	{
+		LOG_WRN("payload too large (%d bytes)", len);
+		return false;
+	}
+
+	rx_message.len = len;
+	memcpy(rx_message.data, p_payload, len);
+	rx_message.data[len] = '\0';
+	if (k_msgq_put(&rx_queue, &rx_message, K_NO_WAIT) != 0)
+	{
+		// not acknowledged, the peer retransmits once the application caught up
+		stats.rx_queue_full++;
+		return false;
+	}
+
+	expected_seq++;
+	stats.frames_received++;
+	return true;
+}
+
+// the sender sends no data before the sync is acknowledged and the link keeps the order of the frames, so a
+// repeated sync can never move expected_seq back behind frames which were already accepted
+static void handle_sync(uint8_t seq, uint8_t nonce)
+{
+	LOG_INF("peer synchronized to sequence number %d", seq);
+	expected_seq = seq;
+	rx_synced = true;
+
+	char sync_ack[SYNC_PACKET_SIZE] = { PACKET_TYPE_SYNC_ACK, seq, nonce };
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	serial_ret_code_t ret_code = p_send_frame(K_MSEC(config.retransmit_timeout_ms), sync_ack, sizeof(sync_ack));
+	k_mutex_unlock(&tx_lock);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_WRN("unable to send sync ack (code: %d)", ret_code);
+	}
+}
+
+static void handle_sync_ack(uint8_t seq, uint8_t nonce)
+{
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	if (tx_synced || (seq != base_seq) || (nonce != sync_nonce))
+	{
+		// answer to a repeated or an older sync
+		k_mutex_unlock(&tx_lock);
+		return;
+	}
+
+	tx_synced = true;
+	retries = 0;
+	send_window();
+	if (base_seq == next_seq)
+	{
+		k_work_cancel_delayable(&retransmit_work);
+	}
+	else
+	{
+		k_work_reschedule(&retransmit_work, K_MSEC(config.retransmit_timeout_ms));
+	}
+	k_mutex_unlock(&tx_lock);
+}
+
+static void send_ack(uint8_t flags)
+{
+	char ack[PACKET_HEADER_SIZE] = { PACKET_TYPE_ACK | flags, expected_seq };
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	serial_ret_code_t ret_code = p_send_frame(K_MSEC(config.retransmit_timeout_ms), ack, sizeof(ack));
+	k_mutex_unlock(&tx_lock);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_WRN("unable to send ack (code: %d)", ret_code);
+	}
+}
+
+// called with tx_lock held
+static void send_sync(void)
+{
+	char sync[SYNC_PACKET_SIZE] = { PACKET_TYPE_SYNC, base_seq, sync_nonce };
+	serial_ret_code_t ret_code = p_send_frame(K_MSEC(config.retransmit_timeout_ms), sync, sizeof(sync));
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_WRN("unable to send sync (code: %d)", ret_code);
+	}
+}
+
+// called with tx_lock held, frames which were sent before count as retransmissions
+static void send_window(void)
+{
+	for (uint8_t seq = base_seq; seq != next_seq; seq++)
+	{
+		tx_slot_t const * p_slot = &tx_window[seq % SERIAL_ARQ_MAX_WINDOW];
+		p_send_frame(K_MSEC(config.retransmit_timeout_ms), p_slot->data, p_slot->len);
+		if ((uint8_t)(seq - base_seq) < (uint8_t)(unsent_seq - base_seq)) stats.frames_retransmitted++;
+		else stats.frames_sent++;
+	}
+	unsent_seq = next_seq;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+serial_ret_code_t serial_arq_enable(serial_arq_config_t const * p_config)
+{
+	if ((p_config->window_size < 1) || (p_config->window_size > SERIAL_ARQ_MAX_WINDOW) ||
+		(p_config->retransmit_timeout_ms <= 0) || (p_config->max_retries < 0))
+	{
+		LOG_ERR("invalid configuration (window: %d, max: %d)", p_config->window_size, SERIAL_ARQ_MAX_WINDOW);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+
+	if (enabled)
+	{
+		LOG_ERR("arq already enabled");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+
+	serial_ret_code_t (*p_add_callback)(serial_event_callback_t callback);
+	serial_ret_code_t (*p_set_framing)(serial_framing_t framing);
+	switch (p_config->type)
+	{
+	case SERIAL_TYPE_UART:
+		p_get_line = uart_serial_get_line;
+		p_send_frame = uart_serial_send_frame;
+		p_add_callback = uart_serial_add_callback;
+		p_set_framing = uart_serial_set_framing;
+		break;
+	case SERIAL_TYPE_BLE:
+		p_get_line = ble_serial_get_line;
+		p_send_frame = ble_serial_send_frame;
+		p_add_callback = ble_serial_add_callback;
+		p_set_framing = ble_serial_set_framing;
+		break;
+	default:
+		LOG_ERR("arq runs on exactly one transport");
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+
+	// serial.c must not read lines from the transport or change its framing while the arq layer owns it
+	serial_ret_code_t ret_code = serial_claim(p_config->type);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_ERR("transport %d is already in use by another protocol layer", p_config->type);
+		return ret_code;
+	}
+
+	config = *p_config;
+	stats = (serial_arq_stats_t) { 0 };
+	base_seq = 0;
+	next_seq = 0;
+	unsent_seq = 0;
+	expected_seq = 0;
+	retries = 0;
+	tx_synced = false;
+	rx_synced = false;
+	// a sync acknowledged before a restart must not match the first one after it
+	sync_nonce = sys_rand32_get();
+	k_sem_init(&sem_window, config.window_size, config.window_size);
+	k_msgq_purge(&rx_queue);
+	k_work_init(&rx_work, rx_work_handler);
+	k_work_init_delayable(&retransmit_work, retransmit_work_handler);
+
+	ret_code = p_set_framing(SERIAL_FRAMING_LENGTH_CRC);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_ERR("unable to set framing!");
+		serial_release(p_config->type);
+		return ret_code;
+	}
+	ret_code = p_add_callback(arq_callback);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_ERR("unable to add arq callback!");
+		p_set_framing(SERIAL_FRAMING_LINE);
+		serial_release(p_config->type);
+		return ret_code;
+	}
+
+	enabled = true;
+	LOG_INF("arq enabled (window: %d, timeout: %d ms)", config.window_size, config.retransmit_timeout_ms);
+	// frames received before the callback was added
+	k_work_submit(&rx_work);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_arq_disable()
+{
+	if (!enabled) return SERIAL_RET_CODE_SUCCESS;
+
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	enabled = false;
+	k_work_cancel_delayable(&retransmit_work);
+	k_mutex_unlock(&tx_lock);
+
+	if (config.type == SERIAL_TYPE_UART)
+	{
+		uart_serial_remove_callback(arq_callback);
+		uart_serial_set_framing(SERIAL_FRAMING_LINE);
+	}
+	else
+	{
+		ble_serial_remove_callback(arq_callback);
+		ble_serial_set_framing(SERIAL_FRAMING_LINE);
+	}
+	serial_release(config.type);
+	LOG_INF("arq disabled");
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_arq_send(k_timeout_t timeout, char const * p_data, int len)
+{
+	if (!enabled) return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+	if ((len < 0) || (len > SERIAL_ARQ_MAX_PAYLOAD)) return SERIAL_RET_CODE_ERROR_BUFFER_FULL;
+
+	if (k_sem_take(&sem_window, timeout) != 0)
+	{
+		LOG_WRN("window full");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+
+	k_mutex_lock(&tx_lock, K_FOREVER);
+	tx_slot_t * p_slot = &tx_window[next_seq % SERIAL_ARQ_MAX_WINDOW];
+	p_slot->data[0] = PACKET_TYPE_DATA;
+	p_slot->data[1] = next_seq;
+	memcpy(p_slot->data + PACKET_HEADER_SIZE, p_data, len);
+	p_slot->len = len + PACKET_HEADER_SIZE;
+	next_seq++;
+
+	uint8_t const in_flight = next_seq - base_seq;
+	if (in_flight > stats.window_high_water) stats.window_high_water = in_flight;
+	if (in_flight == 1)
+	{
+		k_work_reschedule(&retransmit_work, K_MSEC(config.retransmit_timeout_ms));
+	}
+
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	if (tx_synced)
+	{
+		// the frame stays in the window, so a failed transmission is repaired by the retransmission
+		ret_code = p_send_frame(timeout, p_slot->data, p_slot->len);
+		unsent_seq = next_seq;
+		stats.frames_sent++;
+	}
+	else if (in_flight == 1)
+	{
+		// the frames wait in the window until the peer acknowledged the sync
+		send_sync();
+	}
+	k_mutex_unlock(&tx_lock);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		LOG_WRN("frame %d not sent (code: %d), waiting for retransmission", (uint8_t)p_slot->data[1], ret_code);
+	}
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_line_t const * serial_arq_receive(k_timeout_t timeout)
+{
+	static serial_line_t const empty_line = { 0 };
+
+	if (k_msgq_get(&rx_queue, &app_message, timeout) != 0)
+	{
+		return &empty_line;
+	}
+	line.mutable.len = app_message.len;
+	line.mutable.more_follows = false;
+	line.mutable.type = config.type;
+	// the peer may have retransmitted while the queue was full
+	if (enabled) k_work_submit(&rx_work);
+	return &(line.fixed);
+}
+
+serial_ret_code_t serial_arq_get_stats(serial_arq_stats_t * p_stats)
+{
+	*p_stats = stats;
+	return SERIAL_RET_CODE_SUCCESS;
+}
\ No newline at end of file
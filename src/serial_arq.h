@@ -0,0 +1,47 @@
+#ifndef SERIAL_ARQ_H_
+#define SERIAL_ARQ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+#include "serial.h"
+
+#ifndef SERIAL_ARQ_MAX_WINDOW
+#define SERIAL_ARQ_MAX_WINDOW 8      // frames which can be kept for retransmission, has to be a power of 2
+#endif // !SERIAL_ARQ_MAX_WINDOW
+
+#ifndef SERIAL_ARQ_MAX_PAYLOAD
+#define SERIAL_ARQ_MAX_PAYLOAD 128   // largest message accepted by serial_arq_send()
+#endif // !SERIAL_ARQ_MAX_PAYLOAD
+
+typedef struct serial_arq_config_s
+{
+	serial_type_t type;              // exactly one transport, enabled by serial_enable() and claimed until serial_arq_disable()
+	int window_size;                 // frames in flight without acknowledgement, 1 is stop-and-wait
+	int retransmit_timeout_ms;
+	int max_retries;                 // unacknowledged frames are dropped after this many retransmissions, 0 retries forever
+} serial_arq_config_t;
+
+typedef struct serial_arq_stats_s
+{
+	uint32_t frames_sent;
+	uint32_t frames_retransmitted;
+	uint32_t frames_acked;
+	uint32_t frames_dropped;         // given up after max_retries
+	uint32_t frames_received;
+	uint32_t duplicates_received;
+	uint32_t rx_queue_full;          // frames not acknowledged because serial_arq_receive() was not called
+	uint32_t framing_errors;         // frames with wrong length or crc
+	uint8_t window_high_water;       // most frames in flight at once, reaches window_size if the window fills the link
+} serial_arq_stats_t;
+
+serial_ret_code_t serial_arq_enable(serial_arq_config_t const * p_config);
+serial_ret_code_t serial_arq_disable();
+serial_ret_code_t serial_arq_send(k_timeout_t timeout, char const * p_data, int len);
+serial_line_t const * serial_arq_receive(k_timeout_t timeout);
+serial_ret_code_t serial_arq_get_stats(serial_arq_stats_t * p_stats);
+
+
+#endif  /* _ SERIAL_ARQ_H_ */
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "serial_framing.h"
+
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+#define LENGTH_CRC_HEADER_SIZE 2
+#define LENGTH_CRC_TRAILER_SIZE 2
+
+typedef enum length_crc_state_e
+{
+	LENGTH_CRC_STATE_LENGTH_LOW,
+	LENGTH_CRC_STATE_LENGTH_HIGH,
+	LENGTH_CRC_STATE_PAYLOAD,
+	LENGTH_CRC_STATE_CRC_LOW,
+	LENGTH_CRC_STATE_CRC_HIGH,
+} length_crc_state_t;
+
+static uint16_t const crc16_nibble_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void reset_decoder(serial_framing_decoder_t * p_decoder)
+{
+	*p_decoder = (serial_framing_decoder_t) { 0 };
+}
+
+static serial_framing_result_t cobs_decode(serial_framing_decoder_t * p_decoder, uint8_t c, char * p_out, size_t * p_len, size_t max_len)
+{
+	if (c == 0x00)
+	{
+		bool const empty = (*p_len == 0) && (p_decoder->code == 0);
+		bool const error = p_decoder->error || (p_decoder->block != 0);
+		reset_decoder(p_decoder);
+		if (error) return SERIAL_FRAMING_RESULT_ERROR;
+		return empty ? SERIAL_FRAMING_RESULT_PENDING : SERIAL_FRAMING_RESULT_COMPLETE;
+	}
+
+	if (p_decoder->error) return SERIAL_FRAMING_RESULT_PENDING;
+
+	if (p_decoder->block == 0)
+	{
+		// a block shorter than 254 data bytes stands for a zero which is only emitted once another block follows
+		if ((p_decoder->code != 0) && (p_decoder->code != 0xFF))
+		{
+			if (*p_len >= max_len)
+			{
+				p_decoder->error = true;
+				return SERIAL_FRAMING_RESULT_PENDING;
+			}
+			p_out[(*p_len)++] = 0x00;
+		}
+		p_decoder->code = c;
+		p_decoder->block = c - 1;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	}
+
+	if (*p_len >= max_len)
+	{
+		p_decoder->error = true;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	}
+	p_out[(*p_len)++] = c;
+	p_decoder->block--;
+	return SERIAL_FRAMING_RESULT_PENDING;
+}
+
+static int cobs_encode(char const * p_in, int len, char * p_out, int out_size)
+{
+	// worst case: one code byte per 254 data bytes, one leading code byte and the delimiter
+	if (out_size < (len + (len / 254) + 2)) return -1;
+
+	int code_index = 0;
+	int out_index = 1;
+	uint8_t code = 1;
+	for (int i = 0; i < len; i++)
+	{
+		if (p_in[i] == 0x00)
+		{
+			p_out[code_index] = code;
+			code_index = out_index++;
+			code = 1;
+			continue;
+		}
+		p_out[out_index++] = p_in[i];
+		code++;
+		if (code == 0xFF)
+		{
+			p_out[code_index] = code;
+			code_index = out_index++;
+			code = 1;
+		}
+	}
+	p_out[code_index] = code;
+	p_out[out_index++] = 0x00;
+	return out_index;
+}
+
+static serial_framing_result_t slip_decode(serial_framing_decoder_t * p_decoder, uint8_t c, char * p_out, size_t * p_len, size_t max_len)
+{
+	if (c == SLIP_END)
+	{
+		bool const error = p_decoder->error || (p_decoder->state != 0);
+		reset_decoder(p_decoder);
+		if (error) return SERIAL_FRAMING_RESULT_ERROR;
+		// back to back END characters are used to flush line noise, they do not form a frame
+		return (*p_len > 0) ? SERIAL_FRAMING_RESULT_COMPLETE : SERIAL_FRAMING_RESULT_PENDING;
+	}
+
+	if (p_decoder->error) return SERIAL_FRAMING_RESULT_PENDING;
+
+	if (c == SLIP_ESC)
+	{
+		p_decoder->state = 1;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	}
+
+	if (p_decoder->state != 0)
+	{
+		p_decoder->state = 0;
+		if (c == SLIP_ESC_END) c = SLIP_END;
+		else if (c == SLIP_ESC_ESC) c = SLIP_ESC;
+		else
+		{
+			p_decoder->error = true;
+			return SERIAL_FRAMING_RESULT_PENDING;
+		}
+	}
+
+	if (*p_len >= max_len)
+	{
+		p_decoder->error = true;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	}
+	p_out[(*p_len)++] = c;
+	return SERIAL_FRAMING_RESULT_PENDING;
+}
+
+static int slip_encode(char const * p_in, int len, char * p_out, int out_size)
+{
+	int out_index = 0;
+	if (out_size < 2) return -1;
+	p_out[out_index++] = SLIP_END;
+	for (int i = 0; i < len; i++)
+	{
+		uint8_t const c = p_in[i];
+		bool const escape = (c == SLIP_END) || (c == SLIP_ESC);
+		if ((out_index + (escape ? 2 : 1) + 1) > out_size) return -1;
+		if (escape)
+		{
+			p_out[out_index++] = SLIP_ESC;
+			p_out[out_index++] = (c == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+		}
+		else
+		{
+			p_out[out_index++] = c;
+		}
+	}
+	p_out[out_index++] = SLIP_END;
+	return out_index;
+}
+
+static serial_framing_result_t length_crc_decode(serial_framing_decoder_t * p_decoder, uint8_t c, char * p_out, size_t * p_len, size_t max_len)
+{
+	switch (p_decoder->state)
+	{
+	case LENGTH_CRC_STATE_LENGTH_LOW:
+		p_decoder->crc = serial_framing_crc16(0xFFFF, &c, 1);
+		p_decoder->remaining = c;
+		p_decoder->state = LENGTH_CRC_STATE_LENGTH_HIGH;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	case LENGTH_CRC_STATE_LENGTH_HIGH:
+		p_decoder->crc = serial_framing_crc16(p_decoder->crc, &c, 1);
+		p_decoder->remaining |= (uint16_t)c << 8;
+		if (p_decoder->remaining > max_len)
+		{
+			reset_decoder(p_decoder);
+			return SERIAL_FRAMING_RESULT_ERROR;
+		}
+		p_decoder->state = (p_decoder->remaining > 0) ? LENGTH_CRC_STATE_PAYLOAD : LENGTH_CRC_STATE_CRC_LOW;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	case LENGTH_CRC_STATE_PAYLOAD:
+		p_decoder->crc = serial_framing_crc16(p_decoder->crc, &c, 1);
+		p_out[(*p_len)++] = c;
+		if (--p_decoder->remaining == 0) p_decoder->state = LENGTH_CRC_STATE_CRC_LOW;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	case LENGTH_CRC_STATE_CRC_LOW:
+		p_decoder->crc ^= c;
+		p_decoder->state = LENGTH_CRC_STATE_CRC_HIGH;
+		return SERIAL_FRAMING_RESULT_PENDING;
+	default:
+		{
+			bool const valid = (p_decoder->crc ^ ((uint16_t)c << 8)) == 0;
+			reset_decoder(p_decoder);
+			return valid ? SERIAL_FRAMING_RESULT_COMPLETE : SERIAL_FRAMING_RESULT_ERROR;
+		}
+	}
+}
+
+static int length_crc_encode(char const * p_in, int len, char * p_out, int out_size)
+{
+	if ((len > UINT16_MAX) || (out_size < (len + LENGTH_CRC_HEADER_SIZE + LENGTH_CRC_TRAILER_SIZE))) return -1;
+
+	p_out[0] = len & 0xFF;
+	p_out[1] = (len >> 8) & 0xFF;
+	memcpy(p_out + LENGTH_CRC_HEADER_SIZE, p_in, len);
+	uint16_t crc = serial_framing_crc16(0xFFFF, (uint8_t const *)p_out, len + LENGTH_CRC_HEADER_SIZE);
+	p_out[len + LENGTH_CRC_HEADER_SIZE] = crc & 0xFF;
+	p_out[len + LENGTH_CRC_HEADER_SIZE + 1] = (crc >> 8) & 0xFF;
+	return len + LENGTH_CRC_HEADER_SIZE + LENGTH_CRC_TRAILER_SIZE;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+serial_framing_engine_t const * serial_framing_get_engine(serial_framing_t framing)
+{
+	static serial_framing_engine_t const cobs = {
+		.decode = cobs_decode,
+		.encode = cobs_encode,
+		.resync_by_byte = false,
+	};
+	static serial_framing_engine_t const slip = {
+		.decode = slip_decode,
+		.encode = slip_encode,
+		.resync_by_byte = false,
+	};
+	static serial_framing_engine_t const length_crc = {
+		.decode = length_crc_decode,
+		.encode = length_crc_encode,
+		.resync_by_byte = true,
+	};
+
+	switch (framing)
+	{
+	case SERIAL_FRAMING_COBS:
+		return &cobs;
+	case SERIAL_FRAMING_SLIP:
+		return &slip;
+	case SERIAL_FRAMING_LENGTH_CRC:
+		return &length_crc;
+	default:
+		return NULL;
+	}
+}
+
+uint16_t serial_framing_crc16(uint16_t crc, uint8_t const * p_data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)p_data[i] << 8;
+		crc = (crc << 4) ^ crc16_nibble_table[crc >> 12];
+		crc = (crc << 4) ^ crc16_nibble_table[crc >> 12];
+	}
+	return crc;
+}
\ No newline at end of file
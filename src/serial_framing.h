@@ -0,0 +1,40 @@
+#ifndef SERIAL_FRAMING_H_
+#define SERIAL_FRAMING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "serial.h"
+
+typedef enum serial_framing_result_e
+{
+	SERIAL_FRAMING_RESULT_PENDING,   // byte consumed, frame not complete yet
+	SERIAL_FRAMING_RESULT_COMPLETE,  // decoded frame is available in the output buffer
+	SERIAL_FRAMING_RESULT_ERROR,     // frame is corrupt and has to be dropped
+} serial_framing_result_t;
+
+typedef struct serial_framing_decoder_s
+{
+	uint8_t state;
+	uint8_t block;
+	uint8_t code;
+	bool error;
+	uint16_t remaining;
+	uint16_t crc;
+} serial_framing_decoder_t;
+
+typedef struct serial_framing_engine_s
+{
+	// decodes one received byte, decoded bytes are appended to p_out, max_len limits the size of a decoded frame
+	serial_framing_result_t (*decode)(serial_framing_decoder_t * p_decoder, uint8_t c, char * p_out, size_t * p_len, size_t max_len);
+	// returns the length of the encoded frame or -1 if it does not fit into p_out
+	int (*encode)(char const * p_in, int len, char * p_out, int out_size);
+	// after an error the stream is searched for the next frame starting with the second byte of the broken one
+	bool resync_by_byte;
+} serial_framing_engine_t;
+
+serial_framing_engine_t const * serial_framing_get_engine(serial_framing_t framing);
+uint16_t serial_framing_crc16(uint16_t crc, uint8_t const * p_data, size_t len);
+
+#endif  /* _ SERIAL_FRAMING_H_ */
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "serial_internal.h"
 
+#include <string.h>
+
 #include <zephyr/logging/log.h>
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -16,80 +18,328 @@
 LOG_MODULE_REGISTER(LOG_MODULE_NAME, SERIAL_INTERNAL_LOG_LEVEL);
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTION DECLARATIONS
+typedef enum flow_control_state_e
+{
+	FLOW_CONTROL_STATE_DATA,
+	FLOW_CONTROL_STATE_ESCAPE,
+} flow_control_state_t;
+
+typedef enum flow_control_token_e
+{
+	FLOW_CONTROL_DATA,
+	FLOW_CONTROL_SKIP,
+	FLOW_CONTROL_XON,
+	FLOW_CONTROL_XOFF,
+	FLOW_CONTROL_GRANT,
+} flow_control_token_t;
+
+static flow_control_token_t parse_flow_control(serial_internal_ring_t const * p_ring, uint8_t * p_state, char c, int * p_units);
+static void flow_control_drained(serial_internal_ring_t * p_ring);
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static bool is_end_character(serial_internal_ring_t const * p_ring, char c)
+{
+	for (int i = 0; i < p_ring->end_character_count; i++)
+	{
+		if (c == p_ring->end_character_list[i]) return true;
+	}
+	return false;
+}
+
+// advances the delimiter match by one byte (knuth-morris-pratt), so no received byte has to be looked at twice
+static bool is_line_end(serial_internal_ring_t const * p_ring, uint8_t * p_matched, char c)
+{
+	if (p_ring->delimiter_len == 0) return is_end_character(p_ring, c);
+	
+	while ((*p_matched > 0) && (c != p_ring->delimiter[*p_matched]))
+	{
+		*p_matched = p_ring->delimiter_fallback[*p_matched - 1];
+	}
+	if (c == p_ring->delimiter[*p_matched]) (*p_matched)++;
+	if (*p_matched < p_ring->delimiter_len) return false;
+	*p_matched = 0;
+	return true;
+}
+
+static void store(serial_internal_ring_t * p_ring, char c)
+{
+	int buffer_index = (p_ring->start_index + p_ring->bytes_in_buffer) % p_ring->size;
+	p_ring->p_buffer[buffer_index] = c;
+	p_ring->bytes_in_buffer++;
+}
+
+static void remove_locked(serial_internal_ring_t * p_ring, int len)
+{
+	p_ring->start_index = (p_ring->start_index + len) % p_ring->size;
+	p_ring->bytes_in_buffer -= len;
+	if (p_ring->open_line_len > p_ring->bytes_in_buffer)
+	{
+		p_ring->open_line_len = p_ring->bytes_in_buffer;
+	}
+}
+
+static void consumed(serial_internal_ring_t * p_ring)
+{
+	if (p_ring->resume_producer != NULL)
+	{
+		p_ring->resume_producer();
+	}
+	flow_control_drained(p_ring);
+}
+
+static void consume(serial_internal_ring_t * p_ring, int len)
+{
+	unsigned int key = irq_lock();
+	remove_locked(p_ring, len);
+	irq_unlock(key);
+	consumed(p_ring);
+}
+
+// takes the scanned bytes out of the buffer, unless the producer dropped the line they belong to since the scan started
+static bool consume_scanned(serial_internal_ring_t * p_ring, int len, uint32_t line_drops)
+{
+	unsigned int key = irq_lock();
+	if (p_ring->line_drops != line_drops)
+	{
+		irq_unlock(key);
+		return false;
+	}
+	remove_locked(p_ring, len);
+	irq_unlock(key);
+	consumed(p_ring);
+	return true;
+}
+
+static flow_control_token_t parse_flow_control(serial_internal_ring_t const * p_ring, uint8_t * p_state, char c, int * p_units)
+{
+	if (p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_XON_XOFF)
+	{
+		if (c == SERIAL_FLOW_CONTROL_XON) return FLOW_CONTROL_XON;
+		if (c == SERIAL_FLOW_CONTROL_XOFF) return FLOW_CONTROL_XOFF;
+		return FLOW_CONTROL_DATA;
+	}
+	
+	if (*p_state == FLOW_CONTROL_STATE_ESCAPE)
+	{
+		*p_state = FLOW_CONTROL_STATE_DATA;
+		if (c == SERIAL_FLOW_CONTROL_ESCAPE) return FLOW_CONTROL_DATA;
+		if (p_units != NULL) *p_units = (uint8_t)c;
+		return FLOW_CONTROL_GRANT;
+	}
+	if (c == SERIAL_FLOW_CONTROL_ESCAPE)
+	{
+		*p_state = FLOW_CONTROL_STATE_ESCAPE;
+		return FLOW_CONTROL_SKIP;
+	}
+	return FLOW_CONTROL_DATA;
+}
+
+static void flow_control_drained(serial_internal_ring_t * p_ring)
+{
+	bool update = false;
+	unsigned int key = irq_lock();
+	switch (p_ring->flow_control.mode)
+	{
+	case SERIAL_FLOW_CONTROL_XON_XOFF:
+		if (p_ring->peer_stopped && (p_ring->bytes_in_buffer <= p_ring->flow_control.low_watermark))
+		{
+			p_ring->peer_stopped = false;
+			update = true;
+		}
+		break;
+	case SERIAL_FLOW_CONTROL_CREDIT:
+		{
+			// grant again once the peer could not fill the buffer beyond the low watermark any more
+			int const grantable = p_ring->flow_control.high_watermark - p_ring->bytes_in_buffer - p_ring->rx_credits;
+			if ((p_ring->bytes_in_buffer + p_ring->rx_credits) <= p_ring->flow_control.low_watermark)
+			{
+				int units = grantable / SERIAL_FLOW_CONTROL_CREDIT_UNIT;
+				if ((units + p_ring->pending_grant) > UINT8_MAX) units = UINT8_MAX - p_ring->pending_grant;
+				// a grant of exactly the escape character would be read as escaped data
+				if ((units + p_ring->pending_grant) == SERIAL_FLOW_CONTROL_ESCAPE) units--;
+				if (units > 0)
+				{
+					p_ring->rx_credits += units * SERIAL_FLOW_CONTROL_CREDIT_UNIT;
+					p_ring->pending_grant += units;
+					update = true;
+				}
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	irq_unlock(key);
+	
+	if (update && (p_ring->flow_control_update != NULL))
+	{
+		p_ring->flow_control_update();
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 serial_line_t const * serial_internal_get_line(
 	struct k_sem * p_sem_data_ready,
 	k_timeout_t timeout,
 	serial_internal_line_t * p_line,
-	uint8_t const * input_buffer,
-	size_t const input_buffer_size,
-	int * p_input_buffer_index,
-	int volatile * p_bytes_in_buffer,
-	char const * end_character_list,
-	int const end_character_count, 
+	serial_internal_ring_t * p_ring,
+	bool const chunked,
 	serial_event_callback_t fire_callbacks_function)
 {
 	static serial_event_t event;
 	static serial_line_t const empty_line = { 0 };
 	
 	LOG_DBG("getting next line");
-	p_line->mutable.len = 0;
+	// the line buffer still holds the bytes copied by the previous call
+	p_line->mutable.len = p_ring->scan.line_len;
+	p_line->mutable.more_follows = false;
+	int scanned = p_ring->scan.scanned;
+	uint8_t control_state = p_ring->scan.control_state;
+	uint8_t delimiter_matched = p_ring->scan.delimiter_matched;
+	serial_framing_engine_t const * const p_engine = p_ring->p_framing_engine;
+	serial_framing_decoder_t decoder = p_ring->scan.decoder;
+	uint32_t line_drops = p_ring->scan.line_drops;
 	
 	while (true)
 	{
-		if ((*p_bytes_in_buffer == p_line->mutable.len) && (k_sem_take(p_sem_data_ready, timeout) != 0))
+		// the bytes of a dropped line can already be replaced by new ones, so the length alone does not tell
+		if ((line_drops != p_ring->line_drops) || (scanned > p_ring->bytes_in_buffer))
+		{
+			LOG_DBG("unterminated line was dropped by the producer");
+			line_drops = p_ring->line_drops;
+			scanned = 0;
+			p_line->mutable.len = 0;
+			control_state = FLOW_CONTROL_STATE_DATA;
+			delimiter_matched = 0;
+			decoder = (serial_framing_decoder_t) { 0 };
+		}
+		
+		if ((p_ring->bytes_in_buffer == scanned) && (k_sem_take(p_sem_data_ready, timeout) != 0))
 		{
 			LOG_DBG("timeout reached");
+			p_ring->scan = (serial_internal_scan_t) {
+				.scanned = scanned,
+				.line_len = p_line->mutable.len,
+				.control_state = control_state,
+				.delimiter_matched = delimiter_matched,
+				.decoder = decoder,
+				.line_drops = line_drops,
+			};
 			return &empty_line;
 		}
 		
 		bool line_end_found = false;
+		bool line_too_long = false;
+		bool frame_error = false;
 
-		int bytes_to_check = *p_bytes_in_buffer;
-		if (bytes_to_check > input_buffer_size)
+		int bytes_to_check = p_ring->bytes_in_buffer;
+		if (bytes_to_check > p_ring->size)
 		{
-			int lost_bytes = *p_bytes_in_buffer - input_buffer_size; 
-			*p_bytes_in_buffer -= lost_bytes;
-			bytes_to_check = input_buffer_size;
-			*p_input_buffer_index = (*p_input_buffer_index + lost_bytes) % input_buffer_size;
+			int lost_bytes = bytes_to_check - p_ring->size; 
+			consume(p_ring, lost_bytes);
+			bytes_to_check = p_ring->size;
+			scanned = 0;
 			p_line->mutable.len = 0;
-			LOG_WRN("overflow! %d bytes overwritten! (StartIndex: %d, BytesInBuffer: %d)", lost_bytes, *p_input_buffer_index, *p_bytes_in_buffer);
+			control_state = FLOW_CONTROL_STATE_DATA;
+			delimiter_matched = 0;
+			decoder = (serial_framing_decoder_t) { 0 };
+			p_ring->overflow_stats.drop_oldest_bytes += lost_bytes;
+			LOG_WRN("overflow! %d bytes overwritten! (StartIndex: %d, BytesInBuffer: %d)", lost_bytes, p_ring->start_index, p_ring->bytes_in_buffer);
 			event.type = SERIAL_EVENT_TYPE_BUFFER_OVERFLOW;
 			event.data.buf_ovf.count = lost_bytes;
 			fire_callbacks_function(&event);
 		}
 		
-		for (int i = p_line->mutable.len; i < bytes_to_check; i++)
+		while (scanned < bytes_to_check)
 		{
-			int buffer_index = (*p_input_buffer_index + i) % input_buffer_size;
-			p_line->mutable.p_buffer[i] = input_buffer[buffer_index];
+			int buffer_index = (p_ring->start_index + scanned) % p_ring->size;
+			char const c = p_ring->p_buffer[buffer_index];
+			scanned++;
+			if ((p_ring->flow_control.mode != SERIAL_FLOW_CONTROL_NONE) && (parse_flow_control(p_ring, &control_state, c, NULL) != FLOW_CONTROL_DATA))
+			{
+				continue;
+			}
+			if (p_engine != NULL)
+			{
+				// frames are decoded while copying, the input buffer itself is never modified
+				serial_framing_result_t const result = p_engine->decode(&decoder, c, p_line->mutable.p_buffer, &(p_line->mutable.len), p_ring->size);
+				if (result == SERIAL_FRAMING_RESULT_PENDING) continue;
+				line_end_found = (result == SERIAL_FRAMING_RESULT_COMPLETE);
+				frame_error = (result == SERIAL_FRAMING_RESULT_ERROR);
+				p_line->mutable.p_buffer[p_line->mutable.len] = '\0';
+				break;
+			}
+			p_line->mutable.p_buffer[p_line->mutable.len] = c;
 			p_line->mutable.len++;
-			for (int j = 0; j < end_character_count; j++)
+			if (is_line_end(p_ring, &delimiter_matched, c))
 			{
-				if (p_line->mutable.p_buffer[i] == end_character_list[j])
-				{
-					p_line->mutable.p_buffer[p_line->mutable.len] = '\0';
-					line_end_found = true;
-					break;
-				}
+				p_line->mutable.p_buffer[p_line->mutable.len] = '\0';
+				line_end_found = true;
+				break;
 			}
-			if (line_end_found)
+			// a line is never split inside of a delimiter sequence
+			if ((p_ring->max_line_len > 0) && (p_line->mutable.len >= p_ring->max_line_len) && (delimiter_matched == 0))
 			{
+				line_too_long = true;
 				break;
 			}
 		}
 		
-		if ((end_character_count == 0 && p_line->mutable.len > 0) || line_end_found)
+		// an incomplete frame in a full buffer can never be completed
+		bool const frame_stuck = (p_engine != NULL) && !line_end_found && !frame_error && p_ring->producer_paused && (scanned > 0);
+		if (frame_error || frame_stuck)
+		{
+			// engines without a unique delimiter look for the next frame start right behind the broken one
+			int const dropped = (p_engine->resync_by_byte && !frame_stuck) ? 1 : scanned;
+			consume(p_ring, dropped);
+			LOG_WRN("framing error, %d bytes dropped", dropped);
+			event.type = SERIAL_EVENT_TYPE_FRAMING_ERROR;
+			event.data.framing_error.count = dropped;
+			fire_callbacks_function(&event);
+			scanned = 0;
+			p_line->mutable.len = 0;
+			control_state = FLOW_CONTROL_STATE_DATA;
+			delimiter_matched = 0;
+			decoder = (serial_framing_decoder_t) { 0 };
+			continue;
+		}
+		
+		// lines reaching the configured maximum length are split in both modes. In chunked mode a line which already
+		// fills half of the input buffer is handed out as partial segment, so the producer always has room left for
+		// the rest of it. A paused producer only resumes once the buffer is drained, therefore an unterminated line
+		// is handed out as partial segment in that case as well. Segments never end inside of an escape sequence
+		// and only end inside of a delimiter sequence if the producer is paused.
+		bool const partial = !line_end_found && (p_engine == NULL) && (control_state == FLOW_CONTROL_STATE_DATA) && (
+			line_too_long ||
+			(chunked && (p_line->mutable.len >= (p_ring->size / 2)) && (delimiter_matched == 0)) ||
+			(p_ring->producer_paused && (scanned > 0)));
+		if (partial)
 		{
-			if (*p_bytes_in_buffer > input_buffer_size)
+			p_line->mutable.p_buffer[p_line->mutable.len] = '\0';
+		}
+		
+		if ((p_engine == NULL && p_ring->end_character_count == 0 && p_ring->delimiter_len == 0 && p_line->mutable.len > 0) || line_end_found || partial)
+		{
+			if (p_ring->bytes_in_buffer > p_ring->size)
 			{
 				line_end_found = false;
 				p_line->mutable.len = 0;
 				LOG_WRN("overflow while copying data to line structure!");
 				break;
 			}
-			*p_input_buffer_index = (*p_input_buffer_index + p_line->mutable.len) % input_buffer_size;
-			*p_bytes_in_buffer -= p_line->mutable.len;
-			LOG_INF("line with length %d returned, bytes left in buffer: %d", p_line->mutable.len, *p_bytes_in_buffer);
+			if (!consume_scanned(p_ring, scanned, line_drops))
+			{
+				// the line was dropped while it was scanned
+				continue;
+			}
+			p_ring->scan = (serial_internal_scan_t) { .line_drops = line_drops };
+			p_line->mutable.more_follows = partial;
+			LOG_INF("%s with length %d returned, bytes left in buffer: %d", partial ? "partial line" : "line", p_line->mutable.len, p_ring->bytes_in_buffer);
 			return &(p_line->fixed);
 		}
 		
@@ -97,5 +347,306 @@ serial_line_t const * serial_internal_get_line(
 	}
 	
 	LOG_ERR("fell through line preparation!");
+	p_ring->scan = (serial_internal_scan_t) { 0 };
 	return &(p_line->fixed);
+}
+
+int serial_internal_put(serial_internal_ring_t * p_ring, char const * p_data, int len)
+{
+	int bytes_stored = 0;
+	int i;
+	for (i = 0; i < len; i++)
+	{
+		char const c = p_data[i];
+		bool const line_end = is_line_end(p_ring, &(p_ring->put_delimiter_matched), c);
+		
+		switch (p_ring->overflow_policy)
+		{
+		case SERIAL_OVERFLOW_POLICY_DROP_OLDEST:
+			// the consumer detects the overrun and skips the overwritten bytes
+			store(p_ring, c);
+			bytes_stored++;
+			continue;
+		case SERIAL_OVERFLOW_POLICY_DROP_NEWEST:
+			if (serial_internal_free_space(p_ring) == 0)
+			{
+				p_ring->overflow_stats.drop_newest_bytes++;
+				LOG_DBG("buffer full, byte dropped");
+				continue;
+			}
+			store(p_ring, c);
+			bytes_stored++;
+			continue;
+		case SERIAL_OVERFLOW_POLICY_DROP_LINE:
+			if (p_ring->discarding_line)
+			{
+				p_ring->overflow_stats.drop_line_bytes++;
+				if (line_end)
+				{
+					p_ring->discarding_line = false;
+					p_ring->overflow_stats.drop_line_count++;
+				}
+				continue;
+			}
+			if (serial_internal_free_space(p_ring) == 0)
+			{
+				// the beginning of the line was never consumed (only copied), so it can still be removed from the buffer
+				p_ring->bytes_in_buffer -= p_ring->open_line_len;
+				p_ring->line_drops++;
+				p_ring->overflow_stats.drop_line_bytes += p_ring->open_line_len + 1;
+				LOG_WRN("buffer full, line dropped");
+				p_ring->open_line_len = 0;
+				if (line_end || ((p_ring->end_character_count == 0) && (p_ring->delimiter_len == 0)))
+				{
+					p_ring->overflow_stats.drop_line_count++;
+				}
+				else
+				{
+					p_ring->discarding_line = true;
+				}
+				continue;
+			}
+			store(p_ring, c);
+			bytes_stored++;
+			p_ring->open_line_len = line_end ? 0 : (p_ring->open_line_len + 1);
+			continue;
+		case SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER:
+			// the caller has to pause its producer and retry with the remaining bytes
+			if (serial_internal_free_space(p_ring) == 0) break;
+			store(p_ring, c);
+			bytes_stored++;
+			continue;
+		}
+		// only reached if the buffer is full in block-producer mode
+		break;
+	}
+	serial_internal_flow_received(p_ring, p_data, i);
+	return bytes_stored;
+}
+
+int serial_internal_free_space(serial_internal_ring_t const * p_ring)
+{
+	int const free_space = p_ring->size - p_ring->bytes_in_buffer;
+	return (free_space > 0) ? free_space : 0;
+}
+
+void serial_internal_pause_producer(serial_internal_ring_t * p_ring)
+{
+	p_ring->producer_paused = true;
+	p_ring->overflow_stats.block_count++;
+	LOG_DBG("producer paused, %d bytes in buffer", p_ring->bytes_in_buffer);
+}
+
+serial_ret_code_t serial_internal_set_delimiter(serial_internal_ring_t * p_ring, char const * p_delimiter, int len)
+{
+	if ((len < 0) || (len > SERIAL_DELIMITER_MAX_LEN))
+	{
+		LOG_ERR("delimiter length %d not supported (max: %d)", len, SERIAL_DELIMITER_MAX_LEN);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	
+	unsigned int key = irq_lock();
+	memcpy(p_ring->delimiter, p_delimiter, len);
+	// delimiter_fallback[i] is the length of the longest proper prefix which is also a suffix of delimiter[0..i]
+	int prefix_len = 0;
+	if (len > 0) p_ring->delimiter_fallback[0] = 0;
+	for (int i = 1; i < len; i++)
+	{
+		while ((prefix_len > 0) && (p_delimiter[i] != p_delimiter[prefix_len]))
+		{
+			prefix_len = p_ring->delimiter_fallback[prefix_len - 1];
+		}
+		if (p_delimiter[i] == p_delimiter[prefix_len]) prefix_len++;
+		p_ring->delimiter_fallback[i] = prefix_len;
+	}
+	p_ring->delimiter_len = len;
+	p_ring->put_delimiter_matched = 0;
+	p_ring->scan = (serial_internal_scan_t) { 0 };
+	irq_unlock(key);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_internal_set_max_line_length(serial_internal_ring_t * p_ring, int max_len)
+{
+	if ((max_len < 0) || (max_len > p_ring->size))
+	{
+		LOG_ERR("max line length %d not supported (buffer size: %zu)", max_len, p_ring->size);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	p_ring->max_line_len = max_len;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_internal_set_flow_control(serial_internal_ring_t * p_ring, serial_flow_control_config_t const * p_config)
+{
+	if ((p_config->mode != SERIAL_FLOW_CONTROL_NONE) && (
+		(p_config->high_watermark > p_ring->size) ||
+		(p_config->low_watermark < 0) ||
+		(p_config->low_watermark >= p_config->high_watermark)))
+	{
+		LOG_ERR("invalid watermarks (high: %d, low: %d)", p_config->high_watermark, p_config->low_watermark);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	
+	unsigned int key = irq_lock();
+	p_ring->flow_control = *p_config;
+	p_ring->peer_stopped = false;
+	p_ring->tx_stopped = false;
+	p_ring->tx_credits = 0;
+	p_ring->rx_credits = 0;
+	p_ring->pending_grant = 0;
+	p_ring->rx_control_state = FLOW_CONTROL_STATE_DATA;
+	p_ring->scan = (serial_internal_scan_t) { 0 };
+	irq_unlock(key);
+	
+	if (p_ring->p_sem_tx_flow != NULL)
+	{
+		k_sem_give(p_ring->p_sem_tx_flow);
+	}
+	// hands out the initial credits
+	flow_control_drained(p_ring);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+void serial_internal_flow_received(serial_internal_ring_t * p_ring, char const * p_data, int len)
+{
+	if (p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_NONE) return;
+	
+	bool tx_allowed = false;
+	for (int i = 0; i < len; i++)
+	{
+		int units = 0;
+		switch (parse_flow_control(p_ring, &(p_ring->rx_control_state), p_data[i], &units))
+		{
+		case FLOW_CONTROL_XON:
+			p_ring->tx_stopped = false;
+			tx_allowed = true;
+			break;
+		case FLOW_CONTROL_XOFF:
+			p_ring->tx_stopped = true;
+			break;
+		case FLOW_CONTROL_GRANT:
+			{
+				unsigned int key = irq_lock();
+				p_ring->tx_credits += units * SERIAL_FLOW_CONTROL_CREDIT_UNIT;
+				irq_unlock(key);
+			}
+			p_ring->rx_credits++;  // the escape character of a grant is not charged
+			tx_allowed = true;
+			break;
+		case FLOW_CONTROL_SKIP:
+			p_ring->rx_credits--;
+			break;
+		case FLOW_CONTROL_DATA:
+			if (p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_CREDIT) p_ring->rx_credits--;
+			break;
+		}
+	}
+	if (tx_allowed && (p_ring->p_sem_tx_flow != NULL))
+	{
+		k_sem_give(p_ring->p_sem_tx_flow);
+	}
+	
+	if ((p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_XON_XOFF) &&
+		!p_ring->peer_stopped &&
+		(p_ring->bytes_in_buffer >= p_ring->flow_control.high_watermark))
+	{
+		p_ring->peer_stopped = true;
+		if (p_ring->flow_control_update != NULL)
+		{
+			p_ring->flow_control_update();
+		}
+	}
+}
+
+int serial_internal_flow_control_message(serial_internal_ring_t * p_ring, char * p_buffer)
+{
+	int len = 0;
+	unsigned int key = irq_lock();
+	switch (p_ring->flow_control.mode)
+	{
+	case SERIAL_FLOW_CONTROL_XON_XOFF:
+		p_buffer[len++] = p_ring->peer_stopped ? SERIAL_FLOW_CONTROL_XOFF : SERIAL_FLOW_CONTROL_XON;
+		break;
+	case SERIAL_FLOW_CONTROL_CREDIT:
+		if (p_ring->pending_grant > 0)
+		{
+			p_buffer[len++] = SERIAL_FLOW_CONTROL_ESCAPE;
+			p_buffer[len++] = p_ring->pending_grant;
+		}
+		break;
+	default:
+		break;
+	}
+	irq_unlock(key);
+	return len;
+}
+
+void serial_internal_flow_control_sent(serial_internal_ring_t * p_ring, char const * p_buffer, int len)
+{
+	if ((p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_CREDIT) && (len == 2))
+	{
+		unsigned int key = irq_lock();
+		p_ring->pending_grant -= (uint8_t)p_buffer[1];
+		irq_unlock(key);
+	}
+}
+
+serial_ret_code_t serial_internal_flow_send(
+	serial_internal_ring_t * p_ring,
+	k_timeout_t timeout,
+	char const * p_data,
+	int len,
+	serial_internal_send_t send_function)
+{
+	static char escape = SERIAL_FLOW_CONTROL_ESCAPE;
+	
+	if (p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_NONE) return send_function(timeout, p_data, len);
+	
+	bool const credit_mode = (p_ring->flow_control.mode == SERIAL_FLOW_CONTROL_CREDIT);
+	int bytes_sent = 0;
+	while (bytes_sent < len)
+	{
+		while (p_ring->tx_stopped || (credit_mode && (p_ring->tx_credits <= 1)))
+		{
+			if (k_sem_take(p_ring->p_sem_tx_flow, timeout) != 0)
+			{
+				LOG_WRN("peer does not accept data");
+				return SERIAL_RET_CODE_ERROR_BUSY;
+			}
+		}
+		
+		int bytes_to_send = len - bytes_sent;
+		bool escape_needed = false;
+		if (credit_mode)
+		{
+			unsigned int key = irq_lock();
+			// one credit is kept back for doubling an escape character
+			if (bytes_to_send > (p_ring->tx_credits - 1)) bytes_to_send = p_ring->tx_credits - 1;
+			char const * p_escape = memchr(p_data + bytes_sent, SERIAL_FLOW_CONTROL_ESCAPE, bytes_to_send);
+			if (p_escape != NULL)
+			{
+				bytes_to_send = p_escape - (p_data + bytes_sent) + 1;
+				escape_needed = true;
+			}
+			p_ring->tx_credits -= bytes_to_send + (escape_needed ? 1 : 0);
+			irq_unlock(key);
+		}
+		
+		// a grant sent between the escape and its doubling would be read as escaped data by the peer
+		if (escape_needed && (k_mutex_lock(p_ring->p_tx_lock, timeout) != 0))
+		{
+			LOG_WRN("flow control message pending");
+			return SERIAL_RET_CODE_ERROR_BUSY;
+		}
+		serial_ret_code_t ret_code = send_function(timeout, p_data + bytes_sent, bytes_to_send);
+		if ((ret_code == SERIAL_RET_CODE_SUCCESS) && escape_needed)
+		{
+			ret_code = send_function(timeout, &escape, 1);
+		}
+		if (escape_needed) k_mutex_unlock(p_ring->p_tx_lock);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS) return ret_code;
+		bytes_sent += bytes_to_send;
+	}
+	return SERIAL_RET_CODE_SUCCESS;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <zephyr/kernel.h>
 
 #include "serial.h"
+#include "serial_framing.h"
 
 typedef union serial_internal_line_u
 {
@@ -12,19 +13,82 @@ typedef union serial_internal_line_u
 	{
 		size_t len;
 		char * p_buffer;
+		bool more_follows;
+		serial_type_t type;
 	} mutable;
 } serial_internal_line_t;
 
+// progress of the consumer on the unterminated line at the start of the buffer, kept between calls so a poll only
+// looks at the bytes received since the last one
+typedef struct serial_internal_scan_s
+{
+	int scanned;                     // bytes of the input buffer already looked at, flow control bytes do not end up in the line
+	size_t line_len;                 // bytes already copied to the line
+	uint8_t control_state;
+	uint8_t delimiter_matched;
+	serial_framing_decoder_t decoder;
+	uint32_t line_drops;             // of the ring when the scan started, the scan is stale once the ring counted a drop
+} serial_internal_scan_t;
+
+typedef serial_ret_code_t (*serial_internal_send_t)(k_timeout_t timeout, char const * p_data, int len);
+
+typedef struct serial_internal_ring_s
+{
+	char * p_buffer;
+	size_t size;
+	int start_index;
+	int volatile bytes_in_buffer;
+	char const * end_character_list;
+	int end_character_count;
+	serial_overflow_policy_t overflow_policy;
+	serial_overflow_stats_t overflow_stats;
+	int volatile open_line_len;      // bytes of the unterminated line at the end of the buffer (drop-line policy)
+	bool volatile discarding_line;   // incoming bytes are dropped until the next end character (drop-line policy)
+	uint32_t volatile line_drops;    // counted up whenever the producer removes the unterminated line (drop-line policy)
+	bool volatile producer_paused;
+	void (*resume_producer)(void);   // called by the consumer whenever data was taken out of the buffer
+	serial_flow_control_config_t flow_control;
+	bool volatile peer_stopped;      // xoff was sent to the peer
+	bool volatile tx_stopped;        // xoff was received from the peer
+	int volatile tx_credits;         // bytes the peer still accepts from us (credit mode)
+	int volatile rx_credits;         // bytes the peer may still send to us (credit mode)
+	int volatile pending_grant;      // credit units which were not sent to the peer yet
+	uint8_t rx_control_state;
+	struct k_sem * p_sem_tx_flow;    // given whenever the peer allows us to send again
+	struct k_mutex * p_tx_lock;      // keeps flow control messages out of an escape and its doubling (credit mode)
+	void (*flow_control_update)(void); // the transport has to send serial_internal_flow_control_message() to the peer
+	serial_framing_engine_t const * p_framing_engine; // NULL splits lines at the end characters
+	char delimiter[SERIAL_DELIMITER_MAX_LEN];  // replaces the end character list if delimiter_len > 0
+	uint8_t delimiter_fallback[SERIAL_DELIMITER_MAX_LEN]; // matched bytes left after a mismatch behind delimiter[i]
+	uint8_t delimiter_len;
+	uint8_t put_delimiter_matched;   // delimiter bytes matched by the producer (drop-line policy)
+	int max_line_len;                // lines are split after this many bytes, 0 disables the limit
+	serial_internal_scan_t scan;
+} serial_internal_ring_t;
+
 serial_line_t const * serial_internal_get_line(
 	struct k_sem * p_sem_data_ready,
 	k_timeout_t timeout,
 	serial_internal_line_t * p_line,
-	uint8_t const * input_buffer,
-	size_t const input_buffer_size,
-	int * p_input_buffer_index,
-	int volatile * p_bytes_in_buffer,
-	char const * end_character_list,
-	int const end_character_count, 
+	serial_internal_ring_t * p_ring,
+	bool const chunked,
 	serial_event_callback_t fire_callbacks_function);
 
-#endif  /* _ SERIAL_INTERNAL_H_ */
+int serial_internal_put(serial_internal_ring_t * p_ring, char const * p_data, int len);
+int serial_internal_free_space(serial_internal_ring_t const * p_ring);
+void serial_internal_pause_producer(serial_internal_ring_t * p_ring);
+
+serial_ret_code_t serial_internal_set_delimiter(serial_internal_ring_t * p_ring, char const * p_delimiter, int len);
+serial_ret_code_t serial_internal_set_max_line_length(serial_internal_ring_t * p_ring, int max_len);
+serial_ret_code_t serial_internal_set_flow_control(serial_internal_ring_t * p_ring, serial_flow_control_config_t const * p_config);
+void serial_internal_flow_received(serial_internal_ring_t * p_ring, char const * p_data, int len);
+int serial_internal_flow_control_message(serial_internal_ring_t * p_ring, char * p_buffer);
+void serial_internal_flow_control_sent(serial_internal_ring_t * p_ring, char const * p_buffer, int len);
+serial_ret_code_t serial_internal_flow_send(
+	serial_internal_ring_t * p_ring,
+	k_timeout_t timeout,
+	char const * p_data,
+	int len,
+	serial_internal_send_t send_function);
+
+#endif  /* _ SERIAL_INTERNAL_H_ */
\ No newline at end of file
@@ -0,0 +1,435 @@
+#include "serial_mux.h"
+
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+
+#include "serial_internal.h"
+#include "uart_serial.h"
+#include "ble_serial.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#ifndef SERIAL_MUX_LOG_LEVEL
+#ifdef SERIAL_LOG_LEVEL
+#define SERIAL_MUX_LOG_LEVEL SERIAL_LOG_LEVEL
+#else
+#define SERIAL_MUX_LOG_LEVEL LOG_LEVEL_WRN
+#endif // SERIAL_LOG_LEVEL
+#endif // !SERIAL_MUX_LOG_LEVEL
+
+#ifndef SERIAL_MUX_QUEUE_LENGTH
+#define SERIAL_MUX_QUEUE_LENGTH 4    // frames buffered per channel and direction
+#endif // !SERIAL_MUX_QUEUE_LENGTH
+
+#ifndef SERIAL_MUX_TX_TIMEOUT
+#define SERIAL_MUX_TX_TIMEOUT 1000
+#endif // !SERIAL_MUX_TX_TIMEOUT
+
+#ifndef SERIAL_MUX_TX_STACK_SIZE
+#define SERIAL_MUX_TX_STACK_SIZE 1024
+#endif // !SERIAL_MUX_TX_STACK_SIZE
+
+#ifndef SERIAL_MUX_TX_PRIORITY
+#define SERIAL_MUX_TX_PRIORITY 7
+#endif // !SERIAL_MUX_TX_PRIORITY
+
+#if SERIAL_MUX_CHANNEL_COUNT > 128
+#error "SERIAL_MUX_CHANNEL_COUNT has to fit into the 7 bit channel id of the frame header"
+#endif
+
+#define LOG_MODULE_NAME serial_mux
+LOG_MODULE_REGISTER(LOG_MODULE_NAME, SERIAL_MUX_LOG_LEVEL);
+
+// every cobs frame starts with the channel id followed by the payload
+#define FRAME_HEADER_SIZE 1
+#define FRAME_FLAG_MORE 0x80         // set in the header of every frame of a split message except the last one
+#define FRAME_CHANNEL_MASK 0x7F
+
+typedef struct mux_message_s
+{
+	int len;
+	bool more_follows;               // only used for received frames
+	char data[FRAME_HEADER_SIZE + SERIAL_MUX_MAX_PAYLOAD + 1];
+} mux_message_t;
+
+typedef struct mux_channel_s
+{
+	struct k_msgq rx_queue;
+	struct k_msgq tx_queue;
+	char rx_queue_buffer[SERIAL_MUX_QUEUE_LENGTH * sizeof(mux_message_t)];
+	char tx_queue_buffer[SERIAL_MUX_QUEUE_LENGTH * sizeof(mux_message_t)];
+	serial_mux_channel_config_t config;
+	uint8_t credit;                  // frames left in the current round robin turn
+	mux_message_t app_message;       // handed out by serial_mux_receive()
+	struct k_mutex send_lock;        // keeps the frames of one serial_mux_send() together in the tx queue
+	bool rx_discarding;              // a frame of the received message was dropped, the rest of it is dropped as well
+	bool tx_open;                    // the tx queue holds the first frames of a message without its last one
+	serial_internal_line_t line;
+} mux_channel_t;
+
+typedef struct mux_instance_s
+{
+	bool enabled;
+	mux_channel_t channels[SERIAL_MUX_CHANNEL_COUNT];
+	int next_channel;                // round robin position
+	mux_message_t rx_message;        // only used by rx_work
+	mux_message_t tx_message;        // only used by tx_work
+	struct k_work rx_work;
+	struct k_work tx_work;
+	serial_line_t const * (*p_get_line)(k_timeout_t timeout);
+	serial_internal_send_t p_send_frame;
+	serial_ret_code_t (*p_set_framing)(serial_framing_t framing);
+	serial_event_callback_t callback;
+} mux_instance_t;
+
+static mux_instance_t uart_instance;
+static mux_instance_t ble_instance;
+
+// frames are sent from an own work queue, waiting for a busy transport must not hold up the system work queue
+static K_THREAD_STACK_DEFINE(tx_stack, SERIAL_MUX_TX_STACK_SIZE);
+static struct k_work_q tx_work_queue;
+static bool tx_work_queue_started = false;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTION DECLARATIONS
+static mux_instance_t * get_instance(serial_type_t type);
+static mux_channel_t * next_channel(mux_instance_t * p_instance);
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// EVENT HANDLERS
+static void uart_mux_callback(serial_event_t const * p_evt)
+{
+	if (p_evt->type == SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED)
+	{
+		k_work_submit(&uart_instance.rx_work);
+	}
+}
+
+static void ble_mux_callback(serial_event_t const * p_evt)
+{
+	if (p_evt->type == SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED)
+	{
+		k_work_submit(&ble_instance.rx_work);
+	}
+}
+
+static void rx_work_handler(struct k_work * p_work)
+{
+	mux_instance_t * p_instance = CONTAINER_OF(p_work, mux_instance_t, rx_work);
+	while (p_instance->enabled)
+	{
+		serial_line_t const * p_frame = p_instance->p_get_line(K_NO_WAIT);
+		if (p_frame->len == 0) break;
+
+		uint8_t const channel = p_frame->p_data[0] & FRAME_CHANNEL_MASK;
+		bool const more_follows = (p_frame->p_data[0] & FRAME_FLAG_MORE) != 0;
+		int const len = p_frame->len - FRAME_HEADER_SIZE;
+		if ((channel >= SERIAL_MUX_CHANNEL_COUNT) || (len > SERIAL_MUX_MAX_PAYLOAD))
+		{
+			LOG_WRN("invalid frame dropped (channel: %d, length: %zu)", channel, p_frame->len);
+			continue;
+		}
+
+		// the frames of a split message are handed out one by one, the receiver appends them until more_follows is
+		// cleared. A message which lost a part is ended by an empty last part in place of its remaining frames.
+		mux_channel_t * p_channel = &(p_instance->channels[channel]);
+		if (p_channel->rx_discarding && more_follows) continue;
+		p_instance->rx_message.len = p_channel->rx_discarding ? 0 : len;
+		p_instance->rx_message.more_follows = more_follows;
+		memcpy(p_instance->rx_message.data, p_frame->p_data + FRAME_HEADER_SIZE, p_instance->rx_message.len);
+		p_instance->rx_message.data[p_instance->rx_message.len] = '\0';
+		p_channel->rx_discarding = false;
+		if (k_msgq_put(&(p_channel->rx_queue), &(p_instance->rx_message), K_NO_WAIT) != 0)
+		{
+			LOG_WRN("rx queue of channel %d full, frame dropped", channel);
+			p_channel->rx_discarding = more_follows;
+		}
+	}
+}
+
+static void tx_work_handler(struct k_work * p_work)
+{
+	mux_instance_t * p_instance = CONTAINER_OF(p_work, mux_instance_t, tx_work);
+	// the channel is chosen again for every frame, so a pending high priority frame waits for one frame at most
+	mux_channel_t * p_channel;
+	while (p_instance->enabled && ((p_channel = next_channel(p_instance)) != NULL))
+	{
+		if (k_msgq_get(&(p_channel->tx_queue), &(p_instance->tx_message), K_NO_WAIT) != 0) continue;
+
+		serial_ret_code_t ret_code = p_instance->p_send_frame(K_MSEC(SERIAL_MUX_TX_TIMEOUT), p_instance->tx_message.data, p_instance->tx_message.len);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_WRN("unable to send frame of channel %d (code: %d)", p_instance->tx_message.data[0] & FRAME_CHANNEL_MASK, ret_code);
+		}
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static mux_instance_t * get_instance(serial_type_t type)
+{
+	switch (type)
+	{
+	case SERIAL_TYPE_UART:
+		return &uart_instance;
+	case SERIAL_TYPE_BLE:
+		return &ble_instance;
+	default:
+		return NULL;
+	}
+}
+
+static mux_channel_t * next_channel(mux_instance_t * p_instance)
+{
+	int best_priority = UINT8_MAX + 1;
+	for (int i = 0; i < SERIAL_MUX_CHANNEL_COUNT; i++)
+	{
+		mux_channel_t * p_channel = &(p_instance->channels[i]);
+		if ((k_msgq_num_used_get(&(p_channel->tx_queue)) > 0) && (p_channel->config.priority < best_priority))
+		{
+			best_priority = p_channel->config.priority;
+		}
+	}
+	if (best_priority > UINT8_MAX) return NULL;
+
+	// weighted round robin among the pending channels of the highest priority, credits are refilled once all are used up
+	for (int round = 0; round < 2; round++)
+	{
+		for (int n = 0; n < SERIAL_MUX_CHANNEL_COUNT; n++)
+		{
+			int const i = (p_instance->next_channel + n) % SERIAL_MUX_CHANNEL_COUNT;
+			mux_channel_t * p_channel = &(p_instance->channels[i]);
+			if ((p_channel->config.priority != best_priority) || (p_channel->credit == 0) ||
+				(k_msgq_num_used_get(&(p_channel->tx_queue)) == 0))
+			{
+				continue;
+			}
+			p_channel->credit--;
+			p_instance->next_channel = (p_channel->credit == 0) ? (i + 1) : i;
+			return p_channel;
+		}
+
+		for (int i = 0; i < SERIAL_MUX_CHANNEL_COUNT; i++)
+		{
+			if (p_instance->channels[i].config.priority == best_priority)
+			{
+				p_instance->channels[i].credit = p_instance->channels[i].config.weight;
+			}
+		}
+	}
+	return NULL;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+serial_ret_code_t serial_mux_enable(serial_type_t type)
+{
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_SUCCESS;
+	if (!(type & (SERIAL_TYPE_UART | SERIAL_TYPE_BLE))) return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+
+	if (!tx_work_queue_started)
+	{
+		k_work_queue_init(&tx_work_queue);
+		k_work_queue_start(&tx_work_queue, tx_stack, K_THREAD_STACK_SIZEOF(tx_stack), SERIAL_MUX_TX_PRIORITY, NULL);
+		tx_work_queue_started = true;
+	}
+
+	for (serial_type_t single_type = SERIAL_TYPE_UART; single_type <= SERIAL_TYPE_BLE; single_type <<= 1)
+	{
+		if (!(type & single_type)) continue;
+
+		mux_instance_t * p_instance = get_instance(single_type);
+		if (p_instance->enabled) continue;
+
+		// serial.c must not read lines from the transport or change its framing while the mux owns it
+		ret_code = serial_claim(single_type);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("transport %d is already in use by another protocol layer", single_type);
+			return ret_code;
+		}
+
+		serial_ret_code_t (*p_add_callback)(serial_event_callback_t callback);
+		if (single_type == SERIAL_TYPE_UART)
+		{
+			p_instance->p_get_line = uart_serial_get_line;
+			p_instance->p_send_frame = uart_serial_send_frame;
+			p_instance->p_set_framing = uart_serial_set_framing;
+			p_instance->callback = uart_mux_callback;
+			p_add_callback = uart_serial_add_callback;
+		}
+		else
+		{
+			p_instance->p_get_line = ble_serial_get_line;
+			p_instance->p_send_frame = ble_serial_send_frame;
+			p_instance->p_set_framing = ble_serial_set_framing;
+			p_instance->callback = ble_mux_callback;
+			p_add_callback = ble_serial_add_callback;
+		}
+
+		for (int i = 0; i < SERIAL_MUX_CHANNEL_COUNT; i++)
+		{
+			mux_channel_t * p_channel = &(p_instance->channels[i]);
+			k_msgq_init(&(p_channel->rx_queue), p_channel->rx_queue_buffer, sizeof(mux_message_t), SERIAL_MUX_QUEUE_LENGTH);
+			k_msgq_init(&(p_channel->tx_queue), p_channel->tx_queue_buffer, sizeof(mux_message_t), SERIAL_MUX_QUEUE_LENGTH);
+			if (p_channel->config.weight == 0) p_channel->config.weight = 1;
+			p_channel->credit = p_channel->config.weight;
+			p_channel->line.mutable.p_buffer = p_channel->app_message.data;
+			p_channel->rx_discarding = false;
+			p_channel->tx_open = false;
+			k_mutex_init(&(p_channel->send_lock));
+		}
+		p_instance->next_channel = 0;
+		k_work_init(&(p_instance->rx_work), rx_work_handler);
+		k_work_init(&(p_instance->tx_work), tx_work_handler);
+
+		ret_code = p_instance->p_set_framing(SERIAL_FRAMING_COBS);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to set framing!");
+			serial_release(single_type);
+			return ret_code;
+		}
+		ret_code = p_add_callback(p_instance->callback);
+		if (ret_code != SERIAL_RET_CODE_SUCCESS)
+		{
+			LOG_ERR("unable to add mux callback!");
+			p_instance->p_set_framing(SERIAL_FRAMING_LINE);
+			serial_release(single_type);
+			return ret_code;
+		}
+		p_instance->enabled = true;
+		k_work_submit(&(p_instance->rx_work));
+		LOG_INF("mux enabled on transport %d", single_type);
+	}
+
+	return ret_code;
+}
+
+serial_ret_code_t serial_mux_disable(serial_type_t type)
+{
+	if ((type & SERIAL_TYPE_UART) && uart_instance.enabled)
+	{
+		uart_instance.enabled = false;
+		uart_serial_remove_callback(uart_instance.callback);
+		uart_serial_set_framing(SERIAL_FRAMING_LINE);
+		serial_release(SERIAL_TYPE_UART);
+	}
+
+	if ((type & SERIAL_TYPE_BLE) && ble_instance.enabled)
+	{
+		ble_instance.enabled = false;
+		ble_serial_remove_callback(ble_instance.callback);
+		ble_serial_set_framing(SERIAL_FRAMING_LINE);
+		serial_release(SERIAL_TYPE_BLE);
+	}
+
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_mux_configure_channel(serial_type_t type, uint8_t channel, serial_mux_channel_config_t const * p_config)
+{
+	if ((channel >= SERIAL_MUX_CHANNEL_COUNT) || (p_config->weight == 0))
+	{
+		LOG_ERR("invalid channel configuration (channel: %d, weight: %d)", channel, p_config->weight);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+
+	if (type & SERIAL_TYPE_UART)
+	{
+		uart_instance.channels[channel].config = *p_config;
+		uart_instance.channels[channel].credit = p_config->weight;
+	}
+
+	if (type & SERIAL_TYPE_BLE)
+	{
+		ble_instance.channels[channel].config = *p_config;
+		ble_instance.channels[channel].credit = p_config->weight;
+	}
+
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t serial_mux_send(serial_type_t type, uint8_t channel, k_timeout_t timeout, char const * p_data, int len)
+{
+	mux_message_t message;
+	serial_ret_code_t ret_code = SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+
+	if (channel >= SERIAL_MUX_CHANNEL_COUNT) return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+
+	for (serial_type_t single_type = SERIAL_TYPE_UART; single_type <= SERIAL_TYPE_BLE; single_type <<= 1)
+	{
+		mux_instance_t * p_instance = get_instance(single_type);
+		if (!(type & single_type) || !p_instance->enabled) continue;
+
+		mux_channel_t * p_channel = &(p_instance->channels[channel]);
+		if (k_mutex_lock(&(p_channel->send_lock), timeout) != 0)
+		{
+			LOG_WRN("channel %d busy", channel);
+			ret_code = SERIAL_RET_CODE_ERROR_BUSY;
+			continue;
+		}
+		ret_code = SERIAL_RET_CODE_SUCCESS;
+		if (p_channel->tx_open)
+		{
+			// ends the previous message, which could not be queued completely, with an empty last part
+			message.data[0] = channel;
+			message.len = FRAME_HEADER_SIZE;
+			if (k_msgq_put(&(p_channel->tx_queue), &message, timeout) != 0)
+			{
+				LOG_WRN("tx queue of channel %d full", channel);
+				ret_code = SERIAL_RET_CODE_ERROR_BUFFER_FULL;
+				k_mutex_unlock(&(p_channel->send_lock));
+				continue;
+			}
+			p_channel->tx_open = false;
+			k_work_submit_to_queue(&tx_work_queue, &(p_instance->tx_work));
+		}
+		for (int offset = 0; offset < len; offset += SERIAL_MUX_MAX_PAYLOAD)
+		{
+			int const chunk_len = ((len - offset) > SERIAL_MUX_MAX_PAYLOAD) ? SERIAL_MUX_MAX_PAYLOAD : (len - offset);
+			message.data[0] = channel | (((offset + chunk_len) < len) ? FRAME_FLAG_MORE : 0);
+			memcpy(message.data + FRAME_HEADER_SIZE, p_data + offset, chunk_len);
+			message.len = chunk_len + FRAME_HEADER_SIZE;
+			if (k_msgq_put(&(p_channel->tx_queue), &message, timeout) != 0)
+			{
+				LOG_WRN("tx queue of channel %d full", channel);
+				ret_code = SERIAL_RET_CODE_ERROR_BUFFER_FULL;
+				p_channel->tx_open = (offset > 0);
+				break;
+			}
+			k_work_submit_to_queue(&tx_work_queue, &(p_instance->tx_work));
+		}
+		k_mutex_unlock(&(p_channel->send_lock));
+	}
+
+	return ret_code;
+}
+
+serial_line_t const * serial_mux_receive(serial_type_t type, uint8_t channel, k_timeout_t timeout)
+{
+	static serial_line_t const empty_line = { 0 };
+
+	mux_instance_t * p_instance = get_instance(type);
+	if ((p_instance == NULL) || !p_instance->enabled || (channel >= SERIAL_MUX_CHANNEL_COUNT))
+	{
+		LOG_ERR("mux not enabled on transport %d or invalid channel %d", type, channel);
+		return &empty_line;
+	}
+
+	mux_channel_t * p_channel = &(p_instance->channels[channel]);
+	if (k_msgq_get(&(p_channel->rx_queue), &(p_channel->app_message), timeout) != 0)
+	{
+		return &empty_line;
+	}
+	p_channel->line.mutable.len = p_channel->app_message.len;
+	p_channel->line.mutable.more_follows = p_channel->app_message.more_follows;
+	p_channel->line.mutable.type = type;
+	return &(p_channel->line.fixed);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef SERIAL_MUX_H_
+#define SERIAL_MUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+#include "serial.h"
+
+#ifndef SERIAL_MUX_CHANNEL_COUNT
+#define SERIAL_MUX_CHANNEL_COUNT 4   // virtual channels per transport
+#endif // !SERIAL_MUX_CHANNEL_COUNT
+
+#ifndef SERIAL_MUX_MAX_PAYLOAD
+#define SERIAL_MUX_MAX_PAYLOAD 64    // longer messages are split, so a burst on one channel can be interrupted by others
+#endif // !SERIAL_MUX_MAX_PAYLOAD
+
+typedef struct serial_mux_channel_config_s
+{
+	uint8_t priority;                // 0 is the highest priority, lower priorities only send while higher ones are idle
+	uint8_t weight;                  // frames sent in turn among channels of the same priority, at least 1
+} serial_mux_channel_config_t;
+
+serial_ret_code_t serial_mux_enable(serial_type_t type);
+serial_ret_code_t serial_mux_disable(serial_type_t type);
+serial_ret_code_t serial_mux_configure_channel(serial_type_t type, uint8_t channel, serial_mux_channel_config_t const * p_config);
+serial_ret_code_t serial_mux_send(serial_type_t type, uint8_t channel, k_timeout_t timeout, char const * p_data, int len);
+// messages longer than SERIAL_MUX_MAX_PAYLOAD are received in parts, more_follows is set on all but the last one. A
+// message which lost parts to a full queue is ended by an empty part with more_follows cleared.
+serial_line_t const * serial_mux_receive(serial_type_t type, uint8_t channel, k_timeout_t timeout);
+
+
+#endif  /* _ SERIAL_MUX_H_ */
\ No newline at end of file
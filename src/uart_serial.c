@@ -66,15 +66,19 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME, UART_SERIAL_LOG_LEVEL);
 #endif // !UART_SERIAL_BUFFER_SIZE
 
 #ifndef UART_SERIAL_CALLBACK_LIMIT
-#define UART_SERIAL_CALLBACK_LIMIT 1
+#define UART_SERIAL_CALLBACK_LIMIT 2
 #endif // !UART_SERIAL_CALLBACK_LIMIT
 
 #define RECEIVE_TIMEOUT 100
+#define DISCARD_BUFFER_SIZE 16  // rx target while the next partition still holds unread data, received bytes are counted as lost
+#define FLOW_CONTROL_RETRY_DELAY 1
 
 static const struct device *const uart = DEVICE_DT_GET(UART_SERIAL_INSTANCE);
 static K_SEM_DEFINE(sem_data_ready, 0, 1);
 static K_SEM_DEFINE(sem_wait_for_disable, 0, 1);
 static K_SEM_DEFINE(sem_wait_for_tx, 1, 1);
+static K_SEM_DEFINE(sem_tx_flow, 0, 1);
+static K_MUTEX_DEFINE(tx_lock);
 
 static char input_buffer[UART_SERIAL_INPUT_BUFFER_SIZE + 1];
 static char output_buffer[UART_SERIAL_OUTPUT_BUFFER_SIZE + 1];
@@ -83,15 +87,19 @@ static serial_internal_line_t line = {
 	.mutable = { 
 		.len = 0,
 		.p_buffer = line_buffer,
+		.type = SERIAL_TYPE_UART,
 	},
 };
 
-static int start_index = 0;
-static volatile int bytes_in_buffer = 0;
-static volatile int input_buffer_index = 0;
+static serial_internal_ring_t ring = {
+	.p_buffer = input_buffer,
+	.size = UART_SERIAL_INPUT_BUFFER_SIZE,
+	.overflow_policy = SERIAL_OVERFLOW_POLICY_DROP_OLDEST,
+	.p_sem_tx_flow = &sem_tx_flow,
+	.p_tx_lock = &tx_lock,
+};
+static struct k_work_delayable flow_control_work;
 
-static char const * end_character_list = NULL;
-static int end_character_count = 0;
 static bool enabled = false;
 
 static serial_event_callback_t callback_list[UART_SERIAL_CALLBACK_LIMIT] = { NULL };
@@ -102,6 +110,13 @@ static serial_event_t event;
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // STATIC FUNCTION DECLARATIONS
 static void fire_callbacks(serial_event_t const * p_evt);
+static void resume_rx(void);
+static serial_ret_code_t send_raw(k_timeout_t timeout, char const * p_data, int len);
+static void flow_control_work_handler(struct k_work * p_work);
+static void flow_control_update(void);
+#if !(DT_NODE_HAS_COMPAT(UART_SERIAL_INSTANCE, zephyr_cdc_acm_uart))
+static bool next_buffer_free(void);
+#endif
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -111,19 +126,37 @@ static void fire_callbacks(serial_event_t const * p_evt);
 static char * buffer1 = input_buffer;
 static char * buffer2 = input_buffer + PARTITION_SIZE;
 static char * next_buffer;
+static uint8_t discard_buffer[2][DISCARD_BUFFER_SIZE];
+static int next_discard_buffer = 0;
 void uart_callback(const struct device *dev, struct uart_event *evt, void *user_data)
 {
 	switch (evt->type)
 	{
 	case UART_RX_RDY:
 		{
-			bytes_in_buffer += evt->data.rx.len;
+			if ((evt->data.rx.buf == discard_buffer[0]) || (evt->data.rx.buf == discard_buffer[1]))
+			{
+				// the peer could not be held back, control bytes are still honoured
+				serial_internal_flow_received(&ring, evt->data.rx.buf + evt->data.rx.offset, evt->data.rx.len);
+				if (ring.overflow_policy == SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER)
+				{
+					ring.overflow_stats.block_lost_bytes += evt->data.rx.len;
+				}
+				else
+				{
+					ring.overflow_stats.drop_newest_bytes += evt->data.rx.len;
+				}
+				LOG_DBG("input buffer full, %d bytes lost", evt->data.rx.len);
+				break;
+			}
+			ring.bytes_in_buffer += evt->data.rx.len;
+			serial_internal_flow_received(&ring, evt->data.rx.buf + evt->data.rx.offset, evt->data.rx.len);
 			k_sem_give(&sem_data_ready);
 			event.type = SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED;
 			event.data.new_data.count = evt->data.rx.len;
 			event.data.new_data.p_buf = evt->data.rx.buf + evt->data.rx.offset;
 			fire_callbacks(&event);
-			LOG_DBG("received %d bytes, %d bytes in buffer", evt->data.rx.len, bytes_in_buffer);
+			LOG_DBG("received %d bytes, %d bytes in buffer", evt->data.rx.len, ring.bytes_in_buffer);
 			break;
 		}
 	case UART_RX_STOPPED:
@@ -136,6 +169,16 @@ void uart_callback(const struct device *dev, struct uart_event *evt, void *user_
 		break;
 	case UART_RX_BUF_REQUEST:
 		LOG_DBG("RX buffer requested");
+		if ((ring.overflow_policy != SERIAL_OVERFLOW_POLICY_DROP_OLDEST) && !next_buffer_free())
+		{
+			// without a buffer the driver would stop rx and drop the bytes uncounted, the partition is handed out
+			// again with the first buffer request that finds it free
+			if (!ring.producer_paused) serial_internal_pause_producer(&ring);
+			uart_rx_buf_rsp(dev, discard_buffer[next_discard_buffer], DISCARD_BUFFER_SIZE);
+			next_discard_buffer ^= 1;
+			LOG_DBG("next buffer still in use");
+			break;
+		}
 		uart_rx_buf_rsp(dev, next_buffer, PARTITION_SIZE);
 		LOG_DBG("new buffer: 0x%032x", (uint32_t)next_buffer);
 		next_buffer = (next_buffer == buffer1) ? buffer2 : buffer1;
@@ -164,19 +207,26 @@ void serial_cb(const struct device *dev, void *user_data)
 	int bytes_received = 0;
 	while (uart_irq_rx_ready(dev))
 	{
-		uart_fifo_read(dev, input_buffer + input_buffer_index, 1);
+		if ((ring.overflow_policy == SERIAL_OVERFLOW_POLICY_BLOCK_PRODUCER) && (serial_internal_free_space(&ring) == 0))
+		{
+			// leave the data in the fifo, the usb stack naks the host until rx is enabled again in resume_rx()
+			uart_irq_rx_disable(dev);
+			serial_internal_pause_producer(&ring);
+			break;
+		}
+		char c;
+		if (uart_fifo_read(dev, &c, 1) != 1) break;
+		serial_internal_put(&ring, &c, 1);
 		bytes_received++;
-		input_buffer_index = (input_buffer_index + 1) % UART_SERIAL_INPUT_BUFFER_SIZE;
 	}
 	if (bytes_received > 0)
 	{
-		bytes_in_buffer += bytes_received;
 		k_sem_give(&sem_data_ready);
 		event.type = SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED;
 		event.data.new_data.count = 0;
 		event.data.new_data.p_buf = NULL;
 		fire_callbacks(&event);
-		LOG_DBG("received %d bytes, %d bytes in buffer", bytes_received, bytes_in_buffer);
+		LOG_DBG("received %d bytes, %d bytes in buffer", bytes_received, ring.bytes_in_buffer);
 	}
 	
 	if (uart_irq_tx_complete(dev))
@@ -201,6 +251,97 @@ static void fire_callbacks(serial_event_t const * p_evt)
 		}
 	}
 }
+
+static serial_ret_code_t send_raw(k_timeout_t timeout, char const * p_data, int len)
+{
+	if (len == 0) return SERIAL_RET_CODE_SUCCESS;
+	
+	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
+	{
+		LOG_WRN("uart tx busy");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+#if !(DT_NODE_HAS_COMPAT(UART_SERIAL_INSTANCE, zephyr_cdc_acm_uart))
+	int err = uart_tx(uart, p_data, len, 100);
+#else
+	int err = uart_fifo_fill(uart, p_data, len);
+#endif
+	
+	if (err < 0)
+	{
+		k_sem_give(&sem_wait_for_tx);
+	}
+	else
+	{
+		err = 0;
+	}
+	
+	switch (err)
+	{
+	case 0:
+		return SERIAL_RET_CODE_SUCCESS;
+	case -EBUSY:
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	case -ENOTSUP:
+		return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+	default:
+		return SERIAL_RET_CODE_ERROR_UNKNOWN;
+	}
+}
+
+static void flow_control_work_handler(struct k_work * p_work)
+{
+	static char message[2];
+	if (!enabled) return;
+	
+	if (k_mutex_lock(&tx_lock, K_NO_WAIT) != 0)
+	{
+		k_work_reschedule(&flow_control_work, K_MSEC(FLOW_CONTROL_RETRY_DELAY));
+		return;
+	}
+	int len = serial_internal_flow_control_message(&ring, message);
+	serial_ret_code_t ret_code = (len > 0) ? send_raw(K_NO_WAIT, message, len) : SERIAL_RET_CODE_SUCCESS;
+	k_mutex_unlock(&tx_lock);
+	if (ret_code != SERIAL_RET_CODE_SUCCESS)
+	{
+		k_work_reschedule(&flow_control_work, K_MSEC(FLOW_CONTROL_RETRY_DELAY));
+		return;
+	}
+	if (len > 0) serial_internal_flow_control_sent(&ring, message, len);
+}
+
+static void flow_control_update(void)
+{
+	k_work_reschedule(&flow_control_work, K_NO_WAIT);
+}
+
+#if !(DT_NODE_HAS_COMPAT(UART_SERIAL_INSTANCE, zephyr_cdc_acm_uart))
+static bool next_buffer_free(void)
+{
+	// the unread data ends at the write index, it must not reach back into the partition before the current one
+	int write_index = (ring.start_index + ring.bytes_in_buffer) % UART_SERIAL_INPUT_BUFFER_SIZE;
+	return ring.bytes_in_buffer <= (write_index % PARTITION_SIZE);
+}
+
+static void resume_rx(void)
+{
+	unsigned int key = irq_lock();
+	if (ring.producer_paused && next_buffer_free())
+	{
+		ring.producer_paused = false;
+	}
+	irq_unlock(key);
+}
+#else
+static void resume_rx(void)
+{
+	if (ring.producer_paused && (ring.bytes_in_buffer <= (UART_SERIAL_INPUT_BUFFER_SIZE / 2)))
+	{
+		ring.producer_paused = false;
+		uart_irq_rx_enable(uart);
+	}
+}
+#endif
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 serial_ret_code_t uart_serial_add_callback(serial_event_callback_t callback)
@@ -261,7 +402,12 @@ serial_ret_code_t uart_serial_enable()
 	
 	k_sem_give(&sem_wait_for_tx);
 	input_buffer[UART_SERIAL_INPUT_BUFFER_SIZE] = '\0';
+	ring.resume_producer = resume_rx;
+	k_work_init_delayable(&flow_control_work, flow_control_work_handler);
+	ring.flow_control_update = flow_control_update;
 	enabled = true;
+	// sends the initial credits if flow control was configured before
+	flow_control_update();
 	
 	LOG_INF("uart_serial enabled");
 	return SERIAL_RET_CODE_SUCCESS;
@@ -289,51 +435,32 @@ serial_ret_code_t uart_serial_disable()
 serial_line_t const * uart_serial_get_line(k_timeout_t timeout)
 {
 	LOG_DBG("getting next line");
-	line.mutable.len = 0;
 	if (!enabled)
 	{
 		LOG_ERR("uart_serial not enabled");
+		line.mutable.len = 0;
 		return &(line.fixed);
 	}
 	
-	return serial_internal_get_line(&sem_data_ready, timeout, &line, input_buffer, UART_SERIAL_INPUT_BUFFER_SIZE, &start_index, &bytes_in_buffer, end_character_list, end_character_count, fire_callbacks);
+	return serial_internal_get_line(&sem_data_ready, timeout, &line, &ring, false, fire_callbacks);
 }
 
-serial_ret_code_t uart_serial_send(k_timeout_t timeout, char const * p_data, int len)
+serial_line_t const * uart_serial_get_chunk(k_timeout_t timeout)
 {
-	if (len == 0) return SERIAL_RET_CODE_SUCCESS;
-	
-	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
-	{
-		LOG_WRN("uart tx busy");
-		return SERIAL_RET_CODE_ERROR_BUSY;
-	}
-#if !(DT_NODE_HAS_COMPAT(UART_SERIAL_INSTANCE, zephyr_cdc_acm_uart))
-	int err = uart_tx(uart, p_data, len, 100);
-#else
-	int err = uart_fifo_fill(uart, p_data, len);
-#endif
-	
-	if (err < 0)
-	{
-		k_sem_give(&sem_wait_for_tx);
-	}
-	else
+	LOG_DBG("getting next chunk");
+	if (!enabled)
 	{
-		err = 0;
+		LOG_ERR("uart_serial not enabled");
+		line.mutable.len = 0;
+		return &(line.fixed);
 	}
 	
-	switch (err)
-	{
-	case 0:
-		return SERIAL_RET_CODE_SUCCESS;
-	case -EBUSY:
-		return SERIAL_RET_CODE_ERROR_BUSY;
-	case -ENOTSUP:
-		return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
-	default:
-		return SERIAL_RET_CODE_ERROR_UNKNOWN;
-	}
+	return serial_internal_get_line(&sem_data_ready, timeout, &line, &ring, true, fire_callbacks);
+}
+
+serial_ret_code_t uart_serial_send(k_timeout_t timeout, char const * p_data, int len)
+{
+	return serial_internal_flow_send(&ring, timeout, p_data, len, send_raw);
 }
 
 serial_ret_code_t uart_serial_sendf(k_timeout_t timeout, char const * format, ...)
@@ -361,11 +488,82 @@ serial_ret_code_t uart_serial_vsendf(k_timeout_t timeout, const char * format, v
 
 serial_ret_code_t uart_serial_set_end_character_list(char const * p_list, int len)
 {
-	end_character_count = len;
-	end_character_list = p_list;
+	ring.end_character_count = len;
+	ring.end_character_list = p_list;
 	LOG_INF("end character list updated");
 	return SERIAL_RET_CODE_SUCCESS;
 }
+
+serial_ret_code_t uart_serial_set_delimiter(char const * p_delimiter, int len)
+{
+	LOG_INF("delimiter with length %d set", len);
+	return serial_internal_set_delimiter(&ring, p_delimiter, len);
+}
+
+serial_ret_code_t uart_serial_set_max_line_length(int max_len)
+{
+	LOG_INF("max line length set to %d", max_len);
+	return serial_internal_set_max_line_length(&ring, max_len);
+}
+
+serial_ret_code_t uart_serial_set_overflow_policy(serial_overflow_policy_t policy)
+{
+#if !(DT_NODE_HAS_COMPAT(UART_SERIAL_INSTANCE, zephyr_cdc_acm_uart))
+	// the dma writes directly into the input buffer, while the next partition holds unread data rx goes to a
+	// discard buffer. Without hardware or credit flow control drop-newest and block-producer therefore behave
+	// the same, except for the counter the lost bytes are added to.
+	if (policy == SERIAL_OVERFLOW_POLICY_DROP_LINE)
+	{
+		LOG_ERR("drop-line policy is not supported with the async api");
+		return SERIAL_RET_CODE_ERROR_NOT_SUPPORTED;
+	}
+#endif
+	ring.overflow_policy = policy;
+	LOG_INF("overflow policy set to %d", policy);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t uart_serial_get_overflow_stats(serial_overflow_stats_t * p_stats)
+{
+	*p_stats = ring.overflow_stats;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t uart_serial_set_flow_control(serial_flow_control_config_t const * p_config)
+{
+	LOG_INF("flow control set to %d", p_config->mode);
+	return serial_internal_set_flow_control(&ring, p_config);
+}
+
+serial_ret_code_t uart_serial_set_framing(serial_framing_t framing)
+{
+	serial_framing_engine_t const * p_engine = serial_framing_get_engine(framing);
+	if ((p_engine == NULL) && (framing != SERIAL_FRAMING_LINE))
+	{
+		LOG_ERR("unknown framing %d", framing);
+		return SERIAL_RET_CODE_ERROR_INVALID_PARAMETER;
+	}
+	ring.p_framing_engine = p_engine;
+	ring.scan = (serial_internal_scan_t) { 0 };
+	LOG_INF("framing set to %d", framing);
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_ret_code_t uart_serial_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	if (ring.p_framing_engine == NULL) return uart_serial_send(timeout, p_data, len);
+	
+	if (k_sem_take(&sem_wait_for_tx, timeout) != 0)
+	{
+		LOG_WRN("uart tx busy");
+		return SERIAL_RET_CODE_ERROR_BUSY;
+	}
+	k_sem_give(&sem_wait_for_tx);
+	
+	int const frame_len = ring.p_framing_engine->encode(p_data, len, output_buffer, UART_SERIAL_OUTPUT_BUFFER_SIZE);
+	if (frame_len < 0) return SERIAL_RET_CODE_ERROR_BUFFER_FULL;
+	return uart_serial_send(timeout, output_buffer, frame_len);
+}
 #else
 #ifndef UART_SERIAL_LOG_LEVEL
 #ifdef SERIAL_LOG_LEVEL
@@ -409,6 +607,13 @@ serial_line_t const * uart_serial_get_line(k_timeout_t timeout)
 	return &line;
 }
 
+serial_line_t const * uart_serial_get_chunk(k_timeout_t timeout)
+{
+	static serial_line_t const line = { 0 };
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return &line;
+}
+
 serial_ret_code_t uart_serial_send(k_timeout_t timeout, char const * p_data, int len)
 {
 	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
@@ -432,4 +637,46 @@ serial_ret_code_t uart_serial_set_end_character_list(char const * p_list, int le
 	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
 	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
 }
+
+serial_ret_code_t uart_serial_set_delimiter(char const * p_delimiter, int len)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_set_max_line_length(int max_len)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_set_overflow_policy(serial_overflow_policy_t policy)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_get_overflow_stats(serial_overflow_stats_t * p_stats)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_set_flow_control(serial_flow_control_config_t const * p_config)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_set_framing(serial_framing_t framing)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
+
+serial_ret_code_t uart_serial_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	LOG_ERR("this module uses the async api (CONFIG_SERIAL=y,CONFIG_UART_ASYNC_API=y)");
+	return SERIAL_RET_CODE_ERROR_DEVICE_NOT_READY;
+}
 #endif
\ No newline at end of file
@@ -12,10 +12,18 @@ serial_ret_code_t uart_serial_remove_callback(serial_event_callback_t callback);
 serial_ret_code_t uart_serial_enable();
 serial_ret_code_t uart_serial_disable();
 serial_line_t const * uart_serial_get_line(k_timeout_t timeout);
+serial_line_t const * uart_serial_get_chunk(k_timeout_t timeout);
 serial_ret_code_t uart_serial_send(k_timeout_t timeout, char const * p_data, int len);
 serial_ret_code_t uart_serial_vsendf(k_timeout_t timeout, const char * format, va_list args);
 serial_ret_code_t uart_serial_sendf(k_timeout_t timeout, char const * format, ...);
 serial_ret_code_t uart_serial_set_end_character_list(char const * p_list, int len);
+serial_ret_code_t uart_serial_set_delimiter(char const * p_delimiter, int len);
+serial_ret_code_t uart_serial_set_max_line_length(int max_len);
+serial_ret_code_t uart_serial_set_overflow_policy(serial_overflow_policy_t policy);
+serial_ret_code_t uart_serial_get_overflow_stats(serial_overflow_stats_t * p_stats);
+serial_ret_code_t uart_serial_set_flow_control(serial_flow_control_config_t const * p_config);
+serial_ret_code_t uart_serial_set_framing(serial_framing_t framing);
+serial_ret_code_t uart_serial_send_frame(k_timeout_t timeout, char const * p_data, int len);
 
 
 #endif  /* _ UART_SERIAL_H_ */
\ No newline at end of file
@@ -0,0 +1,21 @@
+# Encodes records with tools/helios_ble_codec.py and checks that helios_ble.c decodes and encodes them the same way.
+# cmake -DPYTHON=<python3> -DCODEC=<helios_ble_codec.py> -DTEST=<helios_ble_test> -P helios_ble_codec_check.cmake
+set(RECORD_SETS
+	"3:7:3:1:2:1000000 4:2:2:0:2:1000250"
+	"0:0:0:4:1:0"
+	"1:65535:3:5:255:-1 2:1:2:2:255:-1000000 3:2:1:3:255:4611686018427387903 4:3:0:0:255:-4611686018427387904"
+	"10:100:3:2:16:123456789012 11:101:3:2:16:123456789000 12:102:3:2:16:123456789012 13:103:2:2:16:123456790000"
+)
+
+foreach(RECORDS IN LISTS RECORD_SETS)
+	separate_arguments(RECORD_LIST UNIX_COMMAND "${RECORDS}")
+	execute_process(COMMAND ${PYTHON} ${CODEC} encode ${RECORD_LIST}
+		OUTPUT_VARIABLE PAYLOAD OUTPUT_STRIP_TRAILING_WHITESPACE RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "helios_ble_codec.py encode ${RECORDS} failed")
+	endif()
+	execute_process(COMMAND ${TEST} ${PAYLOAD} ${RECORD_LIST} OUTPUT_VARIABLE OUTPUT RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "${PAYLOAD} of ${RECORDS}:\n${OUTPUT}")
+	endif()
+endforeach()
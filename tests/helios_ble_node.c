@@ -0,0 +1,192 @@
+// helios_ble.c keeps its state in static variables, so it is built once per node of the simulated network. The radio
+// and the kernel functions it uses are replaced by the functions below before it is included.
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+// the public functions of every node get its number, the declarations in helios_ble.h as well
+#define sem_data_received CONCAT(sem_data_received_, NODE)
+#define helios_ble_enable CONCAT(helios_ble_enable_, NODE)
+#define helios_ble_send CONCAT(helios_ble_send_, NODE)
+#define helios_ble_send_batch CONCAT(helios_ble_send_batch_, NODE)
+#define helios_ble_receive CONCAT(helios_ble_receive_, NODE)
+#define helios_ble_receive_batch CONCAT(helios_ble_receive_batch_, NODE)
+#define helios_ble_get_rx_dropped CONCAT(helios_ble_get_rx_dropped_, NODE)
+#define helios_ble_get_scan_stats CONCAT(helios_ble_get_scan_stats_, NODE)
+#define helios_ble_set_accept_list CONCAT(helios_ble_set_accept_list_, NODE)
+#define helios_ble_network_time_now CONCAT(helios_ble_network_time_now_, NODE)
+#define helios_ble_node_count CONCAT(helios_ble_node_count_, NODE)
+#define helios_ble_node_next CONCAT(helios_ble_node_next_, NODE)
+#define helios_ble_get_relay_stats CONCAT(helios_ble_get_relay_stats_, NODE)
+#define helios_ble_get_scan_status CONCAT(helios_ble_get_scan_status_, NODE)
+
+#include "helios_ble_sim.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define NODE_WORK_COUNT 4
+#define NODE_ADVERT_MAX 255
+
+struct bt_le_ext_adv
+{
+	int set;
+};
+
+typedef struct node_work_s
+{
+	struct k_work_delayable * p_work;
+	int64_t due_ms;                   // -1 while the work is not scheduled
+} node_work_t;
+
+static node_work_t works[NODE_WORK_COUNT];
+static int work_count;
+static struct bt_le_ext_adv sets[SIM_SET_COUNT];
+static struct bt_le_ext_adv_cb const * set_callbacks[SIM_SET_COUNT];
+static int set_count;
+static bt_le_scan_cb_t * p_scan_callback;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static int64_t node_uptime_get(void)
+{
+	return sim_now_ms();
+}
+
+static node_work_t * node_find_work(struct k_work_delayable * p_work)
+{
+	for (int i = 0; i < work_count; i++)
+	{
+		if (works[i].p_work == p_work) return &works[i];
+	}
+	return NULL;
+}
+
+static void node_work_init_delayable(struct k_work_delayable * p_work, k_work_handler_t handler)
+{
+	p_work->work.h = handler;
+	node_work_t * p_entry = node_find_work(p_work);
+	if (p_entry == NULL && work_count < NODE_WORK_COUNT) p_entry = &works[work_count++];
+	if (p_entry == NULL) return;
+	p_entry->p_work = p_work;
+	p_entry->due_ms = -1;
+}
+
+// like in the kernel, work that is already scheduled keeps its time
+static int node_work_schedule(struct k_work_delayable * p_work, k_timeout_t delay)
+{
+	node_work_t * p_entry = node_find_work(p_work);
+	if (p_entry == NULL || p_entry->due_ms >= 0) return 0;
+	p_entry->due_ms = sim_now_ms() + delay.t;
+	return 1;
+}
+
+static int node_work_reschedule(struct k_work_delayable * p_work, k_timeout_t delay)
+{
+	node_work_t * p_entry = node_find_work(p_work);
+	if (p_entry == NULL) return -EINVAL;
+	p_entry->due_ms = sim_now_ms() + delay.t;
+	return 1;
+}
+
+static int node_ext_adv_create(struct bt_le_adv_param const * p_param, struct bt_le_ext_adv_cb const * p_cb,
+	struct bt_le_ext_adv ** pp_adv)
+{
+	if (set_count == SIM_SET_COUNT) return -ENOMEM;
+	sets[set_count].set = set_count;
+	set_callbacks[set_count] = p_cb;
+	*pp_adv = &sets[set_count++];
+	return 0;
+}
+
+// the advert is handed over as AD structures, the way the scanner of the receivers gets it
+static int node_ext_adv_set_data(struct bt_le_ext_adv * p_adv, struct bt_data const * p_ad, size_t ad_len,
+	struct bt_data const * p_sd, size_t sd_len)
+{
+	uint8_t advert[NODE_ADVERT_MAX];
+	int len = 0;
+	for (size_t i = 0; i < ad_len; i++)
+	{
+		if (len + 2 + p_ad[i].data_len > sizeof(advert)) return -EINVAL;
+		advert[len++] = p_ad[i].data_len + 1;
+		advert[len++] = p_ad[i].type;
+		memcpy(advert + len, p_ad[i].data, p_ad[i].data_len);
+		len += p_ad[i].data_len;
+	}
+	sim_set_data(NODE, p_adv->set, advert, len);
+	return 0;
+}
+
+static int node_ext_adv_start(struct bt_le_ext_adv * p_adv, struct bt_le_ext_adv_start_param * p_param)
+{
+	sim_start(NODE, p_adv->set, p_param->num_events);
+	return 0;
+}
+
+static int node_scan_start(struct bt_le_scan_param const * p_param, bt_le_scan_cb_t callback)
+{
+	p_scan_callback = callback;
+	return 0;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define k_uptime_get node_uptime_get
+#define k_uptime_ticks node_uptime_get      // the stubs count ticks in ms
+#define k_work_init_delayable node_work_init_delayable
+#define k_work_schedule node_work_schedule
+#define k_work_reschedule node_work_reschedule
+#define sys_rand32_get sim_rand32
+#define bt_le_ext_adv_create node_ext_adv_create
+#define bt_le_ext_adv_set_data node_ext_adv_set_data
+#define bt_le_ext_adv_start node_ext_adv_start
+#define bt_le_scan_start node_scan_start
+#include "helios_ble.c"
+
+// the address of a sender is its node number
+static void node_advert(int sender, int8_t rssi, uint8_t const * p_data, int len)
+{
+	bt_addr_le_t const addr = { .a = { .val = { sender } } };
+	uint8_t advert[NODE_ADVERT_MAX];
+	memcpy(advert, p_data, len);
+	struct net_buf_simple buf = { .data = advert, .len = len, .size = sizeof(advert) };
+	if (p_scan_callback != NULL) p_scan_callback(&addr, rssi, 0, &buf);
+}
+
+static void node_sent(int set)
+{
+	struct bt_le_ext_adv_sent_info info = { .num_sent = 0 };
+	if (set_callbacks[set] != NULL && set_callbacks[set]->sent != NULL) set_callbacks[set]->sent(&sets[set], &info);
+}
+
+static void node_run(void)
+{
+	for (int i = 0; i < work_count; i++)
+	{
+		if (works[i].due_ms < 0 || works[i].due_ms > sim_now_ms()) continue;
+		works[i].due_ms = -1;
+		works[i].p_work->work.h(&works[i].p_work->work);
+	}
+}
+
+static bool node_last_message(uint8_t node_id, uint16_t * p_seq, uint8_t * p_hops)
+{
+	node_entry_t const * p_entry = &node_table[node_id];
+	if (!p_entry->active) return false;
+	*p_seq = p_entry->seq;
+	*p_hops = p_entry->node.hops;
+	return true;
+}
+
+helios_ble_sim_node_t const CONCAT(helios_ble_sim_node_, NODE) = {
+	.enable = helios_ble_enable,
+	.send = helios_ble_send,
+	.receive_batch = helios_ble_receive_batch,
+	.get_relay_stats = helios_ble_get_relay_stats,
+	.advert = node_advert,
+	.sent = node_sent,
+	.run = node_run,
+	.last_message = node_last_message,
+};
@@ -0,0 +1,41 @@
+#ifndef HELIOS_BLE_SIM_H_
+#define HELIOS_BLE_SIM_H_
+
+#include "helios_ble.h"
+
+#define SIM_NODE_COUNT 10            // nodes built by helios_ble_node.c, NODE from 0 to SIM_NODE_COUNT - 1
+#define SIM_SET_MAIN 0               // advertising sets in the order helios_ble_enable() creates them
+#define SIM_SET_RELAY 1
+#define SIM_SET_COUNT 2
+
+// one node of the simulated network, helios_ble.c built by helios_ble_node.c
+typedef struct helios_ble_sim_node_s
+{
+	helios_ble_return_code_t (*enable)(void);
+	helios_ble_return_code_t (*send)(helios_ble_data_t const * p_data);
+	int (*receive_batch)(helios_ble_record_t * p_records, int max_count, k_timeout_t timeout);
+	void (*get_relay_stats)(helios_ble_relay_stats_t * p_stats);
+	void (*advert)(int sender, int8_t rssi, uint8_t const * p_data, int len);   // an advert reached the scanner
+	void (*sent)(int set);           // the events the set was started for are over
+	void (*run)(void);               // runs the work items that are due
+	bool (*last_message)(uint8_t node_id, uint16_t * p_seq, uint8_t * p_hops);  // from the node table
+} helios_ble_sim_node_t;
+
+extern helios_ble_sim_node_t const helios_ble_sim_node_0;
+extern helios_ble_sim_node_t const helios_ble_sim_node_1;
+extern helios_ble_sim_node_t const helios_ble_sim_node_2;
+extern helios_ble_sim_node_t const helios_ble_sim_node_3;
+extern helios_ble_sim_node_t const helios_ble_sim_node_4;
+extern helios_ble_sim_node_t const helios_ble_sim_node_5;
+extern helios_ble_sim_node_t const helios_ble_sim_node_6;
+extern helios_ble_sim_node_t const helios_ble_sim_node_7;
+extern helios_ble_sim_node_t const helios_ble_sim_node_8;
+extern helios_ble_sim_node_t const helios_ble_sim_node_9;
+
+// provided by the test, which simulates the radio between the nodes
+int64_t sim_now_ms(void);
+uint32_t sim_rand32(void);
+void sim_set_data(int node, int set, uint8_t const * p_data, int len);
+void sim_start(int node, int set, int num_events);   // 0 events run until the node is reset
+
+#endif  /* _ HELIOS_BLE_SIM_H_ */
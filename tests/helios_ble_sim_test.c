@@ -0,0 +1,281 @@
+#include "helios_ble_sim.h"
+
+#include <stdlib.h>
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+// two nodes per column, a node hears the nodes of its own and of the neighboring columns
+#define COLUMN_COUNT (SIM_NODE_COUNT / 2)
+#define HOP_COUNT (COLUMN_COUNT - 2)  // relays between the first and the last column
+#define ADVERT_MAX 255
+#define ADV_DELAY_MAX_MS 10          // random delay the controller adds to every advertising event
+#define RELAY_INTERVAL_MS 20         // RELAY_ADV_INTERVAL of helios_ble.c
+#define TX_DURATION_MS 2             // of the payload on a secondary channel, the primary channel part is left out
+#define SECONDARY_CHANNEL_COUNT 37   // the payload of every event goes out on a random one of them
+#define TRANSMISSION_COUNT 64        // more than go on air during two TX_DURATION_MS
+#define SEND_INTERVAL_MS 500         // every node sends a message of its own at this interval
+#define MESSAGE_MAX 256              // per node over all phases
+#define SETTLE_MS 2000               // after the last message of a phase
+
+typedef struct radio_set_s
+{
+	uint8_t data[ADVERT_MAX];
+	int len;
+	bool running;
+	int events_left;                 // 0 runs until the node is reset
+	int64_t next_ms;
+} radio_set_t;
+
+typedef struct transmission_s
+{
+	int node;
+	int channel;
+	int64_t start_ms;
+	int len;
+	uint8_t data[ADVERT_MAX];
+} transmission_t;
+
+// messages of all origins to all receivers that are this many relays apart
+typedef struct hop_result_s
+{
+	int expected;
+	int delivered;
+	int64_t latency_sum_ms;
+	int64_t latency_max_ms;
+} hop_result_t;
+
+static helios_ble_sim_node_t const * const nodes[SIM_NODE_COUNT] = {
+	&helios_ble_sim_node_0, &helios_ble_sim_node_1, &helios_ble_sim_node_2, &helios_ble_sim_node_3,
+	&helios_ble_sim_node_4, &helios_ble_sim_node_5, &helios_ble_sim_node_6, &helios_ble_sim_node_7,
+	&helios_ble_sim_node_8, &helios_ble_sim_node_9,
+};
+static int64_t now_ms;
+static uint32_t random_state = 1;
+static int loss_percent;
+static radio_set_t radio_sets[SIM_NODE_COUNT][SIM_SET_COUNT];
+static transmission_t transmissions[TRANSMISSION_COUNT];
+static int transmission_index;
+
+static int sent_count[SIM_NODE_COUNT];       // own_seq of the node, its messages count from 1
+static int64_t sent_ms[SIM_NODE_COUNT][MESSAGE_MAX + 1];
+static int phase_first_seq;                  // every node sent as many, earlier ones belong to an earlier phase
+static uint16_t last_seq[SIM_NODE_COUNT][SIM_NODE_COUNT];   // [receiver][origin]
+static hop_result_t results[HOP_COUNT + 1];
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+int64_t sim_now_ms(void)
+{
+	return now_ms;
+}
+
+// xorshift, the same sequence for every run
+uint32_t sim_rand32(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+void sim_set_data(int node, int set, uint8_t const * p_data, int len)
+{
+	memcpy(radio_sets[node][set].data, p_data, len);
+	radio_sets[node][set].len = len;
+}
+
+void sim_start(int node, int set, int num_events)
+{
+	radio_set_t * p_set = &radio_sets[node][set];
+	p_set->running = true;
+	p_set->events_left = num_events;
+	p_set->next_ms = now_ms + sim_rand32() % (ADV_DELAY_MAX_MS + 1);
+}
+
+static int column(int node)
+{
+	return node / 2;
+}
+
+static bool in_range(int a, int b)
+{
+	return abs(column(a) - column(b)) <= 1;
+}
+
+// relays needed between the nodes, 0 if they hear each other
+static int hop_distance(int a, int b)
+{
+	int const columns = abs(column(a) - column(b));
+	return (columns > 0) ? (columns - 1) : 0;
+}
+
+// the receiver gets the advert unless it is lost, the receiver was sending itself or another advert in its range
+// overlapped it on the same channel
+static void deliver(transmission_t const * p_transmission)
+{
+	for (int receiver = 0; receiver < SIM_NODE_COUNT; receiver++)
+	{
+		if (receiver == p_transmission->node || !in_range(receiver, p_transmission->node)) continue;
+		if (sim_rand32() % 100 < loss_percent) continue;
+		bool collision = false;
+		for (int i = 0; i < TRANSMISSION_COUNT && !collision; i++)
+		{
+			transmission_t const * p_other = &transmissions[i];
+			if (p_other == p_transmission || p_other->len == 0) continue;
+			if (llabs(p_other->start_ms - p_transmission->start_ms) >= TX_DURATION_MS) continue;
+			collision = (p_other->node == receiver) ||
+				(p_other->channel == p_transmission->channel && in_range(receiver, p_other->node));
+		}
+		if (!collision) nodes[receiver]->advert(p_transmission->node, -60, p_transmission->data, p_transmission->len);
+	}
+}
+
+static void check_deliveries(int receiver)
+{
+	helios_ble_record_t records[8];
+	while (nodes[receiver]->receive_batch(records, ARRAY_SIZE(records), K_NO_WAIT) > 0)
+	{
+	}
+	for (int origin = 0; origin < SIM_NODE_COUNT; origin++)
+	{
+		uint16_t seq;
+		uint8_t hops;
+		if (origin == receiver || !nodes[receiver]->last_message(origin, &seq, &hops)) continue;
+		if (seq == last_seq[receiver][origin]) continue;
+		last_seq[receiver][origin] = seq;
+		if (seq < phase_first_seq || seq > sent_count[origin]) continue;
+
+		int const distance = hop_distance(origin, receiver);
+		TEST_CHECK(hops >= distance && hops <= HELIOS_BLE_RELAY_TTL, "%d from %d: %d hops over a distance of %d",
+			receiver, origin, hops, distance);
+		int64_t const latency_ms = now_ms - sent_ms[origin][seq];
+		results[distance].delivered++;
+		results[distance].latency_sum_ms += latency_ms;
+		if (latency_ms > results[distance].latency_max_ms) results[distance].latency_max_ms = latency_ms;
+	}
+}
+
+static void sim_step(void)
+{
+	now_ms++;
+	for (int node = 0; node < SIM_NODE_COUNT; node++)
+	{
+		for (int set = 0; set < SIM_SET_COUNT; set++)
+		{
+			radio_set_t * p_set = &radio_sets[node][set];
+			if (!p_set->running || p_set->next_ms > now_ms) continue;
+
+			transmission_t * p_transmission = &transmissions[transmission_index];
+			transmission_index = (transmission_index + 1) % TRANSMISSION_COUNT;
+			p_transmission->node = node;
+			p_transmission->channel = sim_rand32() % SECONDARY_CHANNEL_COUNT;
+			p_transmission->start_ms = now_ms;
+			p_transmission->len = p_set->len;
+			memcpy(p_transmission->data, p_set->data, p_set->len);
+
+			int const interval_ms = (set == SIM_SET_MAIN) ? HELIOS_BLE_ADV_INTERVAL_MS : RELAY_INTERVAL_MS;
+			p_set->next_ms = now_ms + interval_ms + sim_rand32() % (ADV_DELAY_MAX_MS + 1);
+			if (p_set->events_left > 0 && --p_set->events_left == 0)
+			{
+				p_set->running = false;
+				nodes[node]->sent(set);
+			}
+		}
+	}
+	for (int i = 0; i < TRANSMISSION_COUNT; i++)
+	{
+		if (transmissions[i].len > 0 && transmissions[i].start_ms == now_ms - TX_DURATION_MS) deliver(&transmissions[i]);
+	}
+	for (int node = 0; node < SIM_NODE_COUNT; node++)
+	{
+		nodes[node]->run();
+	}
+	for (int node = 0; node < SIM_NODE_COUNT; node++)
+	{
+		check_deliveries(node);
+	}
+}
+
+// every node sends its messages with its own phase, then the network settles
+static void sim_phase(int messages, int phase_loss_percent)
+{
+	loss_percent = phase_loss_percent;
+	phase_first_seq = sent_count[0] + 1;
+	memset(results, 0, sizeof(results));
+	int64_t const start_ms = now_ms;
+	int64_t const end_ms = start_ms + (int64_t)messages * SEND_INTERVAL_MS;
+	while (now_ms < end_ms + SETTLE_MS)
+	{
+		for (int node = 0; node < SIM_NODE_COUNT; node++)
+		{
+			int64_t const phase_ms = (int64_t)node * SEND_INTERVAL_MS / SIM_NODE_COUNT;
+			if (now_ms >= end_ms || (now_ms - start_ms) % SEND_INTERVAL_MS != phase_ms) continue;
+			helios_ble_data_t const data = { .node_id = node, .pattern = PATTERN_SYNC, .node_count = SIM_NODE_COUNT };
+			if (sent_count[node] == MESSAGE_MAX) continue;
+			TEST_CHECK(nodes[node]->send(&data) == HELIOS_BLE_RETURN_CODE_SUCCESS, "node %d sent", node);
+			sent_ms[node][++sent_count[node]] = now_ms;
+		}
+		sim_step();
+	}
+	for (int origin = 0; origin < SIM_NODE_COUNT; origin++)
+	{
+		for (int receiver = 0; receiver < SIM_NODE_COUNT; receiver++)
+		{
+			if (receiver != origin) results[hop_distance(origin, receiver)].expected += messages;
+		}
+	}
+}
+
+// all nodes reach each other within HELIOS_BLE_RELAY_TTL relays. The origin needs up to one advertising event, every
+// relay adds its backoff and its relay events.
+static void check_results(char const * p_test, int min_percent)
+{
+	helios_ble_relay_stats_t relay_total = { 0 };
+	for (int node = 0; node < SIM_NODE_COUNT; node++)
+	{
+		helios_ble_relay_stats_t stats;
+		nodes[node]->get_relay_stats(&stats);
+		relay_total.sent += stats.sent;
+		relay_total.suppressed += stats.suppressed;
+	}
+	printf("%s: %d nodes, relays sent %u, suppressed %u (totals since the start)\n", p_test, SIM_NODE_COUNT,
+		relay_total.sent, relay_total.suppressed);
+
+	int64_t last_average_ms = 0;
+	for (int hops = 0; hops <= HOP_COUNT; hops++)
+	{
+		hop_result_t const * p_result = &results[hops];
+		int const percent = p_result->delivered * 100 / p_result->expected;
+		int64_t const average_ms = (p_result->delivered > 0) ? (p_result->latency_sum_ms / p_result->delivered) : 0;
+		printf("  %d hops: %5d of %5d delivered (%3d%%), latency average %4lld ms, max %4lld ms\n", hops,
+			p_result->delivered, p_result->expected, percent, (long long)average_ms, (long long)p_result->latency_max_ms);
+
+		TEST_CHECK(percent >= min_percent, "%s: %d%% delivered over %d hops", p_test, percent, hops);
+		int64_t const relay_ms = HELIOS_BLE_RELAY_BACKOFF_MAX_MS + HELIOS_BLE_RELAY_EVENTS * (RELAY_INTERVAL_MS + ADV_DELAY_MAX_MS);
+		int64_t const bound_ms = HELIOS_BLE_ADV_INTERVAL_MS + ADV_DELAY_MAX_MS + hops * relay_ms;
+		TEST_CHECK(average_ms <= bound_ms, "%s: average latency %lld ms over %d hops, bound %lld ms", p_test,
+			(long long)average_ms, hops, (long long)bound_ms);
+		TEST_CHECK(hops == 0 || average_ms > last_average_ms, "%s: latency grows with the hops", p_test);
+		last_average_ms = average_ms;
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+int main(void)
+{
+	for (int node = 0; node < SIM_NODE_COUNT; node++)
+	{
+		TEST_CHECK(nodes[node]->enable() == HELIOS_BLE_RETURN_CODE_SUCCESS, "node %d enabled", node);
+	}
+
+	sim_phase(60, 0);
+	check_results("lossless", 90);
+	sim_phase(60, 20);
+	check_results("20% loss", 85);
+	return TEST_RESULT();
+}
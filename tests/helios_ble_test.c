@@ -0,0 +1,272 @@
+// the wire codec and the relay bookkeeping of helios_ble.c are static, so the test is built as part of it
+#include "helios_ble.c"
+
+#include <stdlib.h>
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define PAYLOAD_MAX 240
+
+// example of tools/helios_ble_codec.py: 3:7:3:1:2:1000000 4:2:2:0:2:1000250
+static char const example_hex[] = "ffff01d7a603070003010280897a040200020002f403";
+static message_t const example_messages[] = {
+	{ .seq = 7, .ttl = 3, .data = { .node_id = 3, .pattern = PATTERN_PRECEDE, .node_count = 2, .network_time = 1000000 } },
+	{ .seq = 2, .ttl = 2, .data = { .node_id = 4, .pattern = PATTERN_TRAIL, .node_count = 2, .network_time = 1000250 } },
+};
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static int hex_to_bytes(char const * p_hex, uint8_t * p_out, int size)
+{
+	int len = 0;
+	while (p_hex[0] != '\0' && p_hex[1] != '\0' && len < size)
+	{
+		char const byte[3] = { p_hex[0], p_hex[1], '\0' };
+		p_out[len++] = (uint8_t)strtoul(byte, NULL, 16);
+		p_hex += 2;
+	}
+	return len;
+}
+
+static bool message_equal(message_t const * p_a, message_t const * p_b)
+{
+	return p_a->seq == p_b->seq && p_a->ttl == p_b->ttl && p_a->data.node_id == p_b->data.node_id &&
+		p_a->data.pattern == p_b->data.pattern && p_a->data.node_count == p_b->data.node_count &&
+		p_a->data.network_time == p_b->data.network_time;
+}
+
+// the first record carries its network time, the others are relative to it like in helios_ble_send_batch()
+static int encode_messages(message_t const * p_messages, int count, uint8_t * p_payload, int size)
+{
+	int len = wire_encode_header(p_payload);
+	for (int i = 0; i < count && len >= 0; i++)
+	{
+		len = wire_encode_message(p_payload, len, size, &p_messages[i], (i == 0) ? 0 : p_messages[0].data.network_time);
+	}
+	return len;
+}
+
+// decodes the payload and compares it to the messages, then encodes the messages and compares them to the payload
+static void check_payload(uint8_t const * p_payload, int len, message_t const * p_messages, int count, char const * p_name)
+{
+	struct net_buf_simple buf;
+	uint8_t advert[2 + PAYLOAD_MAX];
+	advert[0] = len + 1;
+	advert[1] = BT_DATA_MANUFACTURER_DATA;
+	memcpy(advert + 2, p_payload, len);
+	buf.data = advert;
+	buf.len = len + 2;
+	int payload_len;
+	TEST_CHECK(find_payload(&buf, &payload_len) == advert + 2 && payload_len == len, "%s: payload found", p_name);
+
+	message_t message;
+	int64_t base_time = 0;
+	int offset = WIRE_HEADER_LEN;
+	int decoded = 0;
+	while (wire_decode_message(p_payload, len, &offset, &message, &base_time))
+	{
+		TEST_CHECK(decoded < count && message_equal(&message, &p_messages[decoded]), "%s: record %d", p_name, decoded);
+		decoded++;
+	}
+	TEST_CHECK(decoded == count && offset == len, "%s: %d of %d records decoded", p_name, decoded, count);
+
+	uint8_t encoded[PAYLOAD_MAX];
+	int const encoded_len = encode_messages(p_messages, count, encoded, sizeof(encoded));
+	TEST_CHECK(encoded_len == len && memcmp(encoded, p_payload, len) == 0, "%s: encoded payload", p_name);
+}
+
+static void test_example(void)
+{
+	uint8_t payload[PAYLOAD_MAX];
+	int const len = hex_to_bytes(example_hex, payload, sizeof(payload));
+	TEST_CHECK(wire_network_hash() == 0xa6d7, "network hash 0x%04x", wire_network_hash());
+	check_payload(payload, len, example_messages, ARRAY_SIZE(example_messages), "codec example");
+}
+
+static void test_round_trip(void)
+{
+	// times around 0, both signs of the delta and the limits of the varint, the deltas of neighbors fit into 64 bit
+	int64_t const times[] = { 0, 1, -1, 63, 64, -64, -65, 1000000, INT32_MAX, INT64_MAX / 2, INT64_MIN / 2, 0, INT64_MAX, 0,
+		INT64_MIN };
+	message_t messages[ARRAY_SIZE(times)];
+	for (int i = 0; i < ARRAY_SIZE(times); i++)
+	{
+		messages[i] = (message_t) { .seq = 0xFFFF - i, .ttl = i & 3, .data = { .node_id = 200 + i,
+			.pattern = PATTERN_KNIGHT_RIDER, .node_count = 255, .network_time = times[i] } };
+	}
+	for (int first = 0; first < ARRAY_SIZE(times) - 1; first++)
+	{
+		uint8_t payload[PAYLOAD_MAX];
+		message_t batch[2] = { messages[first], messages[first + 1] };
+		int const len = encode_messages(batch, 2, payload, sizeof(payload));
+		TEST_CHECK(len > 0, "round trip %d encoded", first);
+		if (len > 0) check_payload(payload, len, batch, 2, "round trip");
+	}
+}
+
+static void test_limits(void)
+{
+	uint8_t payload[PAYLOAD_MAX];
+	int const len = encode_messages(example_messages, ARRAY_SIZE(example_messages), payload, sizeof(payload));
+	TEST_CHECK(encode_messages(example_messages, ARRAY_SIZE(example_messages), payload, len - 1) == -1,
+		"record that does not fit");
+
+	message_t message;
+	int64_t base_time = 0;
+	int offset = WIRE_HEADER_LEN;
+	TEST_CHECK(wire_decode_message(payload, len, &offset, &message, &base_time), "first record");
+	TEST_CHECK(!wire_decode_message(payload, len - 1, &offset, &message, &base_time), "truncated varint");
+
+	// other versions and networks are ignored
+	struct net_buf_simple buf;
+	uint8_t advert[2 + PAYLOAD_MAX] = { len + 1, BT_DATA_MANUFACTURER_DATA };
+	memcpy(advert + 2, payload, len);
+	buf.data = advert;
+	buf.len = len + 2;
+	int payload_len;
+	advert[2 + 2] = WIRE_VERSION + 1;
+	TEST_CHECK(find_payload(&buf, &payload_len) == NULL, "other version");
+	advert[2 + 2] = WIRE_VERSION;
+	advert[2 + 3] ^= 0x01;
+	TEST_CHECK(find_payload(&buf, &payload_len) == NULL, "other network");
+	advert[0] = len + 2;
+	TEST_CHECK(find_payload(&buf, &payload_len) == NULL, "field longer than the advert");
+}
+
+// receives a message that is not used for the time, returns true if it went into the receive queue
+static bool receive(uint8_t node_id, uint16_t seq, uint8_t ttl)
+{
+	static bt_addr_le_t const addr = { 0 };
+	message_t const message = { .seq = seq, .ttl = ttl, .data = { .node_id = node_id, .pattern = PATTERN_SYNC } };
+	uint32_t const accepted = scan_stats.accepted;
+	receive_message(&addr, -60, &message, 0, false);
+	// the test does not read the receive queue
+	atomic_set(&rx_tail, atomic_get(&rx_head));
+	return scan_stats.accepted != accepted;
+}
+
+static relay_entry_t const * find_relay(uint8_t node_id, uint16_t seq)
+{
+	for (int i = 0; i < HELIOS_BLE_RELAY_QUEUE_SIZE; i++)
+	{
+		relay_entry_t const * p_entry = &relay_queue[i];
+		if (p_entry->used && p_entry->message.data.node_id == node_id && p_entry->message.seq == seq) return p_entry;
+	}
+	return NULL;
+}
+
+static void test_duplicates(void)
+{
+	uint8_t const node_id = 5;
+	TEST_CHECK(receive(node_id, 100, HELIOS_BLE_RELAY_TTL), "first message");
+	TEST_CHECK(!receive(node_id, 100, HELIOS_BLE_RELAY_TTL), "repeated message");
+	TEST_CHECK(!receive(node_id, 100, HELIOS_BLE_RELAY_TTL - 1), "relayed copy of the last message");
+	TEST_CHECK(!receive(node_id, 100 - SEQ_DUPLICATE_WINDOW, HELIOS_BLE_RELAY_TTL - 1), "relayed copy within the window");
+	TEST_CHECK(receive(node_id, 101, HELIOS_BLE_RELAY_TTL - 1), "relayed new message");
+	TEST_CHECK(scan_stats.missed == 0, "no gap in the sequence");
+	TEST_CHECK(receive(node_id, 103, HELIOS_BLE_RELAY_TTL), "message after a gap");
+	TEST_CHECK(scan_stats.missed == 1, "one missed message");
+	// relayed copies further back than the window come from a node that restarted its sequence
+	TEST_CHECK(receive(node_id, 103 - SEQ_DUPLICATE_WINDOW - 1, HELIOS_BLE_RELAY_TTL - 1), "relayed copy behind the window");
+
+	// a node that restarts sends its own messages from sequence number 1 again
+	uint8_t const restarted_id = 6;
+	TEST_CHECK(receive(restarted_id, 20, HELIOS_BLE_RELAY_TTL), "message before the restart");
+	TEST_CHECK(receive(restarted_id, 1, HELIOS_BLE_RELAY_TTL), "first message after the restart");
+	TEST_CHECK(!receive(restarted_id, 1, HELIOS_BLE_RELAY_TTL), "repeated message after the restart");
+	TEST_CHECK(receive(restarted_id, 2, HELIOS_BLE_RELAY_TTL), "second message after the restart");
+}
+
+static void test_relay_suppression(void)
+{
+	uint8_t const node_id = 7;
+	uint16_t const seq = 500;
+	uint32_t const suppressed = relay_stats.suppressed;
+	TEST_CHECK(receive(node_id, seq, HELIOS_BLE_RELAY_TTL), "message to relay");
+	relay_entry_t const * p_entry = find_relay(node_id, seq);
+	TEST_CHECK(p_entry != NULL && p_entry->message.ttl == HELIOS_BLE_RELAY_TTL - 1, "queued with the ttl decremented");
+	if (p_entry == NULL) return;
+
+	// the origin repeats its advert until it is replaced, that is not a copy of another relay
+	for (int i = 0; i < 2 * HELIOS_BLE_RELAY_SUPPRESS_COUNT; i++) receive(node_id, seq, HELIOS_BLE_RELAY_TTL);
+	TEST_CHECK(p_entry->used && p_entry->heard == 0, "repeats of the origin do not suppress");
+	for (int i = 0; i < HELIOS_BLE_RELAY_SUPPRESS_COUNT - 1; i++) receive(node_id, seq, HELIOS_BLE_RELAY_TTL - 1);
+	TEST_CHECK(p_entry->used, "fewer relayed copies than HELIOS_BLE_RELAY_SUPPRESS_COUNT");
+	receive(node_id, seq, HELIOS_BLE_RELAY_TTL - 2);
+	TEST_CHECK(!p_entry->used && relay_stats.suppressed == suppressed + 1, "suppressed by relayed copies");
+
+	TEST_CHECK(receive(node_id, seq + 1, 0), "message without ttl");
+	TEST_CHECK(find_relay(node_id, seq + 1) == NULL, "message without ttl is not relayed");
+}
+
+// at a reduced scan duty a node is heard once per scan interval, only the intervals beyond that are lost
+static void test_loss_at_scan_level(void)
+{
+	static bt_addr_le_t const addr = { 0 };
+	helios_ble_data_t const data = { .node_id = 8, .pattern = PATTERN_SYNC };
+	node_entry_t const * p_entry = &node_table[data.node_id];
+	int const level = HELIOS_BLE_SCAN_MAX_LEVEL;
+	uint16_t seq = 1;
+	int64_t timestamp = 0;    // the stubs count ticks in ms
+
+	for (int i = 0; i < 32; i++, timestamp += SCAN_INTERVAL_MS(level))
+	{
+		node_update(&data, seq++, 0, &addr, -60, timestamp, level);
+	}
+	TEST_CHECK(p_entry->loss_q10 == 0, "perfect link at scan level %d, loss %d", level, p_entry->loss_q10);
+	node_update(&data, seq++, 0, &addr, -60, timestamp + SCAN_INTERVAL_MS(level), level);
+	TEST_CHECK(p_entry->loss_q10 > 0, "one scan interval missed, loss %d", p_entry->loss_q10);
+
+	// the gap across a change of the duty is left out
+	uint16_t const loss_q10 = p_entry->loss_q10;
+	timestamp += 4 * SCAN_INTERVAL_MS(level);
+	node_update(&data, seq++, 0, &addr, -60, timestamp, 0);
+	TEST_CHECK(p_entry->loss_q10 == loss_q10, "duty changed, loss %d", p_entry->loss_q10);
+	for (int i = 0; i < 8; i++) node_update(&data, seq++, 0, &addr, -60, timestamp += HELIOS_BLE_NODE_TX_INTERVAL_MS, 0);
+	TEST_CHECK(p_entry->loss_q10 < loss_q10, "perfect link at full duty, loss %d", p_entry->loss_q10);
+}
+
+// helios_ble_test HEX RECORD...: HEX has to decode to the records, NODE:SEQ:TTL:PATTERN:NODE_COUNT:NETWORK_TIME_US
+static void test_arguments(int argc, char ** argv)
+{
+	uint8_t payload[PAYLOAD_MAX];
+	message_t messages[HELIOS_BLE_BATCH_MAX_RECORDS];
+	int const len = hex_to_bytes(argv[1], payload, sizeof(payload));
+	int count = 0;
+	for (int i = 2; i < argc && count < ARRAY_SIZE(messages); i++)
+	{
+		unsigned int node_id, seq, ttl, pattern, node_count;
+		long long network_time;
+		if (sscanf(argv[i], "%u:%u:%u:%u:%u:%lld", &node_id, &seq, &ttl, &pattern, &node_count, &network_time) != 6)
+		{
+			TEST_CHECK(false, "record %s", argv[i]);
+			continue;
+		}
+		messages[count++] = (message_t) { .seq = seq, .ttl = ttl, .data = { .node_id = node_id, .pattern = pattern,
+			.node_count = node_count, .network_time = network_time } };
+	}
+	check_payload(payload, len, messages, count, "arguments");
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+int main(int argc, char ** argv)
+{
+	network_hash = wire_network_hash();
+	if (argc > 1)
+	{
+		test_arguments(argc, argv);
+		return TEST_RESULT();
+	}
+	test_example();
+	test_round_trip();
+	test_limits();
+	test_duplicates();
+	test_relay_suppression();
+	test_loss_at_scan_level();
+	return TEST_RESULT();
+}
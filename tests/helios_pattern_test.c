@@ -0,0 +1,131 @@
+#include "helios_pattern.h"
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+typedef struct golden_frame_s
+{
+	helios_ble_pattern_t pattern;
+	int64_t network_time_us;
+	uint8_t node_id;
+	uint8_t node_count;
+	uint8_t frame[HELIOS_PATTERN_CHANNELS];
+} golden_frame_t;
+
+// frames of the default configuration, a change of a pattern has to update them on purpose
+static golden_frame_t const golden_frames[] = {
+	{ PATTERN_TRAIL, 0, 0, 3, { 255,   0,   0,   0 } },
+	{ PATTERN_TRAIL, 0, 2, 3, {  13,  30,  64, 130 } },
+	{ PATTERN_TRAIL, 0, 5, 0, {  13,  30,  64, 130 } },
+	{ PATTERN_TRAIL, 125000, 0, 3, {  45,  91, 182,   0 } },
+	{ PATTERN_TRAIL, 125000, 2, 3, {   0,   2,   8,  21 } },
+	{ PATTERN_TRAIL, 125000, 5, 0, {   0,   2,   8,  21 } },
+	{ PATTERN_TRAIL, 1234567, 0, 3, { 160,   0,   0,   0 } },
+	{ PATTERN_TRAIL, 1234567, 2, 3, {   7,  18,  39,  80 } },
+	{ PATTERN_TRAIL, 1234567, 5, 0, {   7,  18,  39,  80 } },
+	{ PATTERN_TRAIL, -50000, 0, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_TRAIL, -50000, 2, 3, {  30,  64, 130, 255 } },
+	{ PATTERN_TRAIL, -50000, 5, 0, {  30,  64, 130, 255 } },
+	{ PATTERN_PRECEDE, 0, 0, 3, { 255, 130,  64,  30 } },
+	{ PATTERN_PRECEDE, 0, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, 0, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, 125000, 0, 3, {   0,   0,   0, 182 } },
+	{ PATTERN_PRECEDE, 125000, 2, 3, {   2,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, 125000, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, 1234567, 0, 3, {   0, 207, 104,  51 } },
+	{ PATTERN_PRECEDE, 1234567, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, 1234567, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_PRECEDE, -50000, 0, 3, { 130,  64,  30,  13 } },
+	{ PATTERN_PRECEDE, -50000, 2, 3, {   0,   0,   0, 255 } },
+	{ PATTERN_PRECEDE, -50000, 5, 0, {   0,   0,   0, 255 } },
+	{ PATTERN_SYNC, 0, 0, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_SYNC, 0, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_SYNC, 0, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_SYNC, 125000, 0, 3, {  10,  10,  10,  10 } },
+	{ PATTERN_SYNC, 125000, 2, 3, {  10,  10,  10,  10 } },
+	{ PATTERN_SYNC, 125000, 5, 0, {  10,  10,  10,  10 } },
+	{ PATTERN_SYNC, 1234567, 0, 3, { 222, 222, 222, 222 } },
+	{ PATTERN_SYNC, 1234567, 2, 3, { 222, 222, 222, 222 } },
+	{ PATTERN_SYNC, 1234567, 5, 0, { 222, 222, 222, 222 } },
+	{ PATTERN_SYNC, -50000, 0, 3, {   1,   1,   1,   1 } },
+	{ PATTERN_SYNC, -50000, 2, 3, {   1,   1,   1,   1 } },
+	{ PATTERN_SYNC, -50000, 5, 0, {   1,   1,   1,   1 } },
+	{ PATTERN_ON, 0, 0, 3, { 255, 255, 255, 255 } },
+	{ PATTERN_ON, 0, 2, 3, { 255, 255, 255, 255 } },
+	{ PATTERN_ON, 0, 5, 0, { 255, 255, 255, 255 } },
+	{ PATTERN_OFF, 0, 0, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_OFF, 0, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_OFF, 0, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 0, 0, 3, { 255,  30,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 0, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 0, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 125000, 0, 3, {   0,   8,  91,  91 } },
+	{ PATTERN_KNIGHT_RIDER, 125000, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 125000, 5, 0, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 1234567, 0, 3, {   0,   4,  61, 134 } },
+	{ PATTERN_KNIGHT_RIDER, 1234567, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, 1234567, 5, 0, {  14, 134,  61,   4 } },
+	{ PATTERN_KNIGHT_RIDER, -50000, 0, 3, {  30, 255,  30,   0 } },
+	{ PATTERN_KNIGHT_RIDER, -50000, 2, 3, {   0,   0,   0,   0 } },
+	{ PATTERN_KNIGHT_RIDER, -50000, 5, 0, {   0,   0,   0,   0 } },
+};
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void test_golden_frames(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(golden_frames); i++)
+	{
+		golden_frame_t const * p_golden = &golden_frames[i];
+		uint8_t frame[HELIOS_PATTERN_CHANNELS];
+		helios_pattern_render(p_golden->pattern, p_golden->network_time_us, p_golden->node_id, p_golden->node_count, frame);
+		TEST_CHECK(memcmp(frame, p_golden->frame, sizeof(frame)) == 0,
+			"pattern %d at %lld us on node %d of %d: %d %d %d %d", p_golden->pattern, (long long)p_golden->network_time_us,
+			p_golden->node_id, p_golden->node_count, frame[0], frame[1], frame[2], frame[3]);
+	}
+}
+
+// the patterns that move along the chain repeat after one pass, sync pulses the same on every node
+static void test_periodic(void)
+{
+	uint8_t const node_count = 3;
+	int64_t const pass_us = (int64_t)node_count * HELIOS_PATTERN_CHANNELS * HELIOS_PATTERN_STEP_US;
+	helios_ble_pattern_t const moving[] = { PATTERN_TRAIL, PATTERN_PRECEDE };
+	for (int p = 0; p < ARRAY_SIZE(moving); p++)
+	{
+		for (int64_t t = 0; t < pass_us; t += 7919)
+		{
+			uint8_t frame[HELIOS_PATTERN_CHANNELS];
+			uint8_t next_pass[HELIOS_PATTERN_CHANNELS];
+			helios_pattern_render(moving[p], t, 1, node_count, frame);
+			helios_pattern_render(moving[p], t + 5 * pass_us, 1, node_count, next_pass);
+			TEST_CHECK(memcmp(frame, next_pass, sizeof(frame)) == 0, "pattern %d repeats at %lld us", moving[p], (long long)t);
+		}
+	}
+	for (int64_t t = -HELIOS_PATTERN_SYNC_PERIOD_US; t < HELIOS_PATTERN_SYNC_PERIOD_US; t += 7919)
+	{
+		uint8_t first[HELIOS_PATTERN_CHANNELS];
+		uint8_t other[HELIOS_PATTERN_CHANNELS];
+		helios_pattern_render(PATTERN_SYNC, t, 0, node_count, first);
+		helios_pattern_render(PATTERN_SYNC, t, 7, 0, other);
+		TEST_CHECK(memcmp(first, other, sizeof(first)) == 0, "sync at %lld us", (long long)t);
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// helios_pattern_enable() is not tested, the frames are rendered with the network times of the test
+int64_t helios_ble_network_time_now(uint32_t * p_error_us)
+{
+	return 0;
+}
+
+int main(void)
+{
+	test_golden_frames();
+	test_periodic();
+	return TEST_RESULT();
+}
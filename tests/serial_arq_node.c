@@ -0,0 +1,203 @@
+// serial_arq.c keeps its state in static variables, so it is built once per node of the simulated link. The transport
+// and the kernel objects it uses are replaced by the functions below before it is included.
+#include <zephyr/kernel.h>
+
+#include "serial_arq_sim.h"
+#include "serial_internal.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+#define SERIAL_ARQ_RX_QUEUE_LENGTH 4
+#define NODE_MESSAGE_SIZE 256
+
+static bool claimed;
+static serial_event_callback_t callback;
+static struct k_work * p_submitted_work;
+static struct k_work_delayable * p_scheduled_work;
+static int64_t scheduled_us = -1;
+static char messages[SERIAL_ARQ_RX_QUEUE_LENGTH][NODE_MESSAGE_SIZE];
+static int message_read_index;
+static int message_count;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static serial_ret_code_t node_claim(serial_type_t type)
+{
+	if (claimed) return SERIAL_RET_CODE_ERROR_BUSY;
+	claimed = true;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+static serial_ret_code_t node_release(serial_type_t type)
+{
+	claimed = false;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+static serial_ret_code_t node_add_callback(serial_event_callback_t new_callback)
+{
+	callback = new_callback;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+static serial_ret_code_t node_remove_callback(serial_event_callback_t old_callback)
+{
+	callback = NULL;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+static serial_ret_code_t node_set_framing(serial_framing_t framing)
+{
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+static serial_line_t const * node_get_line(k_timeout_t timeout)
+{
+	return sim_get_line(NODE);
+}
+
+static serial_ret_code_t node_send_frame(k_timeout_t timeout, char const * p_data, int len)
+{
+	return sim_send_frame(NODE, p_data, len);
+}
+
+// nothing blocks in the simulation, a semaphore which is not available times out right away
+static int node_sem_init(struct k_sem * p_sem, unsigned initial_count, unsigned limit)
+{
+	p_sem->c = initial_count;
+	return 0;
+}
+
+static int node_sem_take(struct k_sem * p_sem, k_timeout_t timeout)
+{
+	if (p_sem->c == 0) return -EAGAIN;
+	p_sem->c--;
+	return 0;
+}
+
+static void node_sem_give(struct k_sem * p_sem)
+{
+	p_sem->c++;
+}
+
+static int node_msgq_put(struct k_msgq * p_queue, void const * p_data, size_t size)
+{
+	if ((message_count == SERIAL_ARQ_RX_QUEUE_LENGTH) || (size > NODE_MESSAGE_SIZE)) return -ENOMSG;
+	memcpy(messages[(message_read_index + message_count) % SERIAL_ARQ_RX_QUEUE_LENGTH], p_data, size);
+	message_count++;
+	return 0;
+}
+
+static int node_msgq_get(struct k_msgq * p_queue, void * p_data, size_t size)
+{
+	if (message_count == 0) return -EAGAIN;
+	memcpy(p_data, messages[message_read_index], size);
+	message_read_index = (message_read_index + 1) % SERIAL_ARQ_RX_QUEUE_LENGTH;
+	message_count--;
+	return 0;
+}
+
+static void node_msgq_purge(struct k_msgq * p_queue)
+{
+	message_count = 0;
+}
+
+static void node_work_init(struct k_work * p_work, k_work_handler_t handler)
+{
+	p_work->h = handler;
+	p_submitted_work = NULL;
+}
+
+static void node_work_init_delayable(struct k_work_delayable * p_work, k_work_handler_t handler)
+{
+	p_work->work.h = handler;
+	scheduled_us = -1;
+}
+
+static int node_work_submit(struct k_work * p_work)
+{
+	p_submitted_work = p_work;
+	return 1;
+}
+
+static int node_work_reschedule(struct k_work_delayable * p_work, k_timeout_t delay)
+{
+	p_scheduled_work = p_work;
+	scheduled_us = sim_now_us() + delay.t * 1000;
+	return 1;
+}
+
+static int node_work_cancel_delayable(struct k_work_delayable * p_work)
+{
+	scheduled_us = -1;
+	return 0;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define serial_claim node_claim
+#define serial_release node_release
+#define uart_serial_add_callback node_add_callback
+#define uart_serial_remove_callback node_remove_callback
+#define uart_serial_set_framing node_set_framing
+#define uart_serial_get_line node_get_line
+#define uart_serial_send_frame node_send_frame
+#define ble_serial_add_callback node_add_callback
+#define ble_serial_remove_callback node_remove_callback
+#define ble_serial_set_framing node_set_framing
+#define ble_serial_get_line node_get_line
+#define ble_serial_send_frame node_send_frame
+#define k_sem_init node_sem_init
+#define k_sem_take node_sem_take
+#define k_sem_give node_sem_give
+#define k_msgq_put(p_queue, p_data, timeout) node_msgq_put((p_queue), (p_data), sizeof(*(p_data)))
+#define k_msgq_get(p_queue, p_data, timeout) node_msgq_get((p_queue), (p_data), sizeof(*(p_data)))
+#define k_msgq_purge node_msgq_purge
+#define k_work_init node_work_init
+#define k_work_init_delayable node_work_init_delayable
+#define k_work_submit node_work_submit
+#define k_work_reschedule node_work_reschedule
+#define k_work_cancel_delayable node_work_cancel_delayable
+#define sys_rand32_get sim_rand32
+#define serial_arq_enable CONCAT(serial_arq_enable_, NODE)
+#define serial_arq_disable CONCAT(serial_arq_disable_, NODE)
+#define serial_arq_send CONCAT(serial_arq_send_, NODE)
+#define serial_arq_receive CONCAT(serial_arq_receive_, NODE)
+#define serial_arq_get_stats CONCAT(serial_arq_get_stats_, NODE)
+
+#include "serial_arq.c"
+
+static void node_notify(void)
+{
+	static serial_event_t const event = { .type = SERIAL_EVENT_TYPE_NEW_DATA_RECEIVED };
+	if (callback != NULL) callback(&event);
+}
+
+static void node_run(void)
+{
+	if (p_submitted_work != NULL)
+	{
+		struct k_work * p_work = p_submitted_work;
+		p_submitted_work = NULL;
+		p_work->h(p_work);
+	}
+	if ((scheduled_us >= 0) && (sim_now_us() >= scheduled_us))
+	{
+		scheduled_us = -1;
+		p_scheduled_work->work.h(&(p_scheduled_work->work));
+	}
+}
+
+serial_arq_node_t const CONCAT(serial_arq_node_, NODE) = {
+	.enable = serial_arq_enable,
+	.disable = serial_arq_disable,
+	.send = serial_arq_send,
+	.receive = serial_arq_receive,
+	.get_stats = serial_arq_get_stats,
+	.notify = node_notify,
+	.run = node_run,
+};
@@ -0,0 +1,27 @@
+#ifndef SERIAL_ARQ_SIM_H_
+#define SERIAL_ARQ_SIM_H_
+
+#include "serial_arq.h"
+
+// one end of the simulated link, serial_arq.c built by serial_arq_node.c with NODE set to 0 or 1
+typedef struct serial_arq_node_s
+{
+	serial_ret_code_t (*enable)(serial_arq_config_t const * p_config);
+	serial_ret_code_t (*disable)(void);
+	serial_ret_code_t (*send)(k_timeout_t timeout, char const * p_data, int len);
+	serial_line_t const * (*receive)(k_timeout_t timeout);
+	serial_ret_code_t (*get_stats)(serial_arq_stats_t * p_stats);
+	void (*notify)(void);            // fires the callback of the arq layer, frames are waiting in sim_get_line()
+	void (*run)(void);               // runs the submitted work and the retransmission once it is due
+} serial_arq_node_t;
+
+extern serial_arq_node_t const serial_arq_node_0;
+extern serial_arq_node_t const serial_arq_node_1;
+
+// provided by the test, which simulates the link between the two nodes
+int64_t sim_now_us(void);
+uint32_t sim_rand32(void);
+serial_ret_code_t sim_send_frame(int node, char const * p_data, int len);
+serial_line_t const * sim_get_line(int node);
+
+#endif  /* _ SERIAL_ARQ_SIM_H_ */
@@ -0,0 +1,328 @@
+#include "serial_arq_sim.h"
+
+#include "serial_internal.h"
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define STEP_US 100
+#define LINK_QUEUE_LENGTH 64
+#define FRAMING_OVERHEAD 4           // length and crc added by the length+crc framing
+#define FRAME_MAX (SERIAL_ARQ_MAX_PAYLOAD + 3)
+#define LOG_LENGTH 600
+
+typedef struct link_frame_s
+{
+	int64_t arrival_us;
+	int len;
+	char data[FRAME_MAX];
+} link_frame_t;
+
+// one direction of the link, frames are sent back to back and arrive after the latency unless they are lost
+typedef struct link_s
+{
+	int us_per_byte;
+	int latency_us;
+	int loss_percent;
+	int64_t busy_until_us;
+	link_frame_t frames[LINK_QUEUE_LENGTH];
+	int read_index;
+	int count;
+	int arrived;                     // frames at read_index which the receiving node can get
+} link_t;
+
+static serial_arq_node_t const * const nodes[] = { &serial_arq_node_0, &serial_arq_node_1 };
+static link_t links[2];              // links[n] carries the frames sent by node n
+static int64_t now_us;
+static uint32_t random_state;
+static char line_buffer[2][FRAME_MAX + 1];
+static serial_internal_line_t lines[2] = {
+	{ .mutable = { .p_buffer = line_buffer[0], .type = SERIAL_TYPE_BLE } },
+	{ .mutable = { .p_buffer = line_buffer[1], .type = SERIAL_TYPE_BLE } },
+};
+
+// messages received by node 1
+static char received_log[LOG_LENGTH][SERIAL_ARQ_MAX_PAYLOAD + 1];
+static int received_count;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void sim_reset(int us_per_byte, int latency_us, int loss_percent)
+{
+	for (int n = 0; n < 2; n++)
+	{
+		links[n] = (link_t) { .us_per_byte = us_per_byte, .latency_us = latency_us, .loss_percent = loss_percent };
+	}
+	now_us = 0;
+	random_state = 1;
+	received_count = 0;
+}
+
+static void sim_step(void)
+{
+	now_us += STEP_US;
+	for (int n = 0; n < 2; n++)
+	{
+		link_t * p_link = &links[n];
+		int const arrived = p_link->arrived;
+		while ((p_link->arrived < p_link->count) &&
+			(p_link->frames[(p_link->read_index + p_link->arrived) % LINK_QUEUE_LENGTH].arrival_us <= now_us))
+		{
+			p_link->arrived++;
+		}
+		if (p_link->arrived > arrived) nodes[1 - n]->notify();
+	}
+	for (int n = 0; n < 2; n++)
+	{
+		nodes[n]->run();
+	}
+	serial_line_t const * p_message;
+	while ((p_message = nodes[1]->receive(K_NO_WAIT))->len > 0)
+	{
+		if (received_count == LOG_LENGTH) continue;
+		memcpy(received_log[received_count], p_message->p_data, p_message->len + 1);
+		received_count++;
+	}
+}
+
+static void sim_run(int64_t duration_us)
+{
+	int64_t const end_us = now_us + duration_us;
+	while (now_us < end_us) sim_step();
+}
+
+// sends the messages from node 0 as fast as the window allows, returns the time until node 1 received all of them
+static int64_t sim_transfer(char const * p_prefix, int count, int payload_len, int64_t timeout_us)
+{
+	int64_t const start_us = now_us;
+	int const first = received_count;
+	int sent = 0;
+	while (((sent < count) || (received_count - first < count)) && (now_us - start_us < timeout_us))
+	{
+		while (sent < count)
+		{
+			char message[SERIAL_ARQ_MAX_PAYLOAD + 1];
+			memset(message, '.', payload_len);
+			int const len = snprintf(message, sizeof(message), "%s %d", p_prefix, sent);
+			if (len < payload_len) message[len] = '.';
+			if (nodes[0]->send(K_NO_WAIT, message, MAX(len, payload_len)) != SERIAL_RET_CODE_SUCCESS) break;
+			sent++;
+		}
+		sim_step();
+	}
+	return now_us - start_us;
+}
+
+// node 1 has to have received these messages in this order starting at index first
+static void check_received(int first, char const * p_prefix, int count, char const * p_test)
+{
+	TEST_CHECK(received_count - first >= count, "%s: %d of %d messages received", p_test, received_count - first, count);
+	for (int i = 0; (i < count) && (first + i < received_count); i++)
+	{
+		char expected[32];
+		int const len = snprintf(expected, sizeof(expected), "%s %d", p_prefix, i);
+		if (strncmp(received_log[first + i], expected, len) != 0 || (received_log[first + i][len] != '\0' &&
+			received_log[first + i][len] != '.'))
+		{
+			TEST_CHECK(false, "%s: message %d is '%s'", p_test, i, received_log[first + i]);
+			return;
+		}
+	}
+}
+
+static void enable_both(int window_size, int retransmit_timeout_ms)
+{
+	serial_arq_config_t const config = {
+		.type = SERIAL_TYPE_BLE,
+		.window_size = window_size,
+		.retransmit_timeout_ms = retransmit_timeout_ms,
+	};
+	for (int n = 0; n < 2; n++)
+	{
+		nodes[n]->disable();
+		TEST_CHECK(nodes[n]->enable(&config) == SERIAL_RET_CODE_SUCCESS, "enable node %d", n);
+	}
+}
+
+static void restart(int node, int window_size, int retransmit_timeout_ms)
+{
+	serial_arq_config_t const config = {
+		.type = SERIAL_TYPE_BLE,
+		.window_size = window_size,
+		.retransmit_timeout_ms = retransmit_timeout_ms,
+	};
+	nodes[node]->disable();
+	// frames which arrived before the restart were never read
+	links[1 - node].read_index = (links[1 - node].read_index + links[1 - node].arrived) % LINK_QUEUE_LENGTH;
+	links[1 - node].count -= links[1 - node].arrived;
+	links[1 - node].arrived = 0;
+	TEST_CHECK(nodes[node]->enable(&config) == SERIAL_RET_CODE_SUCCESS, "restart node %d", node);
+}
+
+static void test_in_order(void)
+{
+	sim_reset(10, 2000, 0);
+	enable_both(4, 50);
+	sim_transfer("msg", 20, 0, 1000000);
+	check_received(0, "msg", 20, "in order");
+	TEST_CHECK(received_count == 20, "in order: %d messages received", received_count);
+}
+
+// the peer starts again at sequence number 0 while node 1 expects a frame of the same window
+static void test_sender_restart(void)
+{
+	sim_reset(10, 2000, 0);
+	enable_both(4, 50);
+	sim_transfer("before", 3, 0, 1000000);
+	sim_run(100000);
+	restart(0, 4, 50);
+	sim_transfer("after", 5, 0, 1000000);
+	sim_run(100000);
+	check_received(0, "before", 3, "sender restart");
+	check_received(3, "after", 5, "sender restart");
+	TEST_CHECK(received_count == 8, "sender restart: %d messages received", received_count);
+
+	// frames in flight when the sender restarts are delivered before the sync, nothing is delivered twice
+	sim_reset(10, 2000, 0);
+	enable_both(4, 50);
+	sim_transfer("before", 3, 0, 1000000);
+	sim_run(100000);
+	for (int i = 3; i < 5; i++)
+	{
+		char message[16];
+		nodes[0]->send(K_NO_WAIT, message, snprintf(message, sizeof(message), "before %d", i));
+	}
+	restart(0, 4, 50);
+	sim_transfer("after", 5, 0, 1000000);
+	sim_run(100000);
+	check_received(0, "before", 5, "sender restart in flight");
+	check_received(5, "after", 5, "sender restart in flight");
+	TEST_CHECK(received_count == 10, "sender restart in flight: %d messages received", received_count);
+}
+
+// node 1 forgot the sequence number of node 0, which keeps counting
+static void test_receiver_restart(void)
+{
+	sim_reset(10, 2000, 0);
+	enable_both(4, 50);
+	sim_transfer("before", 3, 0, 1000000);
+	sim_run(100000);
+	restart(1, 4, 50);
+	sim_transfer("after", 5, 0, 1000000);
+	sim_run(100000);
+	check_received(0, "before", 3, "receiver restart");
+	check_received(3, "after", 5, "receiver restart");
+	TEST_CHECK(received_count == 8, "receiver restart: %d messages received", received_count);
+
+	serial_arq_stats_t stats;
+	nodes[0]->get_stats(&stats);
+	TEST_CHECK(stats.frames_dropped == 0, "receiver restart: %u frames dropped", stats.frames_dropped);
+}
+
+static void test_lossy_link(void)
+{
+	sim_reset(10, 2000, 10);
+	enable_both(8, 30);
+	sim_transfer("lossy", 300, 0, 60000000);
+	sim_run(1000000);
+	check_received(0, "lossy", 300, "lossy link");
+	TEST_CHECK(received_count == 300, "lossy link: %d messages received", received_count);
+
+	serial_arq_stats_t stats;
+	nodes[0]->get_stats(&stats);
+	TEST_CHECK(stats.frames_retransmitted > 0, "lossy link: no retransmissions");
+	TEST_CHECK(stats.frames_acked == 300, "lossy link: %u frames acked", stats.frames_acked);
+}
+
+// throughput of full payloads on a link like a ble connection, the window has to cover the round trip time
+static void test_throughput(void)
+{
+	int const us_per_byte = 50;
+	int const latency_us = 15000;
+	int const count = 200;
+	int const payload_len = SERIAL_ARQ_MAX_PAYLOAD;
+	int const frame_len = payload_len + 2 + FRAMING_OVERHEAD;
+	// payload bytes per second the link carries if it never idles
+	double const link_rate = 1e6 * payload_len / (frame_len * us_per_byte);
+	double rates[SERIAL_ARQ_MAX_WINDOW + 1] = { 0 };
+
+	printf("arq throughput, %d byte payloads, %d us per byte, %d ms latency, link limit %.0f bytes/s\n", payload_len,
+		us_per_byte, latency_us / 1000, link_rate);
+	for (int window = 1; window <= SERIAL_ARQ_MAX_WINDOW; window *= 2)
+	{
+		sim_reset(us_per_byte, latency_us, 0);
+		enable_both(window, 500);
+		int64_t const duration_us = sim_transfer("bench", count, payload_len, 60000000);
+		check_received(0, "bench", count, "throughput");
+		rates[window] = 1e6 * count * payload_len / duration_us;
+
+		serial_arq_stats_t stats;
+		nodes[0]->get_stats(&stats);
+		printf("  window %d: %6.0f bytes/s (%3.0f%% of the link), %u retransmissions, high water %u\n", window,
+			rates[window], 100 * rates[window] / link_rate, stats.frames_retransmitted, stats.window_high_water);
+		TEST_CHECK(stats.frames_retransmitted == 0, "throughput: window %d retransmitted", window);
+	}
+	TEST_CHECK(rates[1] < 0.5 * link_rate, "stop-and-wait should idle the link (%.0f bytes/s)", rates[1]);
+	TEST_CHECK(rates[SERIAL_ARQ_MAX_WINDOW] > 0.9 * link_rate, "full window reaches %.0f of %.0f bytes/s",
+		rates[SERIAL_ARQ_MAX_WINDOW], link_rate);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t sim_now_us(void)
+{
+	return now_us;
+}
+
+uint32_t sim_rand32(void)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return random_state >> 8;
+}
+
+serial_ret_code_t sim_send_frame(int node, char const * p_data, int len)
+{
+	link_t * p_link = &links[node];
+	if (p_link->count == LINK_QUEUE_LENGTH) return SERIAL_RET_CODE_ERROR_BUSY;
+
+	int64_t const start_us = MAX(now_us, p_link->busy_until_us);
+	p_link->busy_until_us = start_us + (len + FRAMING_OVERHEAD) * p_link->us_per_byte;
+	// a frame with a broken crc never reaches the arq layer
+	if ((int)(sim_rand32() % 100) < p_link->loss_percent) return SERIAL_RET_CODE_SUCCESS;
+
+	link_frame_t * p_frame = &p_link->frames[(p_link->read_index + p_link->count) % LINK_QUEUE_LENGTH];
+	p_frame->arrival_us = p_link->busy_until_us + p_link->latency_us;
+	p_frame->len = len;
+	memcpy(p_frame->data, p_data, len);
+	p_link->count++;
+	return SERIAL_RET_CODE_SUCCESS;
+}
+
+serial_line_t const * sim_get_line(int node)
+{
+	link_t * p_link = &links[1 - node];
+	serial_internal_line_t * p_line = &lines[node];
+	p_line->mutable.len = 0;
+	if (p_link->arrived == 0) return &(p_line->fixed);
+
+	link_frame_t const * p_frame = &p_link->frames[p_link->read_index];
+	memcpy(p_line->mutable.p_buffer, p_frame->data, p_frame->len);
+	p_line->mutable.len = p_frame->len;
+	p_link->read_index = (p_link->read_index + 1) % LINK_QUEUE_LENGTH;
+	p_link->count--;
+	p_link->arrived--;
+	return &(p_line->fixed);
+}
+
+
+int main(void)
+{
+	test_in_order();
+	test_sender_restart();
+	test_receiver_restart();
+	test_lossy_link();
+	test_throughput();
+	return TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+#include "serial_framing.h"
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define FRAME_MAX 600
+
+static serial_framing_t const framings[] = { SERIAL_FRAMING_COBS, SERIAL_FRAMING_SLIP, SERIAL_FRAMING_LENGTH_CRC };
+static char const * const framing_names[] = { "cobs", "slip", "length_crc" };
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+// feeds the encoded bytes one by one, returns the result of the last byte
+static serial_framing_result_t decode_all(serial_framing_engine_t const * p_engine, char const * p_in, int len, char * p_out,
+	size_t * p_len, size_t max_len)
+{
+	serial_framing_decoder_t decoder = { 0 };
+	serial_framing_result_t result = SERIAL_FRAMING_RESULT_PENDING;
+	*p_len = 0;
+	for (int i = 0; i < len; i++)
+	{
+		result = p_engine->decode(&decoder, (uint8_t)p_in[i], p_out, p_len, max_len);
+		if ((result != SERIAL_FRAMING_RESULT_PENDING) && (i != len - 1)) return SERIAL_FRAMING_RESULT_ERROR;
+	}
+	return result;
+}
+
+static void test_round_trip(int framing_index, char const * p_payload, int len)
+{
+	serial_framing_engine_t const * p_engine = serial_framing_get_engine(framings[framing_index]);
+	char encoded[2 * FRAME_MAX + 4];
+	char decoded[FRAME_MAX];
+	size_t decoded_len;
+
+	int const encoded_len = p_engine->encode(p_payload, len, encoded, sizeof(encoded));
+	TEST_CHECK(encoded_len > len, "%s: encode %d bytes", framing_names[framing_index], len);
+	if (encoded_len <= len) return;
+	serial_framing_result_t const result = decode_all(p_engine, encoded, encoded_len, decoded, &decoded_len, sizeof(decoded));
+	// back to back slip END characters are line noise, an empty slip frame never completes
+	if (len == 0 && framings[framing_index] == SERIAL_FRAMING_SLIP)
+	{
+		TEST_CHECK(result == SERIAL_FRAMING_RESULT_PENDING, "%s: empty frame", framing_names[framing_index]);
+		return;
+	}
+	TEST_CHECK(result == SERIAL_FRAMING_RESULT_COMPLETE, "%s: decode %d bytes", framing_names[framing_index], len);
+	TEST_CHECK(decoded_len == (size_t)len && memcmp(decoded, p_payload, len) == 0, "%s: payload of %d bytes",
+		framing_names[framing_index], len);
+}
+
+static void test_round_trips(void)
+{
+	char payload[FRAME_MAX];
+	// the special characters of all framings and the cobs block boundaries
+	int const lengths[] = { 0, 1, 2, 253, 254, 255, 256, 508, 509, FRAME_MAX };
+	for (int f = 0; f < ARRAY_SIZE(framings); f++)
+	{
+		for (int l = 0; l < ARRAY_SIZE(lengths); l++)
+		{
+			for (int i = 0; i < lengths[l]; i++) payload[i] = (char)(i * 7 + 1);
+			test_round_trip(f, payload, lengths[l]);
+			memset(payload, 0x00, lengths[l]);
+			test_round_trip(f, payload, lengths[l]);
+			for (int i = 0; i < lengths[l]; i++) payload[i] = (char)((i & 1) ? 0xC0 : 0xDB);
+			test_round_trip(f, payload, lengths[l]);
+		}
+	}
+}
+
+static void test_known_frames(void)
+{
+	char encoded[16];
+	int len = serial_framing_get_engine(SERIAL_FRAMING_COBS)->encode("\x11\x00\x22", 3, encoded, sizeof(encoded));
+	TEST_CHECK(len == 5 && memcmp(encoded, "\x02\x11\x02\x22\x00", 5) == 0, "cobs known frame");
+	len = serial_framing_get_engine(SERIAL_FRAMING_SLIP)->encode("\xC0\xDB", 2, encoded, sizeof(encoded));
+	TEST_CHECK(len == 6 && memcmp(encoded, "\xC0\xDB\xDC\xDB\xDD\xC0", 6) == 0, "slip known frame");
+	// crc16-ccitt with initial value 0xFFFF, check value of "123456789" is 0x29B1
+	TEST_CHECK(serial_framing_crc16(0xFFFF, (uint8_t const *)"123456789", 9) == 0x29B1, "crc16 check value");
+	len = serial_framing_get_engine(SERIAL_FRAMING_LENGTH_CRC)->encode("A", 1, encoded, sizeof(encoded));
+	uint16_t const crc = serial_framing_crc16(0xFFFF, (uint8_t const *)"\x01\x00" "A", 3);
+	TEST_CHECK(len == 5 && memcmp(encoded, "\x01\x00" "A", 3) == 0 && (uint8_t)encoded[3] == (crc & 0xFF) &&
+		(uint8_t)encoded[4] == (crc >> 8), "length_crc known frame");
+	TEST_CHECK(serial_framing_get_engine(SERIAL_FRAMING_LINE) == NULL, "line framing has no engine");
+}
+
+static void test_errors(void)
+{
+	char encoded[32];
+	char decoded[32];
+	size_t decoded_len;
+
+	serial_framing_engine_t const * p_engine = serial_framing_get_engine(SERIAL_FRAMING_LENGTH_CRC);
+	int len = p_engine->encode("payload", 7, encoded, sizeof(encoded));
+	encoded[4] ^= 0x01;
+	TEST_CHECK(decode_all(p_engine, encoded, len, decoded, &decoded_len, sizeof(decoded)) == SERIAL_FRAMING_RESULT_ERROR,
+		"length_crc corrupt payload");
+	len = p_engine->encode("payload", 7, encoded, sizeof(encoded));
+	TEST_CHECK(decode_all(p_engine, encoded, 2, decoded, &decoded_len, 6) == SERIAL_FRAMING_RESULT_ERROR,
+		"length_crc frame longer than max_len");
+
+	p_engine = serial_framing_get_engine(SERIAL_FRAMING_SLIP);
+	TEST_CHECK(decode_all(p_engine, "\xC0" "a\xDB" "b\xC0", 5, decoded, &decoded_len, sizeof(decoded)) ==
+		SERIAL_FRAMING_RESULT_ERROR, "slip invalid escape");
+	len = p_engine->encode("payload", 7, encoded, sizeof(encoded));
+	TEST_CHECK(decode_all(p_engine, encoded, len, decoded, &decoded_len, 6) == SERIAL_FRAMING_RESULT_ERROR,
+		"slip frame longer than max_len");
+
+	p_engine = serial_framing_get_engine(SERIAL_FRAMING_COBS);
+	TEST_CHECK(decode_all(p_engine, "\x05" "ab\x00", 4, decoded, &decoded_len, sizeof(decoded)) == SERIAL_FRAMING_RESULT_ERROR,
+		"cobs truncated block");
+	len = p_engine->encode("payload", 7, encoded, sizeof(encoded));
+	TEST_CHECK(decode_all(p_engine, encoded, len, decoded, &decoded_len, 6) == SERIAL_FRAMING_RESULT_ERROR,
+		"cobs frame longer than max_len");
+	TEST_CHECK(p_engine->encode("payload", 7, encoded, 8) == -1, "cobs output too small");
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+int main(void)
+{
+	test_round_trips();
+	test_known_frames();
+	test_errors();
+	return TEST_RESULT();
+}
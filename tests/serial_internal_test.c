@@ -0,0 +1,60 @@
+#include "serial_internal.h"
+
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DEFINITIONS AND STATIC VARIABLES
+#define RING_SIZE 8
+
+static char input_buffer[RING_SIZE + 1];
+static char line_buffer[RING_SIZE + 1];
+static struct k_sem sem_data_ready;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// STATIC FUNCTIONS
+static void fire_callbacks(serial_event_t const * p_event)
+{
+}
+
+static void put(serial_internal_ring_t * p_ring, char const * p_data)
+{
+	serial_internal_put(p_ring, p_data, strlen(p_data));
+}
+
+// the consumer keeps its scan of an unterminated line between polls, the producer can drop that line in the meantime
+static void test_drop_line_during_scan(void)
+{
+	static serial_internal_line_t line = { .mutable = { .len = 0, .p_buffer = line_buffer, .type = SERIAL_TYPE_UART } };
+	serial_internal_ring_t ring = {
+		.p_buffer = input_buffer,
+		.size = RING_SIZE,
+		.end_character_list = "\n",
+		.end_character_count = 1,
+		.overflow_policy = SERIAL_OVERFLOW_POLICY_DROP_LINE,
+	};
+
+	put(&ring, "abcde");
+	serial_line_t const * p_line = serial_internal_get_line(&sem_data_ready, K_NO_WAIT, &line, &ring, false, fire_callbacks);
+	TEST_CHECK(p_line->len == 0, "unterminated line is not handed out");
+	TEST_CHECK(ring.scan.scanned == 5, "scan of %d bytes kept", ring.scan.scanned);
+
+	// fills the buffer, the next byte drops the whole line and the rest of it up to the end character
+	put(&ring, "fghij\n");
+	TEST_CHECK(ring.bytes_in_buffer == 0, "line dropped, %d bytes left", ring.bytes_in_buffer);
+	// the new line is longer than the old scan, only the drop counter tells that the scan is stale
+	put(&ring, "1234567\n");
+	p_line = serial_internal_get_line(&sem_data_ready, K_NO_WAIT, &line, &ring, false, fire_callbacks);
+	TEST_CHECK(p_line->len == 8 && memcmp(p_line->p_data, "1234567\n", 8) == 0, "line after the drop: %.*s",
+		(int)p_line->len, p_line->p_data);
+	TEST_CHECK(ring.bytes_in_buffer == 0, "%d bytes left", ring.bytes_in_buffer);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+int main(void)
+{
+	test_drop_line_during_scan();
+	return TEST_RESULT();
+}
@@ -0,0 +1,2 @@
+// host test stub, declares what the sources under test use
+#pragma once
@@ -0,0 +1,30 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+typedef int nrfx_err_t;
+#define NRFX_SUCCESS 0
+#define NRF_PWM_CHANNEL_COUNT 4
+#define NRF_PWM_PIN_NOT_CONNECTED 0xFF
+typedef struct { void * p_reg; uint8_t drv_inst_idx; } nrfx_pwm_t;
+#define NRFX_PWM_INSTANCE(id) { .p_reg = 0, .drv_inst_idx = id }
+typedef struct { uint16_t channel_0, channel_1, channel_2, channel_3; } nrf_pwm_values_individual_t;
+typedef union { uint16_t const * p_raw; nrf_pwm_values_individual_t const * p_individual; } nrf_pwm_values_t;
+typedef struct { nrf_pwm_values_t values; uint16_t length; uint32_t repeats; uint32_t end_delay; } nrf_pwm_sequence_t;
+#define NRF_PWM_VALUES_LENGTH(array) (sizeof(array) / sizeof(uint16_t))
+typedef enum { NRF_PWM_CLK_16MHz, NRF_PWM_CLK_1MHz = 4 } nrf_pwm_clk_t;
+typedef enum { NRF_PWM_MODE_UP } nrf_pwm_mode_t;
+typedef enum { NRF_PWM_LOAD_COMMON, NRF_PWM_LOAD_INDIVIDUAL = 2 } nrf_pwm_dec_load_t;
+typedef enum { NRF_PWM_STEP_AUTO } nrf_pwm_dec_step_t;
+typedef struct { uint8_t output_pins[4]; uint8_t irq_priority; nrf_pwm_clk_t base_clock; nrf_pwm_mode_t count_mode; uint16_t top_value; nrf_pwm_dec_load_t load_mode; nrf_pwm_dec_step_t step_mode; bool skip_gpio_cfg; bool skip_psel_cfg; } nrfx_pwm_config_t;
+typedef enum { NRFX_PWM_EVT_FINISHED, NRFX_PWM_EVT_END_SEQ0, NRFX_PWM_EVT_END_SEQ1, NRFX_PWM_EVT_STOPPED } nrfx_pwm_evt_type_t;
+typedef void (*nrfx_pwm_handler_t)(nrfx_pwm_evt_type_t, void *);
+nrfx_err_t nrfx_pwm_init(nrfx_pwm_t const *, nrfx_pwm_config_t const *, nrfx_pwm_handler_t, void *);
+uint32_t nrfx_pwm_complex_playback(nrfx_pwm_t const *, nrf_pwm_sequence_t const *, nrf_pwm_sequence_t const *, uint16_t, uint32_t);
+#define NRFX_PWM_FLAG_LOOP 1
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ0 2
+#define NRFX_PWM_FLAG_SIGNAL_END_SEQ1 4
+void nrfx_pwm_0_irq_handler(void);
+void nrfx_isr(const void *);
+#define NRF_PWM0 0
+#define NRFX_IRQ_NUMBER_GET(x) 28
@@ -0,0 +1,75 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <zephyr/kernel.h>
+struct net_buf_simple { uint8_t *data; uint16_t len; uint16_t size; };
+typedef struct { uint8_t val[6]; } bt_addr_t;
+typedef struct { uint8_t type; bt_addr_t a; } bt_addr_le_t;
+struct bt_data { uint8_t type; uint8_t data_len; const uint8_t *data; };
+#define BT_DATA(_type,_data,_len) { .type=(_type), .data_len=(_len), .data=(const uint8_t*)(_data) }
+#define BT_DATA_BYTES(_type, ...) { .type=(_type), .data_len=sizeof((uint8_t[]){__VA_ARGS__}), .data=(const uint8_t*)((uint8_t[]){__VA_ARGS__}) }
+#define BT_DATA_FLAGS 1
+#define BT_DATA_NAME_COMPLETE 9
+#define BT_DATA_SVC_DATA128 0x21
+#define BT_DATA_MANUFACTURER_DATA 0xff
+#define BT_LE_AD_GENERAL 2
+#define BT_LE_AD_NO_BREDR 4
+#define BT_GAP_ADV_FAST_INT_MIN_1 0x30
+#define BT_GAP_ADV_FAST_INT_MAX_1 0x60
+#define BT_GAP_ADV_MAX_EXT_ADV_DATA_LEN 1650
+#define BT_GAP_ADV_MAX_ADV_DATA_LEN 31
+#define BT_GAP_SCAN_FAST_INTERVAL 0x60
+struct bt_conn; struct bt_le_ext_adv; struct bt_le_per_adv_sync;
+struct bt_le_conn_param { uint16_t interval_min, interval_max, latency, timeout; };
+struct bt_le_adv_param { uint8_t id; uint8_t sid; uint32_t options; uint32_t interval_min; uint32_t interval_max; const bt_addr_le_t * peer; };
+#define BT_LE_ADV_OPT_EXT_ADV BIT(10)
+#define BT_LE_ADV_OPT_USE_NAME BIT(3)
+#define BT_LE_ADV_CONN ((struct bt_le_adv_param*)0)
+#define BT_LE_EXT_ADV_NCONN_NAME ((struct bt_le_adv_param*)0)
+#define BT_LE_EXT_ADV_NCONN ((struct bt_le_adv_param*)0)
+#define BT_LE_ADV_PARAM(o,mi,ma,p) ((struct bt_le_adv_param[]){{ .options=(o), .interval_min=(mi), .interval_max=(ma), .peer=(p)}})
+int bt_le_adv_start(const struct bt_le_adv_param*, const struct bt_data*, size_t, const struct bt_data*, size_t);
+typedef void (*bt_ready_cb_t)(int err);
+int bt_enable(bt_ready_cb_t);
+struct bt_le_scan_param { uint8_t type; uint32_t options; uint16_t interval; uint16_t window; uint16_t timeout; uint16_t interval_coded; uint16_t window_coded; };
+#define BT_LE_SCAN_TYPE_PASSIVE 0
+#define BT_LE_SCAN_OPT_NONE 0
+#define BT_LE_SCAN_OPT_FILTER_DUPLICATE BIT(0)
+#define BT_LE_SCAN_OPT_FILTER_ACCEPT_LIST BIT(1)
+typedef void bt_le_scan_cb_t(const bt_addr_le_t *addr, int8_t rssi, uint8_t adv_type, struct net_buf_simple *buf);
+int bt_le_scan_start(const struct bt_le_scan_param*, bt_le_scan_cb_t);
+int bt_le_scan_stop(void);
+void bt_data_parse(struct net_buf_simple*, bool (*func)(struct bt_data*, void*), void*);
+struct bt_le_ext_adv_connected_info { struct bt_conn * conn; };
+struct bt_le_ext_adv_scanned_info { bt_addr_le_t * addr; };
+struct bt_le_ext_adv_sent_info { uint8_t num_sent; };
+struct bt_le_ext_adv_cb { void (*sent)(struct bt_le_ext_adv*, struct bt_le_ext_adv_sent_info*); void (*connected)(struct bt_le_ext_adv*, struct bt_le_ext_adv_connected_info*); void (*scanned)(struct bt_le_ext_adv*, struct bt_le_ext_adv_scanned_info*); };
+int bt_le_ext_adv_create(const struct bt_le_adv_param*, const struct bt_le_ext_adv_cb*, struct bt_le_ext_adv**);
+int bt_le_ext_adv_set_data(struct bt_le_ext_adv*, const struct bt_data*, size_t, const struct bt_data*, size_t);
+struct bt_le_ext_adv_start_param { uint16_t timeout; uint8_t num_events; };
+#define BT_LE_EXT_ADV_START_DEFAULT ((struct bt_le_ext_adv_start_param[]){{0,0}})
+int bt_le_ext_adv_start(struct bt_le_ext_adv*, struct bt_le_ext_adv_start_param*);
+int bt_le_ext_adv_stop(struct bt_le_ext_adv*);
+struct bt_le_ext_adv_info { uint8_t id; int8_t tx_power; const bt_addr_le_t * addr; };
+int bt_le_ext_adv_get_info(const struct bt_le_ext_adv*, struct bt_le_ext_adv_info*);
+struct bt_le_per_adv_param { uint16_t interval_min; uint16_t interval_max; uint32_t options; };
+#define BT_LE_PER_ADV_OPT_NONE 0
+int bt_le_per_adv_set_param(struct bt_le_ext_adv*, const struct bt_le_per_adv_param*);
+int bt_le_per_adv_set_data(const struct bt_le_ext_adv*, const struct bt_data*, size_t);
+int bt_le_per_adv_start(struct bt_le_ext_adv*);
+struct bt_le_scan_recv_info { const bt_addr_le_t *addr; uint8_t sid; int8_t rssi; int8_t tx_power; uint8_t adv_type; uint16_t adv_props; uint16_t interval; uint8_t primary_phy, secondary_phy; };
+struct bt_le_scan_cb { void (*recv)(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf); void (*timeout)(void); int node; };
+void bt_le_scan_cb_register(struct bt_le_scan_cb*);
+struct bt_le_per_adv_sync_param { bt_addr_le_t addr; uint8_t sid; uint32_t options; uint16_t skip; uint16_t timeout; };
+struct bt_le_per_adv_sync_synced_info { const bt_addr_le_t *addr; uint8_t sid; uint16_t interval; uint8_t phy; };
+struct bt_le_per_adv_sync_term_info { const bt_addr_le_t *addr; uint8_t sid; uint8_t reason; };
+struct bt_le_per_adv_sync_recv_info { const bt_addr_le_t *addr; uint8_t sid; int8_t tx_power; int8_t rssi; uint8_t cte_type; };
+struct bt_le_per_adv_sync_cb { void (*synced)(struct bt_le_per_adv_sync*, struct bt_le_per_adv_sync_synced_info*); void (*term)(struct bt_le_per_adv_sync*, const struct bt_le_per_adv_sync_term_info*); void (*recv)(struct bt_le_per_adv_sync*, const struct bt_le_per_adv_sync_recv_info*, struct net_buf_simple*); int node; };
+void bt_le_per_adv_sync_cb_register(struct bt_le_per_adv_sync_cb*);
+int bt_le_per_adv_sync_create(const struct bt_le_per_adv_sync_param*, struct bt_le_per_adv_sync**);
+int bt_le_per_adv_sync_delete(struct bt_le_per_adv_sync*);
+#define BT_HCI_LE_EXT_ADV_DATA_INCOMPLETE 0
+#define BT_GAP_ADV_PROP_EXT_ADV BIT(4)
+int bt_le_filter_accept_list_add(const bt_addr_le_t*); int bt_le_filter_accept_list_clear(void);
+void bt_addr_le_copy(bt_addr_le_t*, const bt_addr_le_t*);
+int bt_addr_le_cmp(const bt_addr_le_t*, const bt_addr_le_t*);
+#define BT_ADDR_LE_STR_LEN 30
@@ -0,0 +1,8 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <zephyr/bluetooth/bluetooth.h>
+struct bt_conn_cb { void (*connected)(struct bt_conn*, uint8_t); void (*disconnected)(struct bt_conn*, uint8_t); bool (*le_param_req)(struct bt_conn*, struct bt_le_conn_param*); void (*le_param_updated)(struct bt_conn*, uint16_t, uint16_t, uint16_t); };
+void bt_conn_cb_register(struct bt_conn_cb*);
+uint16_t bt_gatt_get_mtu(struct bt_conn*);
+struct bt_gatt_exchange_params { void (*func)(struct bt_conn*, uint8_t, struct bt_gatt_exchange_params*); };
+int bt_gatt_exchange_mtu(struct bt_conn*, struct bt_gatt_exchange_params*);
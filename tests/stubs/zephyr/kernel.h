@@ -0,0 +1,84 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+typedef struct { int64_t t; } k_timeout_t;
+#define K_MSEC(x) ((k_timeout_t){x})
+#define K_USEC(x) ((k_timeout_t){x})
+#define K_NO_WAIT ((k_timeout_t){0})
+#define K_FOREVER ((k_timeout_t){-1})
+#define K_TIMEOUT_EQ(a,b) ((a).t==(b).t)
+struct k_sem { int c; };
+#define K_SEM_DEFINE(n,a,b) struct k_sem n = {a}
+int k_sem_take(struct k_sem*, k_timeout_t); void k_sem_give(struct k_sem*); void k_sem_reset(struct k_sem*);
+unsigned k_sem_count_get(struct k_sem*);
+int k_sem_init(struct k_sem*, unsigned, unsigned);
+int32_t k_sleep(k_timeout_t);
+int64_t k_uptime_get(void); uint32_t k_uptime_get_32(void);
+uint32_t k_cycle_get_32(void); uint64_t k_cycle_get_64(void);
+uint64_t k_cyc_to_us_floor64(uint64_t); uint64_t k_ticks_to_us_floor64(uint64_t);
+uint64_t k_ticks_to_ms_floor64(uint64_t); uint64_t k_ms_to_ticks_ceil64(uint64_t);
+int64_t k_uptime_ticks(void);
+struct k_mutex { int x; };
+#define K_MUTEX_DEFINE(n) struct k_mutex n
+int k_mutex_lock(struct k_mutex*, k_timeout_t); int k_mutex_unlock(struct k_mutex*);
+int k_mutex_init(struct k_mutex*);
+struct k_work; typedef void (*k_work_handler_t)(struct k_work*);
+struct k_work { k_work_handler_t h; };
+struct k_work_delayable { struct k_work work; };
+struct k_work_q { int x; };
+struct k_work_queue_config { const char * name; bool no_yield; };
+#define K_WORK_DELAYABLE_DEFINE(n,h) struct k_work_delayable n = {{h}}
+#define K_WORK_DEFINE(n,h) struct k_work n = {h}
+void k_work_init(struct k_work*, k_work_handler_t); void k_work_init_delayable(struct k_work_delayable*, k_work_handler_t);
+int k_work_submit(struct k_work*); int k_work_submit_to_queue(struct k_work_q*, struct k_work*);
+int k_work_schedule(struct k_work_delayable*, k_timeout_t); int k_work_reschedule(struct k_work_delayable*, k_timeout_t);
+int k_work_cancel_delayable(struct k_work_delayable*); int k_work_cancel(struct k_work*);
+bool k_work_cancel_sync(struct k_work*, void*); 
+struct k_work_sync { int x; };
+struct k_work_delayable * k_work_delayable_from_work(struct k_work*);
+void k_work_queue_init(struct k_work_q*);
+typedef int k_thread_stack_t;
+#define K_THREAD_STACK_ARRAY_DEFINE(n,a,b) k_thread_stack_t n[a][b]
+#define K_THREAD_STACK_DEFINE(n,b) k_thread_stack_t n[b]
+#define K_THREAD_STACK_SIZEOF(x) sizeof(x)
+void k_work_queue_start(struct k_work_q*, k_thread_stack_t*, size_t, int, const struct k_work_queue_config*);
+#define CONTAINER_OF(p,t,f) ((t*)(((char*)(p))-offsetof(t,f)))
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof((a)[0]))
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define CLAMP(v,a,b) MIN(MAX(v,a),b)
+#define BIT(n) (1UL<<(n))
+#define __ASSERT(c, ...) ((void)0)
+#define __packed __attribute__((packed))
+#define BUILD_ASSERT(c, ...) _Static_assert(c, "")
+typedef long atomic_t; typedef atomic_t atomic_val_t;
+atomic_val_t atomic_get(const atomic_t*); atomic_val_t atomic_set(atomic_t*, atomic_val_t);
+atomic_val_t atomic_inc(atomic_t*); atomic_val_t atomic_dec(atomic_t*); atomic_val_t atomic_add(atomic_t*, atomic_val_t);
+bool atomic_cas(atomic_t*, atomic_val_t, atomic_val_t);
+atomic_val_t atomic_clear(atomic_t*);
+typedef int k_spinlock_key_t; struct k_spinlock{int x;};
+k_spinlock_key_t k_spin_lock(struct k_spinlock*); void k_spin_unlock(struct k_spinlock*, k_spinlock_key_t);
+unsigned irq_lock(void); void irq_unlock(unsigned);
+#define sys_cpu_to_le16(x) (x)
+#define sys_le16_to_cpu(x) (x)
+uint32_t sys_rand32_get(void);
+void compiler_barrier(void);
+#define __DMB() 
+struct k_msgq { int x; };
+#define K_MSGQ_DEFINE(n,s,m,a) struct k_msgq n
+int k_msgq_put(struct k_msgq*, const void*, k_timeout_t); int k_msgq_get(struct k_msgq*, void*, k_timeout_t);
+void k_msgq_purge(struct k_msgq*); uint32_t k_msgq_num_used_get(struct k_msgq*);
+#define K_THREAD_DEFINE(n,s,e,a,b,c,p,o,d) int n
+typedef struct k_thread * k_tid_t;
+struct k_thread { int x; };
+k_tid_t k_current_get(void);
+k_tid_t k_thread_create(struct k_thread*, k_thread_stack_t*, size_t, void(*)(void*,void*,void*), void*, void*, void*, int, uint32_t, k_timeout_t);
+int k_thread_name_set(k_tid_t, const char*);
+#define K_PRIO_PREEMPT(x) (x)
+int k_msgq_init(struct k_msgq*, char*, size_t, uint32_t);
+#define IRQ_CONNECT(n,p,f,a,fl) ((void)(n),(void)(p),(void)(f),(void)(a))
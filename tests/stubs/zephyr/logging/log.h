@@ -0,0 +1,14 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <stdio.h>
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WRN 2
+#define LOG_LEVEL_INF 3
+#define LOG_LEVEL_DBG 4
+#define LOG_MODULE_REGISTER(...) 
+#define LOG_MODULE_DECLARE(...)
+#define LOG_ERR(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#define LOG_WRN(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#define LOG_INF(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#define LOG_DBG(...) do { if (0) printf(__VA_ARGS__); } while (0)
+#define LOG_HEXDUMP_DBG(...)
@@ -0,0 +1,3 @@
+// host test stub, declares what the sources under test use
+#pragma once
+#include <zephyr/kernel.h>
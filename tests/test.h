@@ -0,0 +1,23 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+// every failed check is printed, the test fails at the end if any check failed
+static int test_failures = 0;
+
+#define TEST_CHECK(condition, ...) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s:%d: check failed: ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_RESULT() ((test_failures == 0) ? 0 : 1)
+
+#endif /* TEST_H_ */
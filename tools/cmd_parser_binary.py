@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Host side encoder for the binary cmd_parser requests.
+
+A request is the index of the command in the firmware command list followed by
+its arguments, each written as TYPE:VALUE:
+
+    cmd_parser_binary.py /dev/ttyACM0 3 i32:-5 enum:1 str:hello bytes:0a0b0c
+    cmd_parser_binary.py - 3 u32:7 > request.bin
+
+Types: i32, u32, i64, f32, bool, enum, str, bytes (hex). Commands without
+argument schema take a single raw:HEX argument.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0xB5
+STATUS = {0: "ok", 0xFF: "command invalid", 0xFE: "arguments invalid"}
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def encode_arg(spec):
+    kind, _, value = spec.partition(":")
+    if kind == "i32":
+        return struct.pack("<i", int(value, 0))
+    if kind == "u32":
+        return struct.pack("<I", int(value, 0))
+    if kind == "i64":
+        return struct.pack("<q", int(value, 0))
+    if kind == "f32":
+        return struct.pack("<f", float(value))
+    if kind in ("bool", "enum"):
+        return struct.pack("<B", int(value, 0))
+    if kind == "str":
+        data = value.encode("utf-8")
+        return struct.pack("<B", len(data)) + data
+    if kind == "bytes":
+        data = bytes.fromhex(value)
+        return struct.pack("<B", len(data)) + data
+    if kind == "raw":
+        return bytes.fromhex(value)
+    raise SystemExit("unknown argument type %r" % kind)
+
+
+def encode_request(opcode, payload):
+    if len(payload) > 255:
+        raise ValueError("payload longer than 255 bytes")
+    frame = bytes([MAGIC, opcode, len(payload)]) + payload
+    return frame + struct.pack("<H", crc16(frame)) + b"\n"
+
+
+def decode_response(data):
+    """Returns (opcode, status, data) of the first response frame in data or None."""
+    start = data.find(bytes([MAGIC]))
+    if start < 0 or len(data) < start + 6:
+        return None
+    frame = data[start:]
+    length = frame[3]
+    if len(frame) < 6 + length:
+        return None
+    (crc,) = struct.unpack_from("<H", frame, 4 + length)
+    if crc16(frame[:4 + length]) != crc:
+        raise ValueError("response crc mismatch")
+    return frame[1], frame[2], bytes(frame[4:4 + length])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial port, or - to write the request to stdout")
+    parser.add_argument("opcode", type=int, help="index of the command in the firmware command list")
+    parser.add_argument("args", nargs="*", metavar="TYPE:VALUE")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=1.0)
+    args = parser.parse_args()
+
+    request = encode_request(args.opcode, b"".join(encode_arg(spec) for spec in args.args))
+    if args.port == "-":
+        sys.stdout.buffer.write(request)
+        return
+
+    import serial  # pyserial
+    port = serial.Serial(args.port, args.baudrate, timeout=args.timeout)
+    port.write(request)
+    received = bytearray()
+    while True:
+        chunk = port.read(64)
+        if not chunk:
+            raise SystemExit("no response")
+        received += chunk
+        response = decode_response(received)
+        if response is not None:
+            break
+    opcode, status, data = response
+    print("opcode %d: %s" % (opcode, STATUS.get(status, "status %d" % status)))
+    if data:
+        sys.stdout.write(data.decode("utf-8", errors="replace"))
+    sys.exit(0 if status == 0 else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Host side codec for the helios_ble advert payload (wire version 1).
+
+The payload is the manufacturer data of an advert: company id, version and
+network hash, followed by one record per message. Every record holds the node
+id, sequence number, ttl, pattern, node count and the network time as a zigzag
+LEB128 varint, absolute for the first record and relative to it for the others.
+
+    helios_ble_codec.py decode ffff01d7a603070003010280897a040200020002f403
+    helios_ble_codec.py encode 3:7:3:1:2:1000000 4:2:2:0:2:1000250
+    helios_ble_codec.py hash
+
+Records for encode are NODE:SEQ:TTL:PATTERN:NODE_COUNT:NETWORK_TIME_US.
+"""
+
+import argparse
+import struct
+
+VERSION = 1
+COMPANY_ID = 0xFFFF
+NETWORK_UUID = bytes([0x2c, 0x4c, 0xc0, 0xf0, 0x37, 0x83, 0x84, 0xec, 0x97, 0xac, 0xfb, 0x32])
+NETWORK_ID = 0x12345678
+PATTERNS = ["trail", "precede", "sync", "on", "off", "knight_rider"]
+
+
+def network_hash(uuid=NETWORK_UUID, network_id=NETWORK_ID):
+    value = 2166136261
+    for byte in uuid + struct.pack("<I", network_id):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return (value >> 16) ^ (value & 0xFFFF)
+
+
+def encode_varint(value):
+    zigzag = ((value << 1) ^ (value >> 63)) & 0xFFFFFFFFFFFFFFFF
+    out = bytearray()
+    while True:
+        byte = zigzag & 0x7F
+        zigzag >>= 7
+        out.append(byte | (0x80 if zigzag else 0))
+        if not zigzag:
+            return bytes(out)
+
+
+def decode_varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        if offset >= len(data) or shift >= 70:
+            raise ValueError("truncated varint")
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return (value >> 1) ^ -(value & 1), offset
+
+
+def encode(records, hash_value=None):
+    """records: list of dicts with node_id, seq, ttl, pattern, node_count, network_time."""
+    if hash_value is None:
+        hash_value = network_hash()
+    out = bytearray(struct.pack("<HBH", COMPANY_ID, VERSION, hash_value))
+    base_time = 0
+    for index, record in enumerate(records):
+        out += struct.pack("<BHBBB", record["node_id"], record["seq"], record["ttl"], record["pattern"], record["node_count"])
+        out += encode_varint(record["network_time"] - base_time)
+        if index == 0:
+            base_time = record["network_time"]
+    return bytes(out)
+
+
+def decode(payload):
+    """Returns (network hash, records) of a payload, raises ValueError for other companies or versions."""
+    if len(payload) < 5:
+        raise ValueError("payload shorter than the header")
+    company_id, version, hash_value = struct.unpack_from("<HBH", payload)
+    if company_id != COMPANY_ID:
+        raise ValueError("company id 0x%04x" % company_id)
+    if version != VERSION:
+        raise ValueError("unknown version %d" % version)
+    records = []
+    offset = 5
+    base_time = 0
+    while len(payload) - offset > 6:
+        node_id, seq, ttl, pattern, node_count = struct.unpack_from("<BHBBB", payload, offset)
+        delta, offset = decode_varint(payload, offset + 6)
+        network_time = base_time + delta
+        if not records:
+            base_time = network_time
+        records.append({"node_id": node_id, "seq": seq, "ttl": ttl, "pattern": pattern,
+                        "node_count": node_count, "network_time": network_time})
+    return hash_value, records
+
+
+def parse_record(spec):
+    fields = [int(value, 0) for value in spec.split(":")]
+    if len(fields) != 6:
+        raise SystemExit("record %r is not NODE:SEQ:TTL:PATTERN:NODE_COUNT:NETWORK_TIME_US" % spec)
+    return dict(zip(["node_id", "seq", "ttl", "pattern", "node_count", "network_time"], fields))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    decode_parser = commands.add_parser("decode", help="decode a hex payload")
+    decode_parser.add_argument("payload")
+    encode_parser = commands.add_parser("encode", help="encode records to a hex payload")
+    encode_parser.add_argument("records", nargs="+", metavar="RECORD")
+    commands.add_parser("hash", help="print the network hash of the built in network")
+    args = parser.parse_args()
+
+    if args.command == "hash":
+        print("0x%04x" % network_hash())
+    elif args.command == "encode":
+        print(encode([parse_record(spec) for spec in args.records]).hex())
+    else:
+        hash_value, records = decode(bytes.fromhex(args.payload))
+        known = "" if hash_value == network_hash() else " (other network)"
+        print("network hash 0x%04x%s" % (hash_value, known))
+        for record in records:
+            pattern = record["pattern"]
+            name = PATTERNS[pattern] if pattern < len(PATTERNS) else str(pattern)
+            print("node %3d seq %5d ttl %d pattern %-12s nodes %3d time %d us" % (
+                record["node_id"], record["seq"], record["ttl"], name, record["node_count"], record["network_time"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Host model of the helios_ble network time servo (sync_sample in helios_ble.c).
+
+A reference node sends one advert per interval, stamped with its network time
+some latency before it reaches the receiver. The receiver runs the same window,
+step and PI correction as the firmware. After a settling time the error of its
+network time is sampled at random instants, per crystal error.
+
+    helios_ble_sync_sim.py                  # latency models of the main set
+    helios_ble_sync_sim.py --seconds 1200 --path-delay-us 1000
+
+The constants have to follow helios_ble.h and helios_ble.c.
+"""
+
+import argparse
+import math
+import random
+
+SYNC_STEP_US = 2000
+SYNC_WINDOW = 32
+SYNC_KP_DIV = 4
+SYNC_KI_DIV = 128
+SYNC_MAX_DRIFT_PPB = 200000
+ADV_INTERVAL_US = 100000
+ADV_DELAY_MAX_US = 10000
+PPM_ERRORS = (-90, -30, 0, 30, 60)
+
+
+def c_div(a, b):
+    """Integer division truncating towards zero like C."""
+    quotient = abs(a) // abs(b)
+    return quotient if (a >= 0) == (b >= 0) else -quotient
+
+
+class Receiver:
+    def __init__(self):
+        self.synchronized = False
+        self.drift_ppb = 0
+        self.base_local_us = 0
+        self.base_network_us = 0
+        self.last_servo_us = 0
+        self.window_count = 0
+        self.window_error_us = 0
+        self.window_local_us = 0
+
+    def network_time_at(self, local_us):
+        elapsed = local_us - self.base_local_us
+        return self.base_network_us + elapsed + c_div(elapsed * self.drift_ppb, 1000000000)
+
+    def sample(self, remote_time_us, rx_local_us):
+        error = remote_time_us - self.network_time_at(rx_local_us)
+        if not self.synchronized:
+            self.base_network_us = remote_time_us
+            self.base_local_us = rx_local_us
+            self.last_servo_us = rx_local_us
+            self.window_count = 0
+            self.synchronized = True
+            return
+        if self.window_count == 0 or error > self.window_error_us:
+            self.window_error_us = error
+            self.window_local_us = rx_local_us
+        self.window_count += 1
+        if self.window_count < SYNC_WINDOW:
+            return
+        self.window_count = 0
+
+        window_error = self.window_error_us
+        estimated = self.network_time_at(self.window_local_us)
+        if abs(window_error) > SYNC_STEP_US:
+            self.base_network_us = estimated + window_error
+        else:
+            elapsed = self.window_local_us - self.last_servo_us
+            if elapsed > 0:
+                drift = self.drift_ppb + c_div(c_div(window_error * 1000000000, elapsed), SYNC_KI_DIV)
+                self.drift_ppb = max(-SYNC_MAX_DRIFT_PPB, min(SYNC_MAX_DRIFT_PPB, drift))
+            self.base_network_us = estimated + c_div(window_error, SYNC_KP_DIV)
+        self.base_local_us = self.window_local_us
+        self.last_servo_us = self.window_local_us
+
+
+def simulate(latency, ppm, seed, seconds, settle_seconds, path_delay_us):
+    rng = random.Random(seed)
+    receiver = Receiver()
+    errors = []
+    t = 0.0  # network time of the reference, us
+    while t < seconds * 1e6:
+        rx_true = t + latency(rng)
+        receiver.sample(int(t) + path_delay_us, int(rx_true * (1 + ppm * 1e-6)))
+        if t > settle_seconds * 1e6:
+            instant = t + rng.uniform(0, ADV_INTERVAL_US)
+            errors.append(receiver.network_time_at(int(instant * (1 + ppm * 1e-6))) - instant)
+        t += ADV_INTERVAL_US + rng.uniform(0, ADV_DELAY_MAX_US)
+    rms = math.sqrt(sum(e * e for e in errors) / len(errors))
+    return rms, max(abs(e) for e in errors)
+
+
+MODELS = {
+    "running set, stamp refreshed per interval":
+        lambda rng: rng.uniform(1000, 3000) + rng.uniform(0, ADV_INTERVAL_US),
+    "running set, stamp refreshed every 25 ms":
+        lambda rng: rng.uniform(1000, 3000) + rng.uniform(0, ADV_INTERVAL_US / 4),
+    "running set, stamped per send (0-110 ms)":
+        lambda rng: rng.uniform(0, ADV_INTERVAL_US + ADV_DELAY_MAX_US),
+    "restarted per event, 1-3 ms start + 0-10 ms delay":
+        lambda rng: rng.uniform(1000, 3000) + rng.uniform(0, ADV_DELAY_MAX_US),
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--seconds", type=int, default=600)
+    parser.add_argument("--settle-seconds", type=int, default=120)
+    parser.add_argument("--path-delay-us", type=int, default=0, help="HELIOS_BLE_SYNC_PATH_DELAY_US")
+    args = parser.parse_args()
+
+    for name, latency in MODELS.items():
+        results = [simulate(latency, ppm, seed, args.seconds, args.settle_seconds, args.path_delay_us)
+                   for seed, ppm in enumerate(PPM_ERRORS)]
+        print("%-52s rms %5.0f-%5.0f us  max %6.0f us" % (
+            name, min(r[0] for r in results), max(r[0] for r in results), max(r[1] for r in results)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Host side demultiplexer for the serial_mux virtual channels.
+
+Every cobs frame (terminated by 0x00) carries the channel id in the lower 7 bits
+of its first byte, followed by the payload. The top bit is set on every frame of
+a split message except the last one, the parts are joined before the message is
+printed with its channel prefixed or written to one file per channel. Lines
+typed on stdin are sent to the console channel.
+
+    serial_mux_demux.py /dev/ttyACM0
+    serial_mux_demux.py /dev/ttyACM0 --output 2=telemetry.bin --console 0
+    serial_mux_demux.py - < capture.bin
+"""
+
+import argparse
+import sys
+import threading
+
+FLAG_MORE = 0x80
+CHANNEL_MASK = 0x7F
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            raise ValueError("invalid cobs frame")
+        out += frame[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_index = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_index] = code
+            code_index = len(out)
+            out.append(0)
+            code = 1
+            continue
+        out.append(byte)
+        code += 1
+        if code == 0xFF:
+            out[code_index] = code
+            code_index = len(out)
+            out.append(0)
+            code = 1
+    out[code_index] = code
+    out.append(0)
+    return bytes(out)
+
+
+class Demux:
+    def __init__(self, outputs):
+        self.outputs = outputs
+        self.buffer = bytearray()
+        self.parts = {}
+        self.errors = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            end = self.buffer.find(0)
+            if end < 0:
+                return
+            frame = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if not frame:
+                continue
+            try:
+                payload = cobs_decode(frame)
+            except ValueError:
+                self.errors += 1
+                continue
+            if not payload:
+                continue
+            channel = payload[0] & CHANNEL_MASK
+            parts = self.parts.setdefault(channel, bytearray())
+            parts += payload[1:]
+            if payload[0] & FLAG_MORE:
+                continue
+            del self.parts[channel]
+            if parts:
+                self.deliver(channel, bytes(parts))
+
+    def deliver(self, channel, payload):
+        output = self.outputs.get(channel)
+        if output is not None:
+            output.write(payload)
+            output.flush()
+            return
+        text = payload.decode("utf-8", errors="replace")
+        sys.stdout.write("[%d] %s" % (channel, text))
+        if not text.endswith("\n"):
+            sys.stdout.write("\n")
+        sys.stdout.flush()
+
+
+def parse_outputs(specs):
+    outputs = {}
+    for spec in specs:
+        channel, _, path = spec.partition("=")
+        if not path:
+            raise SystemExit("--output expects CHANNEL=FILE, got %r" % spec)
+        outputs[int(channel)] = open(path, "ab")
+    return outputs
+
+
+def encode_message(channel, data, max_payload):
+    frames = bytearray()
+    for offset in range(0, len(data), max_payload):
+        more = FLAG_MORE if offset + max_payload < len(data) else 0
+        frames += cobs_encode(bytes([channel | more]) + data[offset:offset + max_payload])
+    return bytes(frames)
+
+
+def forward_console(port, channel, max_payload):
+    for line in sys.stdin.buffer:
+        port.write(encode_message(channel, line, max_payload))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial port, or - to read a capture from stdin")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--output", action="append", default=[], metavar="CHANNEL=FILE",
+                        help="write the payload of a channel to a file instead of stdout")
+    parser.add_argument("--console", type=int, metavar="CHANNEL",
+                        help="send lines read from stdin to this channel")
+    parser.add_argument("--max-payload", type=int, default=64, help="SERIAL_MUX_MAX_PAYLOAD of the firmware")
+    args = parser.parse_args()
+
+    demux = Demux(parse_outputs(args.output))
+
+    if args.port == "-":
+        demux.feed(sys.stdin.buffer.read())
+        return
+
+    import serial  # pyserial
+    port = serial.Serial(args.port, args.baudrate, timeout=0.1)
+    if args.console is not None:
+        threading.Thread(target=forward_console, args=(port, args.console, args.max_payload), daemon=True).start()
+    try:
+        while True:
+            demux.feed(port.read(4096))
+    except KeyboardInterrupt:
+        pass
+    if demux.errors:
+        sys.stderr.write("%d corrupt frames dropped\n" % demux.errors)
+
+
+if __name__ == "__main__":
+    main()